@@ -0,0 +1,56 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include "common/alignment.h"
+#include "common/arena.h"
+
+namespace Common {
+
+Arena::Arena(size_t chunk_size_) : chunk_size{chunk_size_} {
+    AddChunk(chunk_size);
+}
+
+Arena::~Arena() = default;
+
+void Arena::Reset() {
+    if (chunks.size() > 1) {
+        // Size the root chunk for the whole previous workload.
+        size_t total_size{};
+        for (const auto& chunk : chunks) {
+            total_size += chunk.size;
+        }
+        chunks.clear();
+        AddChunk(total_size);
+    } else {
+        cursor = chunks.front().data.get();
+    }
+    allocated = 0;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    uintptr_t addr = AlignUp(reinterpret_cast<uintptr_t>(cursor), alignment);
+    if (addr + bytes > reinterpret_cast<uintptr_t>(end)) {
+        AddChunk(std::max(chunk_size, bytes + alignment));
+        addr = AlignUp(reinterpret_cast<uintptr_t>(cursor), alignment);
+    }
+    cursor = reinterpret_cast<u8*>(addr + bytes);
+    allocated += bytes;
+    return reinterpret_cast<void*>(addr);
+}
+
+void Arena::do_deallocate(void* p, size_t bytes, [[maybe_unused]] size_t alignment) {
+    u8* const ptr = static_cast<u8*>(p);
+    if (ptr + bytes == cursor) {
+        cursor = ptr;
+        allocated -= bytes;
+    }
+}
+
+void Arena::AddChunk(size_t size) {
+    auto& chunk = chunks.emplace_back(std::make_unique_for_overwrite<u8[]>(size), size);
+    cursor = chunk.data.get();
+    end = cursor + size;
+}
+
+} // namespace Common
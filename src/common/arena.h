@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+#include <vector>
+#include "common/types.h"
+
+namespace Common {
+
+/**
+ * Bump allocator for short lived allocations that are all released at once.
+ * Individual deallocations are ignored, except for the most recent allocation which is rolled
+ * back so that growing containers can reuse their previous storage. Reset keeps the backing
+ * memory around, coalesced into a single chunk, so a steady workload stops touching the heap
+ * after the first few rounds. Not thread safe, each thread is expected to own its arena.
+ */
+class Arena final : public std::pmr::memory_resource {
+public:
+    explicit Arena(size_t chunk_size = 64_KB);
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /// Releases all allocations. Memory handed out before the reset must not be used anymore.
+    void Reset();
+
+    /// Returns the number of bytes handed out since the last reset.
+    [[nodiscard]] size_t BytesAllocated() const noexcept {
+        return allocated;
+    }
+
+private:
+    struct Chunk {
+        std::unique_ptr<u8[]> data;
+        size_t size;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    void AddChunk(size_t size);
+
+    std::vector<Chunk> chunks;
+    u8* cursor{};
+    u8* end{};
+    size_t chunk_size;
+    size_t allocated{};
+};
+
+} // namespace Common
@@ -3,11 +3,13 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <condition_variable>
 #include <cstddef>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include "common/polyfill_thread.h"
 
 namespace Common {
@@ -245,4 +247,82 @@ private:
     std::mutex read_mutex;
 };
 
+/**
+ * Bounded multi producer single consumer queue that never blocks on a lock. Each slot carries
+ * a sequence number telling producers and the consumer whose turn it is, so producers only
+ * contend on the write index. Waiting for data is left to the consumer.
+ */
+template <typename T, std::size_t Capacity = detail::DefaultCapacity>
+class LockFreeMPSCQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+public:
+    LockFreeMPSCQueue() {
+        for (std::size_t i = 0; i < Capacity; ++i) {
+            m_slots[i].sequence.store(i, std::memory_order::relaxed);
+        }
+    }
+
+    template <typename... Args>
+    bool TryEmplace(Args&&... args) {
+        std::size_t write_index = m_write_index.load(std::memory_order::relaxed);
+        while (true) {
+            Slot& slot = m_slots[write_index % Capacity];
+            const std::size_t sequence = slot.sequence.load(std::memory_order::acquire);
+            if (sequence == write_index) {
+                // The slot is free, try to claim it. On failure write_index is reloaded.
+                if (m_write_index.compare_exchange_weak(write_index, write_index + 1,
+                                                        std::memory_order::relaxed)) {
+                    slot.value = T(std::forward<Args>(args)...);
+                    slot.sequence.store(write_index + 1, std::memory_order::release);
+                    return true;
+                }
+            } else if (sequence < write_index) {
+                // The consumer has not released this slot yet, the queue is full.
+                return false;
+            } else {
+                write_index = m_write_index.load(std::memory_order::relaxed);
+            }
+        }
+    }
+
+    template <typename... Args>
+    void EmplaceWait(Args&&... args) {
+        // Arguments are only consumed by a successful emplace.
+        while (!TryEmplace(std::forward<Args>(args)...)) {
+            std::this_thread::yield();
+        }
+    }
+
+    bool TryPop(T& t) {
+        const std::size_t read_index = m_read_index.load(std::memory_order::relaxed);
+        Slot& slot = m_slots[read_index % Capacity];
+        if (slot.sequence.load(std::memory_order::acquire) != read_index + 1) {
+            return false;
+        }
+        t = std::move(slot.value);
+        slot.sequence.store(read_index + Capacity, std::memory_order::release);
+        m_read_index.store(read_index + 1, std::memory_order::relaxed);
+        return true;
+    }
+
+    /// Only meaningful on the consumer thread, producers may add data at any time.
+    [[nodiscard]] bool Empty() const {
+        const std::size_t read_index = m_read_index.load(std::memory_order::relaxed);
+        const Slot& slot = m_slots[read_index % Capacity];
+        return slot.sequence.load(std::memory_order::acquire) != read_index + 1;
+    }
+
+private:
+    struct Slot {
+        std::atomic_size_t sequence;
+        T value{};
+    };
+
+    alignas(128) std::atomic_size_t m_read_index{0};
+    alignas(128) std::atomic_size_t m_write_index{0};
+
+    std::array<Slot, Capacity> m_slots;
+};
+
 } // namespace Common
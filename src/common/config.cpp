@@ -55,6 +55,11 @@ static bool isNullGpu = false;
 static bool shouldCopyGPUBuffers = false;
 static bool shouldDumpShaders = false;
 static bool shouldPatchShaders = true;
+static bool shaderCache = true;
+static bool asyncShaderCompile = false;
+static bool shaderPassStats = false;
+static u32 cacheBudgetMB = 0;
+static bool cpuDetiler = false;
 static u32 vblankDivider = 1;
 static bool vkValidation = false;
 static bool vkValidationSync = false;
@@ -204,6 +209,26 @@ bool patchShaders() {
     return shouldPatchShaders;
 }
 
+bool isShaderCacheEnabled() {
+    return shaderCache;
+}
+
+bool isAsyncShaderCompileEnabled() {
+    return asyncShaderCompile;
+}
+
+bool collectShaderPassStats() {
+    return shaderPassStats;
+}
+
+u32 cacheBudgetMb() {
+    return cacheBudgetMB;
+}
+
+bool isCpuDetilerEnabled() {
+    return cpuDetiler;
+}
+
 bool isRdocEnabled() {
     return rdocEnable;
 }
@@ -288,6 +313,26 @@ void setDumpShaders(bool enable) {
     shouldDumpShaders = enable;
 }
 
+void setShaderCacheEnabled(bool enable) {
+    shaderCache = enable;
+}
+
+void setAsyncShaderCompileEnabled(bool enable) {
+    asyncShaderCompile = enable;
+}
+
+void setCollectShaderPassStats(bool enable) {
+    shaderPassStats = enable;
+}
+
+void setCacheBudgetMb(u32 value) {
+    cacheBudgetMB = value;
+}
+
+void setCpuDetilerEnabled(bool enable) {
+    cpuDetiler = enable;
+}
+
 void setVkValidation(bool enable) {
     vkValidation = enable;
 }
@@ -605,6 +650,11 @@ void load(const std::filesystem::path& path) {
         shouldCopyGPUBuffers = toml::find_or<bool>(gpu, "copyGPUBuffers", false);
         shouldDumpShaders = toml::find_or<bool>(gpu, "dumpShaders", false);
         shouldPatchShaders = toml::find_or<bool>(gpu, "patchShaders", true);
+        shaderCache = toml::find_or<bool>(gpu, "shaderCache", true);
+        asyncShaderCompile = toml::find_or<bool>(gpu, "asyncShaderCompile", false);
+        shaderPassStats = toml::find_or<bool>(gpu, "shaderPassStats", false);
+        cacheBudgetMB = toml::find_or<int>(gpu, "cacheBudgetMB", 0);
+        cpuDetiler = toml::find_or<bool>(gpu, "cpuDetiler", false);
         vblankDivider = toml::find_or<int>(gpu, "vblankDivider", 1);
     }
 
@@ -715,6 +765,11 @@ void save(const std::filesystem::path& path) {
     data["GPU"]["copyGPUBuffers"] = shouldCopyGPUBuffers;
     data["GPU"]["dumpShaders"] = shouldDumpShaders;
     data["GPU"]["patchShaders"] = shouldPatchShaders;
+    data["GPU"]["shaderCache"] = shaderCache;
+    data["GPU"]["asyncShaderCompile"] = asyncShaderCompile;
+    data["GPU"]["shaderPassStats"] = shaderPassStats;
+    data["GPU"]["cacheBudgetMB"] = cacheBudgetMB;
+    data["GPU"]["cpuDetiler"] = cpuDetiler;
     data["GPU"]["vblankDivider"] = vblankDivider;
     data["Vulkan"]["gpuId"] = gpuId;
     data["Vulkan"]["validation"] = vkValidation;
@@ -815,6 +870,11 @@ void setDefaultValues() {
     isAutoUpdate = false;
     isNullGpu = false;
     shouldDumpShaders = false;
+    shaderCache = true;
+    asyncShaderCompile = false;
+    shaderPassStats = false;
+    cacheBudgetMB = 0;
+    cpuDetiler = false;
     vblankDivider = 1;
     vkValidation = false;
     vkValidationSync = false;
@@ -51,6 +51,11 @@ bool nullGpu();
 bool copyGPUCmdBuffers();
 bool dumpShaders();
 bool patchShaders();
+bool isShaderCacheEnabled();
+bool isAsyncShaderCompileEnabled();
+bool collectShaderPassStats();
+u32 cacheBudgetMb();
+bool isCpuDetilerEnabled();
 bool isRdocEnabled();
 u32 vblankDiv();
 
@@ -61,6 +66,11 @@ void setAutoUpdate(bool enable);
 void setNullGpu(bool enable);
 void setCopyGPUCmdBuffers(bool enable);
 void setDumpShaders(bool enable);
+void setShaderCacheEnabled(bool enable);
+void setAsyncShaderCompileEnabled(bool enable);
+void setCollectShaderPassStats(bool enable);
+void setCacheBudgetMb(u32 value);
+void setCpuDetilerEnabled(bool enable);
 void setVblankDiv(u32 value);
 void setGpuId(s32 selectedGpuId);
 void setScreenWidth(u32 width);
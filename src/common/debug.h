@@ -64,6 +64,8 @@ enum MarkersPalette : int {
 
 #define FRAME_END FrameMark
 
+#define TRACE_PLOT(name, value) TracyPlot(name, static_cast<int64_t>(value))
+
 #ifdef TRACY_FIBERS
 #define FIBER_ENTER(name) TracyFiberEnter(name)
 #define FIBER_EXIT TracyFiberLeave
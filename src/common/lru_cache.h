@@ -0,0 +1,134 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <type_traits>
+#include "common/types.h"
+
+namespace Common {
+
+/**
+ * Intrusive least recently used list of objects tagged with the tick they were last used on.
+ * Items are kept sorted by tick as long as touches use non-decreasing ticks, so walking the
+ * oldest items is linear in the number of items visited.
+ */
+template <typename ObjectType, typename TickType = u64>
+class LeastRecentlyUsedCache {
+    struct Item {
+        ObjectType obj;
+        TickType tick;
+        Item* next{};
+        Item* prev{};
+    };
+
+public:
+    LeastRecentlyUsedCache() = default;
+
+    LeastRecentlyUsedCache(const LeastRecentlyUsedCache&) = delete;
+    LeastRecentlyUsedCache& operator=(const LeastRecentlyUsedCache&) = delete;
+
+    /// Inserts a new object as the most recently used one and returns its handle.
+    size_t Insert(ObjectType obj, TickType tick) {
+        const size_t new_id = Build();
+        Item& item = item_pool[new_id];
+        item.obj = obj;
+        item.tick = tick;
+        Attach(item);
+        return new_id;
+    }
+
+    /// Marks the object as used on the provided tick.
+    void Touch(size_t id, TickType tick) {
+        Item& item = item_pool[id];
+        if (item.tick >= tick) {
+            return;
+        }
+        item.tick = tick;
+        if (&item == last_item) {
+            return;
+        }
+        Detach(item);
+        Attach(item);
+    }
+
+    /// Removes the object from the list, the handle may be reused by later insertions.
+    void Free(size_t id) {
+        Item& item = item_pool[id];
+        Detach(item);
+        item.prev = nullptr;
+        item.next = nullptr;
+        free_items.push_back(id);
+    }
+
+    /// Visits objects last used before the provided tick, oldest first. Returning true from
+    /// the callback stops the walk. The callback may free the object it is given.
+    template <typename Func>
+    void ForEachItemBelow(TickType tick, Func&& func) {
+        static constexpr bool RETURNS_BOOL =
+            std::is_same_v<std::invoke_result_t<Func, ObjectType>, bool>;
+        Item* iterator = first_item;
+        while (iterator) {
+            if (iterator->tick >= tick) {
+                return;
+            }
+            Item* next = iterator->next;
+            if constexpr (RETURNS_BOOL) {
+                if (func(iterator->obj)) {
+                    return;
+                }
+            } else {
+                func(iterator->obj);
+            }
+            iterator = next;
+        }
+    }
+
+private:
+    size_t Build() {
+        if (free_items.empty()) {
+            const size_t item_id = item_pool.size();
+            item_pool.emplace_back();
+            return item_id;
+        }
+        const size_t item_id = free_items.back();
+        free_items.pop_back();
+        return item_id;
+    }
+
+    void Attach(Item& item) {
+        item.prev = last_item;
+        item.next = nullptr;
+        if (!first_item) {
+            first_item = &item;
+        }
+        if (last_item) {
+            last_item->next = &item;
+        }
+        last_item = &item;
+    }
+
+    void Detach(Item& item) {
+        if (item.prev) {
+            item.prev->next = item.next;
+        }
+        if (item.next) {
+            item.next->prev = item.prev;
+        }
+        if (&item == first_item) {
+            first_item = item.next;
+        }
+        if (&item == last_item) {
+            last_item = item.prev;
+        }
+    }
+
+    std::deque<Item> item_pool;
+    std::deque<size_t> free_items;
+    Item* first_item{};
+    Item* last_item{};
+};
+
+} // namespace Common
@@ -26,6 +26,7 @@ enum class PathType {
     CheatsDir,      // Where cheats are stored.
     PatchesDir,     // Where patches are stored.
     MetaDataDir,    // Where game metadata (e.g. trophies and menu backgrounds) is stored.
+    CpuPatchesDir,  // Where CPU patch manifests of modules are stored.
 };
 
 constexpr auto PORTABLE_DIR = "user";
@@ -43,6 +44,7 @@ constexpr auto CAPTURES_DIR = "captures";
 constexpr auto CHEATS_DIR = "cheats";
 constexpr auto PATCHES_DIR = "patches";
 constexpr auto METADATA_DIR = "game_data";
+constexpr auto CPU_PATCHES_DIR = "cpu_patches";
 
 // Filenames
 constexpr auto LOG_FILE = "shad_log.txt";
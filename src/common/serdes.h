@@ -0,0 +1,110 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "common/types.h"
+
+namespace Serialization {
+
+/// Appends trivially copyable values and length-prefixed arrays to a byte buffer.
+class Writer {
+public:
+    explicit Writer(std::vector<u8>& data_) : data{data_} {}
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    void Write(const T& value) {
+        WriteRaw(&value, sizeof(T));
+    }
+
+    template <typename Container>
+    void WriteVector(const Container& values) {
+        using T = typename Container::value_type;
+        static_assert(std::is_trivially_copyable_v<T>);
+        Write(static_cast<u32>(values.size()));
+        WriteRaw(values.data(), values.size() * sizeof(T));
+    }
+
+    void WriteString(std::string_view str) {
+        WriteVector(str);
+    }
+
+    void WriteRaw(const void* src, size_t size) {
+        const size_t offset = data.size();
+        data.resize(offset + size);
+        std::memcpy(data.data() + offset, src, size);
+    }
+
+private:
+    std::vector<u8>& data;
+};
+
+/// Reads back data produced by Writer. Any out of bounds access marks the reader as failed
+/// and all subsequent reads return false.
+class Reader {
+public:
+    explicit Reader(std::span<const u8> data_) : data{data_} {}
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    bool Read(T& value) {
+        return ReadRaw(&value, sizeof(T));
+    }
+
+    template <typename Container>
+    bool ReadVector(Container& values) {
+        using T = typename Container::value_type;
+        static_assert(std::is_trivially_copyable_v<T>);
+        u32 size{};
+        if (!Read(size) || !CanRead(size_t(size) * sizeof(T))) {
+            failed = true;
+            return false;
+        }
+        values.resize(size);
+        return ReadRaw(values.data(), size * sizeof(T));
+    }
+
+    bool ReadString(std::string& str) {
+        return ReadVector(str);
+    }
+
+    bool ReadRaw(void* dst, size_t size) {
+        if (!CanRead(size)) {
+            failed = true;
+            return false;
+        }
+        std::memcpy(dst, data.data() + offset, size);
+        offset += size;
+        return true;
+    }
+
+    [[nodiscard]] bool CanRead(size_t size) const noexcept {
+        return !failed && offset + size <= data.size();
+    }
+
+    [[nodiscard]] bool Failed() const noexcept {
+        return failed;
+    }
+
+    [[nodiscard]] bool AtEnd() const noexcept {
+        return offset == data.size();
+    }
+
+    [[nodiscard]] size_t Offset() const noexcept {
+        return offset;
+    }
+
+private:
+    std::span<const u8> data;
+    size_t offset{};
+    bool failed{};
+};
+
+} // namespace Serialization
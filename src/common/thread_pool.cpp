@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <fmt/format.h>
+
+#include "common/thread.h"
+#include "common/thread_pool.h"
+
+namespace Common {
+
+ThreadPool::ThreadPool(size_t num_workers, std::string_view name_) : name{name_} {
+    num_workers = std::max<size_t>(num_workers, 1);
+    queues.reserve(num_workers);
+    for (size_t i = 0; i < num_workers; ++i) {
+        queues.emplace_back(std::make_unique<TaskQueue>());
+    }
+    threads.reserve(num_workers);
+    for (size_t i = 0; i < num_workers; ++i) {
+        threads.emplace_back([this, i](std::stop_token stoken) { WorkerLoop(stoken, i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    for (auto& thread : threads) {
+        thread.request_stop();
+    }
+    threads.clear();
+}
+
+void ThreadPool::Submit(Task&& task) {
+    auto& queue = *queues[next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+    // Count the task before it becomes visible, a worker may pop it right after the push and
+    // the count must never drop below the number of queued tasks.
+    {
+        std::scoped_lock lk{wait_mutex};
+        num_queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        std::scoped_lock lk{queue.mutex};
+        queue.tasks.emplace_back(std::move(task));
+    }
+    wait_cv.notify_one();
+}
+
+bool ThreadPool::TryPop(size_t worker, Task& task) {
+    // Own queue is consumed in submission order, others are stolen from the back.
+    for (size_t i = 0; i < queues.size(); ++i) {
+        auto& queue = *queues[(worker + i) % queues.size()];
+        std::scoped_lock lk{queue.mutex};
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        num_queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::WorkerLoop(std::stop_token stoken, size_t worker) {
+    const auto thread_name = fmt::format("{}:{}", name, worker);
+    SetCurrentThreadName(thread_name.c_str());
+
+    while (!stoken.stop_requested()) {
+        Task task;
+        if (TryPop(worker, task)) {
+            task(size_t{worker});
+            continue;
+        }
+        std::unique_lock lk{wait_mutex};
+        CondvarWait(wait_cv, lk, stoken,
+                    [this] { return num_queued.load(std::memory_order_relaxed) != 0; });
+    }
+}
+
+} // namespace Common
@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "common/polyfill_thread.h"
+#include "common/unique_function.h"
+
+namespace Common {
+
+/**
+ * Fixed size pool of worker threads with per-worker task queues.
+ * Tasks are distributed round-robin; a worker that runs out of work steals from the back of
+ * the other queues, so a burst of long tasks landing on one queue does not serialize behind a
+ * single thread. Tasks that are still queued when the pool is destroyed are dropped.
+ */
+class ThreadPool {
+public:
+    /// Tasks receive the index of the worker running them, for use with per-worker state.
+    using Task = UniqueFunction<void, size_t>;
+
+    explicit ThreadPool(size_t num_workers, std::string_view name);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(Task&& task);
+
+    [[nodiscard]] size_t NumWorkers() const noexcept {
+        return queues.size();
+    }
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool TryPop(size_t worker, Task& task);
+    void WorkerLoop(std::stop_token stoken, size_t worker);
+
+private:
+    std::string name;
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::atomic<size_t> next_queue{};
+    std::atomic<size_t> num_queued{};
+    std::mutex wait_mutex;
+    std::condition_variable_any wait_cv;
+    std::vector<std::jthread> threads;
+};
+
+} // namespace Common
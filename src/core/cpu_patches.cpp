@@ -1,17 +1,26 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <cstring>
+#include <filesystem>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <set>
+#include <span>
+#include <vector>
 #include <Zydis/Zydis.h>
 #include <xbyak/xbyak.h>
 #include <xbyak/xbyak_util.h>
+#include <xxhash.h>
 #include "common/alignment.h"
 #include "common/arch.h"
 #include "common/assert.h"
 #include "common/decoder.h"
+#include "common/io_file.h"
+#include "common/path_util.h"
+#include "common/scm_rev.h"
 #include "common/signal_context.h"
 #include "common/types.h"
 #include "core/signals.h"
@@ -907,6 +916,25 @@ static const std::unordered_map<ZydisMnemonic, PatchInfo> Patches = {
 
 static std::once_flag init_flag;
 
+/// Executable segment of a module. The sites patched in it are recorded in a manifest keyed by
+/// the segment contents, so later boots can patch them without disassembling the segment.
+struct PatchSegment {
+    /// Start of the segment.
+    u8* start;
+
+    /// Size of the segment.
+    u64 size;
+
+    /// Path of the patch manifest of the segment.
+    std::filesystem::path manifest_path;
+
+    /// Sites stored in the manifest, as offsets from the start.
+    std::vector<u32> sites;
+
+    /// Sites patched at runtime that are not in the manifest yet.
+    std::vector<u32> pending_sites;
+};
+
 struct PatchModule {
     /// Mutex controlling access to module code regions.
     std::mutex mutex{};
@@ -926,12 +954,17 @@ struct PatchModule {
     /// Code generator for writing trampoline patches.
     Xbyak::CodeGenerator trampoline_gen;
 
+    /// Executable segments loaded so far.
+    std::vector<PatchSegment> segments;
+
     PatchModule(u8* module_ptr, const u64 module_size, u8* trampoline_ptr,
                 const u64 trampoline_size)
         : start(module_ptr), end(module_ptr + module_size), patch_gen(module_size, module_ptr),
           trampoline_gen(trampoline_size, trampoline_ptr) {}
 };
 static std::map<u64, PatchModule> modules;
+/// Guards insertion into and iteration over modules.
+static std::mutex modules_mutex;
 
 static PatchModule* GetModule(const void* ptr) {
     auto upper_bound = modules.upper_bound(reinterpret_cast<u64>(ptr));
@@ -941,6 +974,84 @@ static PatchModule* GetModule(const void* ptr) {
     return &(std::prev(upper_bound)->second);
 }
 
+static constexpr u32 ManifestMagic = 0x50435053; // SPCP
+static constexpr u32 ManifestVersion = 1;
+
+struct ManifestHeader {
+    u32 magic;
+    u32 version;
+    u64 build_hash;
+    u64 segment_size;
+    u64 num_sites;
+    u64 sites_hash;
+};
+
+static u64 GetBuildHash() {
+    // Patch generators and filters may change between builds.
+    static const u64 build_hash = XXH3_64bits(Common::g_scm_rev, std::strlen(Common::g_scm_rev));
+    return build_hash;
+}
+
+/// Returns the patch sites recorded for the segment, as offsets from its start.
+static std::optional<std::vector<u32>> LoadPatchManifest(const PatchSegment& segment) {
+    if (!std::filesystem::exists(segment.manifest_path)) {
+        return std::nullopt;
+    }
+    const auto file = Common::FS::IOFile{segment.manifest_path, Common::FS::FileAccessMode::Read};
+    ManifestHeader header{};
+    if (!file.ReadObject(header) || header.magic != ManifestMagic ||
+        header.version != ManifestVersion || header.build_hash != GetBuildHash() ||
+        header.segment_size != segment.size ||
+        file.GetSize() != sizeof(ManifestHeader) + header.num_sites * sizeof(u32)) {
+        return std::nullopt;
+    }
+    std::vector<u32> sites(header.num_sites);
+    if (file.Read(sites) != sites.size() ||
+        XXH3_64bits(sites.data(), sites.size() * sizeof(u32)) != header.sites_hash) {
+        return std::nullopt;
+    }
+    return sites;
+}
+
+/// Replaces the manifest of the segment with its current sites. The manifest is written to a
+/// temporary file first, so an interrupted write never leaves a truncated manifest behind.
+static void WritePatchManifest(const PatchSegment& segment) {
+    auto temp_path = segment.manifest_path;
+    temp_path += ".tmp";
+    const ManifestHeader header = {
+        .magic = ManifestMagic,
+        .version = ManifestVersion,
+        .build_hash = GetBuildHash(),
+        .segment_size = segment.size,
+        .num_sites = segment.sites.size(),
+        .sites_hash = XXH3_64bits(segment.sites.data(), segment.sites.size() * sizeof(u32)),
+    };
+    bool written;
+    {
+        const auto file = Common::FS::IOFile{temp_path, Common::FS::FileAccessMode::Write};
+        written = file.WriteObject(header) && file.Write(segment.sites) == segment.sites.size();
+    }
+    std::error_code ec;
+    if (written) {
+        std::filesystem::rename(temp_path, segment.manifest_path, ec);
+    }
+    if (!written || ec) {
+        LOG_WARNING(Core, "Failed to write patch manifest {}", segment.manifest_path.string());
+        std::filesystem::remove(temp_path, ec);
+    }
+}
+
+/// Queues a site patched at runtime for the manifest of the segment containing it. This runs in
+/// the signal handler, the manifest itself is written later by FlushPatchSites.
+static void RecordPatchSite(PatchModule* module, const u8* code) {
+    for (PatchSegment& segment : module->segments) {
+        if (code >= segment.start && code < segment.start + segment.size) {
+            segment.pending_sites.push_back(static_cast<u32>(code - segment.start));
+            return;
+        }
+    }
+}
+
 /// Returns a boolean indicating whether the instruction was patched, and the offset to advance past
 /// whatever is at the current code pointer.
 static std::pair<bool, u64> TryPatch(u8* code, PatchModule* module) {
@@ -1167,21 +1278,23 @@ static bool TryPatchJit(void* code_address) {
         return true;
     }
 
-    return TryPatch(code, module).first;
-}
-
-static void TryPatchAot(void* code_address, u64 code_size) {
-    auto* code = static_cast<u8*>(code_address);
-    auto* module = GetModule(code);
-    if (module == nullptr) {
-        return;
+    if (!TryPatch(code, module).first) {
+        return false;
     }
+    // Patch the site ahead of time on the next boot instead of faulting on it again.
+    RecordPatchSite(module, code);
+    return true;
+}
 
-    std::unique_lock lock{module->mutex};
-
-    const auto* end = code + code_size;
-    while (code < end) {
-        code += TryPatch(code, module).second;
+/// Disassembles the whole segment, patching every instruction that needs it.
+static void TryPatchAot(PatchSegment& segment, PatchModule* module) {
+    const auto* end = segment.start + segment.size;
+    for (u8* code = segment.start; code < end;) {
+        const auto [patched, length] = TryPatch(code, module);
+        if (patched) {
+            segment.sites.push_back(static_cast<u32>(code - segment.start));
+        }
+        code += length;
     }
 }
 
@@ -1212,31 +1325,95 @@ void RegisterPatchModule(void* module_ptr, u64 module_size, void* trampoline_are
     std::call_once(init_flag, PatchesInit);
 
     const auto module_addr = reinterpret_cast<u64>(module_ptr);
+    std::scoped_lock lock{modules_mutex};
     modules.emplace(std::piecewise_construct, std::forward_as_tuple(module_addr),
                     std::forward_as_tuple(static_cast<u8*>(module_ptr), module_size,
                                           static_cast<u8*>(trampoline_area_ptr),
                                           trampoline_area_size));
 }
 
+void FlushPatchSites() {
+    // Modules are never removed and map nodes do not move, so the pointers stay valid after
+    // the lock is released.
+    std::vector<PatchModule*> registered;
+    {
+        std::scoped_lock lock{modules_mutex};
+        registered.reserve(modules.size());
+        for (auto& [_, module] : modules) {
+            registered.push_back(&module);
+        }
+    }
+    for (PatchModule* module : registered) {
+        // Take the updated segments out under the lock and write them without holding it, so
+        // threads faulting on unpatched code are not stalled by file IO.
+        std::vector<PatchSegment> updated;
+        {
+            std::unique_lock lock{module->mutex};
+            for (PatchSegment& segment : module->segments) {
+                if (segment.pending_sites.empty()) {
+                    continue;
+                }
+                segment.sites.insert(segment.sites.end(), segment.pending_sites.begin(),
+                                     segment.pending_sites.end());
+                segment.pending_sites.clear();
+                updated.push_back(segment);
+            }
+        }
+        for (const PatchSegment& segment : updated) {
+            WritePatchManifest(segment);
+        }
+    }
+}
+
 void PrePatchInstructions(u64 segment_addr, u64 segment_size) {
+    if (Patches.empty()) {
+        return;
+    }
+    auto* code = reinterpret_cast<u8*>(segment_addr);
+    auto* module = GetModule(code);
+    if (module == nullptr) {
+        return;
+    }
+
+    // Store the sites patched at runtime by the modules that already started.
+    FlushPatchSites();
+
+    std::unique_lock lock{module->mutex};
+
+    const u64 content_hash = XXH3_64bits(code, segment_size);
+    const auto manifest_dir = Common::FS::GetUserPath(Common::FS::PathType::CpuPatchesDir);
+    auto& segment = module->segments.emplace_back(
+        code, segment_size, manifest_dir / fmt::format("{:016x}.patches", content_hash));
+
+    // Patch the sites recorded on a previous boot, both the ones found ahead of time and the
+    // ones found at runtime.
+    if (auto sites = LoadPatchManifest(segment)) {
+        for (const u32 site : *sites) {
+            if (site < segment.size && !module->patched.contains(code + site)) {
+                TryPatch(code + site, module);
+            }
+        }
+        segment.sites = std::move(*sites);
+        return;
+    }
+
 #if defined(__APPLE__)
     // HACK: For some reason patching in the signal handler at the start of a page does not work
     // under Rosetta 2. Patch any instructions at the start of a page ahead of time.
-    if (!Patches.empty()) {
-        auto* code_page = reinterpret_cast<u8*>(Common::AlignUp(segment_addr, 0x1000));
-        const auto* end_page = code_page + Common::AlignUp(segment_size, 0x1000);
-        while (code_page < end_page) {
-            TryPatchJit(code_page);
-            code_page += 0x1000;
+    auto* code_page = reinterpret_cast<u8*>(Common::AlignUp(segment_addr, 0x1000));
+    const auto* end_page = code_page + Common::AlignUp(segment_size, 0x1000);
+    while (code_page < end_page) {
+        if (!module->patched.contains(code_page) && TryPatch(code_page, module).first) {
+            segment.sites.push_back(static_cast<u32>(code_page - code));
         }
+        code_page += 0x1000;
     }
 #elif !defined(_WIN32)
     // Linux and others have an FS segment pointing to valid memory, so continue to do full
     // ahead-of-time patching for now until a better solution is worked out.
-    if (!Patches.empty()) {
-        TryPatchAot(reinterpret_cast<void*>(segment_addr), segment_size);
-    }
+    TryPatchAot(segment, module);
 #endif
+    WritePatchManifest(segment);
 }
 
 } // namespace Core
@@ -20,4 +20,7 @@ void RegisterPatchModule(void* module_ptr, u64 module_size, void* trampoline_are
 /// Applies CPU patches that need to be done before beginning executions.
 void PrePatchInstructions(u64 segment_addr, u64 segment_size);
 
+/// Writes the sites patched at runtime to the patch manifests, for use on the next boot.
+void FlushPatchSites();
+
 } // namespace Core
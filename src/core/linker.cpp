@@ -1,6 +1,11 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <algorithm>
+#include <chrono>
+#include <latch>
+#include <thread>
+
 #include "common/alignment.h"
 #include "common/arch.h"
 #include "common/assert.h"
@@ -10,6 +15,7 @@
 #include "common/path_util.h"
 #include "common/string_util.h"
 #include "common/thread.h"
+#include "common/thread_pool.h"
 #include "core/aerolib/aerolib.h"
 #include "core/aerolib/stubs.h"
 #include "core/libraries/kernel/memory.h"
@@ -53,6 +59,37 @@ Linker::Linker() : memory{Memory::Instance()} {}
 Linker::~Linker() = default;
 
 void Linker::Execute() {
+    if (m_modules.empty()) {
+        LOG_ERROR(Core_Linker, "No modules loaded, nothing to execute");
+        return;
+    }
+
+    // Parsing and relocating a module only writes to the module itself, relocations just read
+    // the exports of the others. Spread the modules over workers and wait for each step.
+    const size_t num_workers = std::max<size_t>(
+        1, std::min<size_t>(std::thread::hardware_concurrency(), m_modules.size()));
+    Common::ThreadPool workers{num_workers, "Linker"};
+    const auto for_each_module = [&](auto&& func) {
+        const auto start = std::chrono::steady_clock::now();
+        std::latch done{static_cast<std::ptrdiff_t>(m_modules.size())};
+        for (const auto& m : m_modules) {
+            workers.Submit([&, module = m.get()](size_t) {
+                func(module);
+                done.count_down();
+            });
+        }
+        done.wait();
+        const std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    };
+
+    // Parse symbol tables of all modules
+    const double parse_time = for_each_module([](Module* m) {
+        m->LoadDynamicInfo();
+        m->LoadSymbols();
+    });
+
     if (Config::debugDump()) {
         DebugDump();
     }
@@ -62,9 +99,9 @@ void Linker::Execute() {
     static_tls_size = module->tls.offset = module->tls.image_size;
 
     // Relocate all modules
-    for (const auto& m : m_modules) {
-        Relocate(m.get());
-    }
+    const double relocate_time = for_each_module([this](Module* m) { Relocate(m); });
+    LOG_INFO(Core_Linker, "Parsed {} modules in {:.2f} ms, relocated them in {:.2f} ms",
+             m_modules.size(), parse_time, relocate_time);
 
     // Configure the direct and flexible memory regions.
     u64 fmem_size = SCE_FLEXIBLE_MEMORY_SIZE;
@@ -128,6 +165,12 @@ s32 Linker::LoadModule(const std::filesystem::path& elf_name, bool is_dynamic) {
         return -1;
     }
 
+    // Static modules are parsed together when the linker starts executing.
+    if (is_dynamic) {
+        module->LoadDynamicInfo();
+        module->LoadSymbols();
+    }
+
     num_static_modules += !is_dynamic;
     m_modules.emplace_back(std::move(module));
     return m_modules.size() - 1;
@@ -296,17 +339,23 @@ bool Linker::Resolve(const std::string& name, Loader::SymbolType sym_type, Modul
 }
 
 void* Linker::TlsGetAddr(u64 module_index, u64 offset) {
-    std::scoped_lock lk{mutex};
-
+    // The DTV belongs to the calling thread, nothing needs to be synchronized unless it has to
+    // grow or the TLS block of the module is not allocated yet.
     DtvEntry* dtv_table = GetTcbBase()->tcb_dtv;
-    if (dtv_table[0].counter != dtv_generation_counter) {
+    if (void* addr = TryGetTlsAddr(dtv_table, GenerationCounter(), module_index, offset)) {
+        return addr;
+    }
+
+    std::scoped_lock lk{mutex};
+    const u32 dtv_generation = GenerationCounter();
+    if (dtv_table[0].counter != dtv_generation) {
         // Generation counter changed, a dynamic module was either loaded or unloaded.
         const u32 old_num_dtvs = dtv_table[1].counter;
         ASSERT_MSG(max_tls_index > old_num_dtvs, "Module unloading unsupported");
         // Module was loaded, increase DTV table size.
         DtvEntry* new_dtv_table = new DtvEntry[max_tls_index + 2]{};
         std::memcpy(new_dtv_table + 2, dtv_table + 2, old_num_dtvs * sizeof(DtvEntry));
-        new_dtv_table[0].counter = dtv_generation_counter;
+        new_dtv_table[0].counter = dtv_generation;
         new_dtv_table[1].counter = max_tls_index;
         delete[] dtv_table;
 
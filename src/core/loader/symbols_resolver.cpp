@@ -1,6 +1,9 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <functional>
+#include <iterator>
+
 #include <fmt/format.h>
 #include "common/io_file.h"
 #include "common/string_util.h"
@@ -10,20 +13,44 @@
 
 namespace Core::Loader {
 
+using NameBuffer = fmt::basic_memory_buffer<char, 256>;
+
+static std::string_view FormatName(NameBuffer& buffer, const SymbolResolver& s) {
+    fmt::format_to(std::back_inserter(buffer), "{}#{}#{}#{}#{}#{}#{}", s.name, s.library,
+                   s.library_version, s.module, s.module_version_major, s.module_version_minor,
+                   SymbolsResolver::SymbolTypeToS(s.type));
+    return std::string_view{buffer.data(), buffer.size()};
+}
+
+static u64 HashName(std::string_view name) {
+    return std::hash<std::string_view>{}(name);
+}
+
 void SymbolsResolver::AddSymbol(const SymbolResolver& s, u64 virtual_addr) {
-    m_symbols.emplace_back(GenerateName(s), s.nidName, virtual_addr);
+    NameBuffer buffer;
+    const std::string_view name = FormatName(buffer, s);
+    // Only the first of duplicate symbols is ever found, like the linear search used to do.
+    if (!FindSymbol(name)) {
+        m_index.emplace(HashName(name), static_cast<u32>(m_symbols.size()));
+    }
+    m_symbols.emplace_back(std::string{name}, s.nidName, virtual_addr);
 }
 
 std::string SymbolsResolver::GenerateName(const SymbolResolver& s) {
-    return fmt::format("{}#{}#{}#{}#{}#{}#{}", s.name, s.library, s.library_version, s.module,
-                       s.module_version_major, s.module_version_minor, SymbolTypeToS(s.type));
+    NameBuffer buffer;
+    return std::string{FormatName(buffer, s)};
 }
 
 const SymbolRecord* SymbolsResolver::FindSymbol(const SymbolResolver& s) const {
-    const std::string name = GenerateName(s);
-    for (u32 i = 0; i < m_symbols.size(); i++) {
-        if (m_symbols[i].name == name) {
-            return &m_symbols[i];
+    NameBuffer buffer;
+    return FindSymbol(FormatName(buffer, s));
+}
+
+const SymbolRecord* SymbolsResolver::FindSymbol(std::string_view name) const {
+    const auto [begin, end] = m_index.equal_range(HashName(name));
+    for (auto it = begin; it != end; ++it) {
+        if (m_symbols[it->second].name == name) {
+            return &m_symbols[it->second];
         }
     }
 
@@ -6,6 +6,8 @@
 #include <filesystem>
 #include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include "common/types.h"
 
@@ -72,7 +74,11 @@ public:
     }
 
 private:
+    const SymbolRecord* FindSymbol(std::string_view name) const;
+
     std::vector<SymbolRecord> m_symbols;
+    /// Hash of the generated name to the index of its record, for lookups by relocation.
+    std::unordered_multimap<u64, u32> m_index;
 };
 
 } // namespace Core::Loader
@@ -1,6 +1,8 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <mutex>
+#include <unordered_map>
 #include <cryptopp/sha.h>
 
 #include "common/alignment.h"
@@ -61,12 +63,11 @@ static std::string EncodeId(u64 nVal) {
 static std::string StringToNid(std::string_view symbol) {
     static constexpr std::array<u8, 16> Salt = {0x51, 0x8D, 0x64, 0xA6, 0x35, 0xDE, 0xD8, 0xC1,
                                                 0xE6, 0xB0, 0x39, 0xB1, 0xC3, 0xE5, 0x52, 0x30};
-    std::vector<u8> input(symbol.size() + Salt.size());
-    std::memcpy(input.data(), symbol.data(), symbol.size());
-    std::memcpy(input.data() + symbol.size(), Salt.data(), Salt.size());
-
     std::array<u8, CryptoPP::SHA1::DIGESTSIZE> hash;
-    CryptoPP::SHA1().CalculateDigest(hash.data(), input.data(), input.size());
+    CryptoPP::SHA1 sha1;
+    sha1.Update(reinterpret_cast<const u8*>(symbol.data()), symbol.size());
+    sha1.Update(Salt.data(), Salt.size());
+    sha1.Final(hash.data());
 
     u64 digest;
     std::memcpy(&digest, hash.data(), sizeof(digest));
@@ -82,13 +83,30 @@ static std::string StringToNid(std::string_view symbol) {
     return dst;
 }
 
+/// Returns the NID of a symbol name, remembering names that were already hashed. Guest code
+/// tends to look up the same few names with dlsym over and over.
+static std::string_view CachedStringToNid(std::string_view symbol) {
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const noexcept {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::string, StringHash, std::equal_to<>> cache;
+
+    std::scoped_lock lk{mutex};
+    if (const auto it = cache.find(symbol); it != cache.end()) {
+        return it->second;
+    }
+    return cache.emplace(symbol, StringToNid(symbol)).first->second;
+}
+
 Module::Module(Core::MemoryManager* memory_, const std::filesystem::path& file_, u32& max_tls_index)
     : memory{memory_}, file{file_}, name{file.stem().string()} {
     elf.Open(file);
     if (elf.IsElfFile()) {
         LoadModuleToMemory(max_tls_index);
-        LoadDynamicInfo();
-        LoadSymbols();
     }
 }
 
@@ -516,7 +534,7 @@ const LibraryInfo* Module::FindLibrary(std::string_view id) {
 }
 
 void* Module::FindByName(std::string_view name) {
-    const auto nid_str = StringToNid(name);
+    const std::string_view nid_str = CachedStringToNid(name);
     const auto symbols = export_sym.GetSymbols();
     const auto it = std::ranges::find_if(
         symbols, [&](const Loader::SymbolRecord& record) { return record.name.contains(nid_str); });
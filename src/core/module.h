@@ -205,6 +205,9 @@ public:
 
     s32 Start(size_t args, const void* argp, void* param);
     void LoadModuleToMemory(u32& max_tls_index);
+
+    /// Parses the dynamic section and symbol tables of the module. Only touches state of the
+    /// module itself, so several modules can be parsed at the same time.
     void LoadDynamicInfo();
     void LoadSymbols();
 
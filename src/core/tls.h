@@ -27,6 +27,18 @@ struct Tcb {
     ::Libraries::Fiber::OrbisFiberContext* tcb_fiber;
 };
 
+/// Returns the address of a thread local variable if the DTV is current with the given generation
+/// and the TLS block of the module is allocated, nullptr otherwise.
+inline void* TryGetTlsAddr(const DtvEntry* dtv_table, std::size_t generation, u64 module_index,
+                           u64 offset) {
+    // Dtv[0] is the generation counter and dtv[1] the number of modules it has room for.
+    if (dtv_table[0].counter != generation || module_index > dtv_table[1].counter) {
+        return nullptr;
+    }
+    u8* addr = dtv_table[module_index + 1].pointer;
+    return addr ? addr + offset : nullptr;
+}
+
 #ifdef _WIN32
 /// Gets the thread local storage key for the TCB block.
 u32 GetTcbKey();
@@ -23,6 +23,7 @@
 #include "common/scm_rev.h"
 #include "common/singleton.h"
 #include "common/version.h"
+#include "core/cpu_patches.h"
 #include "core/file_format/psf.h"
 #include "core/file_format/splash.h"
 #include "core/file_format/trp.h"
@@ -61,6 +62,7 @@ Emulator::Emulator() {
     LOG_INFO(Config, "General isNeo: {}", Config::isNeoModeConsole());
     LOG_INFO(Config, "GPU isNullGpu: {}", Config::nullGpu());
     LOG_INFO(Config, "GPU shouldDumpShaders: {}", Config::dumpShaders());
+    LOG_INFO(Config, "GPU shaderPassStats: {}", Config::collectShaderPassStats());
     LOG_INFO(Config, "GPU vblankDivider: {}", Config::vblankDiv());
     LOG_INFO(Config, "Vulkan gpuId: {}", Config::getGpuId());
     LOG_INFO(Config, "Vulkan vkValidation: {}", Config::vkValidationEnabled());
@@ -213,6 +215,7 @@ void Emulator::Run(const std::filesystem::path& file) {
     Libraries::InitHLELibs(&linker->GetHLESymbols());
 
     // Load the module with the linker
+    const auto load_start = std::chrono::steady_clock::now();
     const auto eboot_path = mnt->GetHostPath("/app0/" + file.filename().string());
     linker->LoadModule(eboot_path);
 
@@ -252,6 +255,9 @@ void Emulator::Run(const std::filesystem::path& file) {
         LOG_INFO(Loader, "Loading {}", fmt::UTF(module_path.u8string()));
         linker->LoadModule(module_path);
     }
+    const std::chrono::duration<double, std::milli> load_time =
+        std::chrono::steady_clock::now() - load_start;
+    LOG_INFO(Loader, "Mapped modules in {:.2f} ms", load_time.count());
 
 #ifdef ENABLE_DISCORD_RPC
     // Discord RPC
@@ -275,6 +281,8 @@ void Emulator::Run(const std::filesystem::path& file) {
     UpdatePlayTime(id);
 #endif
 
+    Core::FlushPatchSites();
+
     std::exit(0);
 }
 
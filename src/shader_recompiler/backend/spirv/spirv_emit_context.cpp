@@ -277,42 +277,37 @@ void EmitContext::DefineInputs() {
         base_vertex = DefineVariable(U32[1], spv::BuiltIn::BaseVertex, spv::StorageClass::Input);
         instance_id = DefineVariable(U32[1], spv::BuiltIn::InstanceIndex, spv::StorageClass::Input);
 
-        const auto fetch_shader = Gcn::ParseFetchShader(info);
-        if (!fetch_shader) {
-            break;
-        }
-        for (const auto& attrib : fetch_shader->attributes) {
-            ASSERT(attrib.semantic < IR::NumParams);
-            const auto sharp = attrib.GetSharp(info);
-            const Id type{GetAttributeType(*this, sharp.GetNumberFmt())[4]};
-            if (attrib.UsesStepRates()) {
-                const u32 rate_idx =
-                    attrib.GetStepRate() == Gcn::VertexAttribute::InstanceIdType::OverStepRate0 ? 0
-                                                                                                : 1;
-                const u32 num_components = AmdGpu::NumComponents(sharp.GetDataFmt());
+        using InstanceIdType = Gcn::VertexAttribute::InstanceIdType;
+        for (const auto& input : info.vs_inputs) {
+            ASSERT(input.semantic < IR::NumParams);
+            const auto step_rate = static_cast<InstanceIdType>(input.instance_data);
+            const Id type{GetAttributeType(*this, input.num_fmt)[4]};
+            if (step_rate == InstanceIdType::OverStepRate0 ||
+                step_rate == InstanceIdType::OverStepRate1) {
+                const u32 rate_idx = step_rate == InstanceIdType::OverStepRate0 ? 0 : 1;
+                const u32 num_components = AmdGpu::NumComponents(input.data_fmt);
                 const auto buffer =
-                    std::ranges::find_if(info.buffers, [&attrib](const auto& buffer) {
-                        return buffer.instance_attrib == attrib.semantic;
+                    std::ranges::find_if(info.buffers, [&input](const auto& buffer) {
+                        return buffer.instance_attrib == input.semantic;
                     });
                 // Note that we pass index rather than Id
-                input_params[attrib.semantic] = SpirvAttribute{
+                input_params[input.semantic] = SpirvAttribute{
                     .id = {rate_idx},
                     .pointer_type = input_u32,
                     .component_type = U32[1],
-                    .num_components = std::min<u16>(attrib.num_elements, num_components),
+                    .num_components = std::min<u16>(input.num_elements, num_components),
                     .is_integer = true,
                     .is_loaded = false,
                     .buffer_handle = int(buffer - info.buffers.begin()),
                 };
             } else {
-                Id id{DefineInput(type, attrib.semantic)};
-                if (attrib.GetStepRate() == Gcn::VertexAttribute::InstanceIdType::Plain) {
-                    Name(id, fmt::format("vs_instance_attr{}", attrib.semantic));
+                Id id{DefineInput(type, input.semantic)};
+                if (step_rate == InstanceIdType::Plain) {
+                    Name(id, fmt::format("vs_instance_attr{}", input.semantic));
                 } else {
-                    Name(id, fmt::format("vs_in_attr{}", attrib.semantic));
+                    Name(id, fmt::format("vs_in_attr{}", input.semantic));
                 }
-                input_params[attrib.semantic] =
-                    GetAttributeInfo(sharp.GetNumberFmt(), id, 4, false);
+                input_params[input.semantic] = GetAttributeInfo(input.num_fmt, id, 4, false);
             }
         }
         break;
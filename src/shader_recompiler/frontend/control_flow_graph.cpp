@@ -58,8 +58,9 @@ static bool IgnoresExecMask(Opcode opcode) {
 
 static constexpr size_t LabelReserveSize = 32;
 
-CFG::CFG(Common::ObjectPool<Block>& block_pool_, std::span<const GcnInst> inst_list_)
-    : block_pool{block_pool_}, inst_list{inst_list_} {
+CFG::CFG(Common::ObjectPool<Block>& block_pool_, std::span<const GcnInst> inst_list_,
+         std::pmr::memory_resource* resource)
+    : block_pool{block_pool_}, inst_list{inst_list_}, index_to_pc{resource} {
     index_to_pc.resize(inst_list.size() + 1);
     labels.reserve(LabelReserveSize);
     EmitLabels();
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <algorithm>
+#include <memory_resource>
 #include <span>
 #include <string>
 #include <boost/container/small_vector.hpp>
@@ -51,7 +52,8 @@ class CFG {
     using Label = u32;
 
 public:
-    explicit CFG(Common::ObjectPool<Block>& block_pool, std::span<const GcnInst> inst_list);
+    explicit CFG(Common::ObjectPool<Block>& block_pool, std::span<const GcnInst> inst_list,
+                 std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     [[nodiscard]] std::string Dot() const;
 
@@ -80,7 +82,7 @@ private:
 public:
     Common::ObjectPool<Block>& block_pool;
     std::span<const GcnInst> inst_list;
-    std::vector<u32> index_to_pc;
+    std::pmr::vector<u32> index_to_pc;
     boost::container::small_vector<Label, 16> labels;
     boost::intrusive::set<Block> blocks;
 };
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include <algorithm>
+#include <array>
 #include "common/assert.h"
 #include "shader_recompiler/frontend/decode.h"
 
@@ -16,74 +17,137 @@ T extract(T value, u32 lst, u32 fst) {
 }
 } // namespace bit
 
-InstEncoding GetInstructionEncoding(u32 token) {
-    auto encoding = static_cast<InstEncoding>(token & (u32)EncodingMask::MASK_9bit);
-    switch (encoding) {
-    case InstEncoding::SOP1:
-    case InstEncoding::SOPP:
-    case InstEncoding::SOPC:
-        return encoding;
-    default:
-        break;
+namespace {
+
+constexpr InstEncoding ClassifyEncoding(u32 token) {
+    // Masks are tried from the longest to the shortest, as shorter encodings are prefixes of
+    // longer ones.
+    const auto matches = [token](EncodingMask mask, InstEncoding encoding) {
+        return (token & static_cast<u32>(mask)) == static_cast<u32>(encoding);
+    };
+    for (const auto encoding : {InstEncoding::SOP1, InstEncoding::SOPP, InstEncoding::SOPC}) {
+        if (matches(EncodingMask::MASK_9bit, encoding)) {
+            return encoding;
+        }
+    }
+    for (const auto encoding : {InstEncoding::VOP1, InstEncoding::VOPC}) {
+        if (matches(EncodingMask::MASK_7bit, encoding)) {
+            return encoding;
+        }
     }
+    for (const auto encoding : {InstEncoding::VOP3, InstEncoding::EXP, InstEncoding::VINTRP,
+                                InstEncoding::DS, InstEncoding::MUBUF, InstEncoding::MTBUF,
+                                InstEncoding::MIMG}) {
+        if (matches(EncodingMask::MASK_6bit, encoding)) {
+            return encoding;
+        }
+    }
+    if (matches(EncodingMask::MASK_5bit, InstEncoding::SMRD)) {
+        return InstEncoding::SMRD;
+    }
+    if (matches(EncodingMask::MASK_4bit, InstEncoding::SOPK)) {
+        return InstEncoding::SOPK;
+    }
+    if (matches(EncodingMask::MASK_2bit, InstEncoding::SOP2)) {
+        return InstEncoding::SOP2;
+    }
+    if (matches(EncodingMask::MASK_1bit, InstEncoding::VOP2)) {
+        return InstEncoding::VOP2;
+    }
+    return InstEncoding::ILLEGAL;
+}
 
-    encoding = static_cast<InstEncoding>(token & (u32)EncodingMask::MASK_7bit);
-    switch (encoding) {
-    case InstEncoding::VOP1:
-    case InstEncoding::VOPC:
-        return encoding;
-    default:
-        break;
+constexpr u32 EncodingBits = 9;
+constexpr u32 EncodingShift = 32 - EncodingBits;
+
+/// Encoding of every possible value of the 9 most significant bits of the first token.
+/// All encoding masks fit within these bits.
+constexpr std::array<InstEncoding, 1U << EncodingBits> EncodingTable = [] {
+    std::array<InstEncoding, 1U << EncodingBits> table{};
+    for (u32 i = 0; i < table.size(); ++i) {
+        table[i] = ClassifyEncoding(i << EncodingShift);
     }
+    return table;
+}();
+
+constexpr bool IsLiteral(u32 code) {
+    return code == static_cast<u32>(OperandField::LiteralConst);
+}
+
+} // Anonymous namespace
+
+InstEncoding GetInstructionEncoding(u32 token) {
+    return EncodingTable[token >> EncodingShift];
+}
 
-    encoding = static_cast<InstEncoding>(token & (u32)EncodingMask::MASK_6bit);
+u32 GetEncodingLength(InstEncoding encoding) {
     switch (encoding) {
     case InstEncoding::VOP3:
-    case InstEncoding::EXP:
-    case InstEncoding::VINTRP:
-    case InstEncoding::DS:
     case InstEncoding::MUBUF:
     case InstEncoding::MTBUF:
     case InstEncoding::MIMG:
-        return encoding;
+    case InstEncoding::DS:
+    case InstEncoding::EXP:
+        return sizeof(u64);
+    case InstEncoding::ILLEGAL:
+        return 0;
     default:
-        break;
+        return sizeof(u32);
     }
+}
 
-    encoding = static_cast<InstEncoding>(token & (u32)EncodingMask::MASK_5bit);
+u32 GetInstructionLength(std::span<const u32> code) {
+    const u32 token = code[0];
+    const InstEncoding encoding = GetInstructionEncoding(token);
+    const auto ssrc = [token](u32 index) { return (token >> (index * 8)) & 0xFF; };
+    bool has_literal = false;
     switch (encoding) {
-    case InstEncoding::SMRD:
-        return encoding;
-    default:
+    case InstEncoding::SOP2:
+    case InstEncoding::SOPC:
+        has_literal = IsLiteral(ssrc(0)) || IsLiteral(ssrc(1));
+        break;
+    case InstEncoding::SOP1:
+        has_literal = IsLiteral(ssrc(0));
         break;
-    }
-
-    encoding = static_cast<InstEncoding>(token & (u32)EncodingMask::MASK_4bit);
-    switch (encoding) {
     case InstEncoding::SOPK:
-        return encoding;
-    default:
+        has_literal =
+            bit::extract(token, 27, 23) == static_cast<u32>(OpcodeSOPK::S_SETREG_IMM32_B32);
         break;
-    }
-
-    encoding = static_cast<InstEncoding>(token & (u32)EncodingMask::MASK_2bit);
-    switch (encoding) {
-    case InstEncoding::SOP2:
-        return encoding;
-    default:
+    case InstEncoding::SMRD:
+        has_literal = bit::extract(token, 8, 8) == 0 && IsLiteral(ssrc(0));
+        break;
+    case InstEncoding::VOP1:
+    case InstEncoding::VOPC:
+        has_literal = IsLiteral(bit::extract(token, 8, 0));
+        break;
+    case InstEncoding::VOP2: {
+        const auto op = static_cast<OpcodeVOP2>(bit::extract(token, 30, 25));
+        // Lane instructions take a scalar vsrc1, which can be a literal as well.
+        const bool scalar_src1 =
+            op == OpcodeVOP2::V_READLANE_B32 || op == OpcodeVOP2::V_WRITELANE_B32;
+        has_literal = IsLiteral(bit::extract(token, 8, 0)) ||
+                      (scalar_src1 && IsLiteral(bit::extract(token, 16, 9))) ||
+                      op == OpcodeVOP2::V_MADMK_F32 || op == OpcodeVOP2::V_MADAK_F32;
         break;
     }
-
-    encoding = static_cast<InstEncoding>(token & (u32)EncodingMask::MASK_1bit);
-    switch (encoding) {
-    case InstEncoding::VOP2:
-        return encoding;
     default:
         break;
     }
+    return GetEncodingLength(encoding) + (has_literal ? sizeof(u32) : 0);
+}
 
-    UNREACHABLE();
-    return InstEncoding::ILLEGAL;
+size_t CountInstructions(std::span<const u32> code) {
+    size_t num_insts{};
+    size_t offset{};
+    while (offset < code.size()) {
+        const u32 length = GetInstructionLength(code.subspan(offset));
+        if (length == 0) {
+            break;
+        }
+        offset += length / sizeof(u32);
+        ++num_insts;
+    }
+    return num_insts;
 }
 
 bool HasAdditionalLiteral(InstEncoding encoding, Opcode opcode) {
@@ -112,7 +176,7 @@ GcnInst GcnDecodeContext::decodeInstruction(GcnCodeSlice& code) {
 
     InstEncoding encoding = GetInstructionEncoding(token);
     ASSERT_MSG(encoding != InstEncoding::ILLEGAL, "illegal encoding");
-    uint32_t encodingLen = getEncodingLength(encoding);
+    uint32_t encodingLen = GetEncodingLength(encoding);
 
     // Clear the instruction
     m_instruction = GcnInst();
@@ -137,37 +201,6 @@ GcnInst GcnDecodeContext::decodeInstruction(GcnCodeSlice& code) {
     return m_instruction;
 }
 
-uint32_t GcnDecodeContext::getEncodingLength(InstEncoding encoding) {
-    uint32_t instLength = 0;
-
-    switch (encoding) {
-    case InstEncoding::SOP1:
-    case InstEncoding::SOPP:
-    case InstEncoding::SOPC:
-    case InstEncoding::SOPK:
-    case InstEncoding::SOP2:
-    case InstEncoding::VOP1:
-    case InstEncoding::VOPC:
-    case InstEncoding::VOP2:
-    case InstEncoding::SMRD:
-    case InstEncoding::VINTRP:
-        instLength = sizeof(uint32_t);
-        break;
-
-    case InstEncoding::VOP3:
-    case InstEncoding::MUBUF:
-    case InstEncoding::MTBUF:
-    case InstEncoding::MIMG:
-    case InstEncoding::DS:
-    case InstEncoding::EXP:
-        instLength = sizeof(uint64_t);
-        break;
-    default:
-        break;
-    }
-    return instLength;
-}
-
 uint32_t GcnDecodeContext::getOpMapOffset(InstEncoding encoding) {
     uint32_t offset = 0;
     switch (encoding) {
@@ -267,7 +300,7 @@ void GcnDecodeContext::updateInstructionMeta(InstEncoding encoding) {
     m_instruction.category = instFormat.inst_category;
     m_instruction.encoding = encoding;
     m_instruction.src_count = instFormat.src_count;
-    m_instruction.length = getEncodingLength(encoding);
+    m_instruction.length = GetEncodingLength(encoding);
 
     // Update src operand scalar type.
     auto setOperandType = [&instFormat](InstOperand& src) {
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <span>
 #include "shader_recompiler/frontend/instruction.h"
 
 namespace Shader::Gcn {
@@ -18,8 +19,16 @@ struct InstFormat {
 
 InstEncoding GetInstructionEncoding(u32 token);
 
+/// Returns the size in bytes of an encoding without any literal constant.
 u32 GetEncodingLength(InstEncoding encoding);
 
+/// Returns the size in bytes of the instruction starting at the first token, including its
+/// literal constant. Returns zero for an illegal encoding.
+u32 GetInstructionLength(std::span<const u32> code);
+
+/// Counts instructions by walking their lengths without fully decoding them.
+size_t CountInstructions(std::span<const u32> code);
+
 InstFormat InstructionFormat(InstEncoding encoding, u32 opcode);
 
 Opcode DecodeOpcode(u32 token);
@@ -48,6 +57,10 @@ public:
         return m_ptr == m_end;
     }
 
+    std::span<const u32> remaining() const {
+        return {m_ptr, m_end};
+    }
+
 private:
     const u32* m_ptr{};
     const u32* m_end{};
@@ -58,7 +71,6 @@ public:
     GcnInst decodeInstruction(GcnCodeSlice& code);
 
 private:
-    uint32_t getEncodingLength(InstEncoding encoding);
     uint32_t getOpMapOffset(InstEncoding encoding);
     uint32_t mapEncodingOp(InstEncoding encoding, Opcode opcode);
     void updateInstructionMeta(InstEncoding encoding);
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -288,8 +289,10 @@ bool NeedsLift(Node goto_stmt, Node label_stmt) noexcept {
  */
 class GotoPass {
 public:
-    explicit GotoPass(CFG& cfg, Common::ObjectPool<Statement>& stmt_pool) : pool{stmt_pool} {
-        std::vector gotos{BuildTree(cfg)};
+    explicit GotoPass(CFG& cfg, Common::ObjectPool<Statement>& stmt_pool,
+                      std::pmr::memory_resource* resource_)
+        : pool{stmt_pool}, resource{resource_} {
+        std::pmr::vector<Node> gotos{BuildTree(cfg)};
         const auto end{gotos.rend()};
         for (auto goto_stmt = gotos.rbegin(); goto_stmt != end; ++goto_stmt) {
             RemoveGoto(*goto_stmt);
@@ -351,18 +354,18 @@ private:
         }
     }
 
-    std::vector<Node> BuildTree(CFG& cfg) {
+    std::pmr::vector<Node> BuildTree(CFG& cfg) {
         u32 label_id{0};
-        std::vector<Node> gotos;
+        std::pmr::vector<Node> gotos{resource};
         BuildTree(cfg, label_id, gotos, root_stmt.children.end(), std::nullopt);
         return gotos;
     }
 
-    void BuildTree(CFG& cfg, u32& label_id, std::vector<Node>& gotos, Node function_insert_point,
-                   std::optional<Node> return_label) {
+    void BuildTree(CFG& cfg, u32& label_id, std::pmr::vector<Node>& gotos,
+                   Node function_insert_point, std::optional<Node> return_label) {
         Statement* const false_stmt{pool.Create(Identity{}, IR::Condition::False, &root_stmt)};
         Tree& root{root_stmt.children};
-        std::unordered_map<Block*, Node> local_labels;
+        std::pmr::unordered_map<Block*, Node> local_labels{resource};
         local_labels.reserve(cfg.blocks.size());
 
         for (Block& block : cfg.blocks) {
@@ -565,6 +568,7 @@ private:
     }
 
     Common::ObjectPool<Statement>& pool;
+    std::pmr::memory_resource* resource;
     Statement root_stmt{FunctionTag{}};
 };
 
@@ -825,9 +829,10 @@ private:
 
 IR::AbstractSyntaxList BuildASL(Common::ObjectPool<IR::Inst>& inst_pool,
                                 Common::ObjectPool<IR::Block>& block_pool, CFG& cfg, Info& info,
-                                const RuntimeInfo& runtime_info, const Profile& profile) {
+                                const RuntimeInfo& runtime_info, const Profile& profile,
+                                std::pmr::memory_resource* resource) {
     Common::ObjectPool<Statement> stmt_pool{64};
-    GotoPass goto_pass{cfg, stmt_pool};
+    GotoPass goto_pass{cfg, stmt_pool, resource};
     Statement& root{goto_pass.RootStatement()};
     IR::AbstractSyntaxList syntax_list;
     TranslatePass{inst_pool,     block_pool, stmt_pool,    root,   syntax_list,
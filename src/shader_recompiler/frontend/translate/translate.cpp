@@ -476,6 +476,13 @@ void Translator::EmitFetch(const GcnInst& inst) {
 
         // Read the V# of the attribute to figure out component number and type.
         const auto buffer = info.ReadUdReg<AmdGpu::Buffer>(attrib.sgpr_base, attrib.dword_offset);
+        info.vs_inputs.push_back({
+            .semantic = attrib.semantic,
+            .num_elements = attrib.num_elements,
+            .instance_data = attrib.instance_data,
+            .num_fmt = buffer.GetNumberFmt(),
+            .data_fmt = buffer.GetDataFmt(),
+        });
         const auto values =
             ir.CompositeConstruct(ir.GetAttribute(attr, 0), ir.GetAttribute(attr, 1),
                                   ir.GetAttribute(attr, 2), ir.GetAttribute(attr, 3));
@@ -0,0 +1,156 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <type_traits>
+
+#include "common/serdes.h"
+#include "shader_recompiler/info.h"
+
+namespace Shader {
+
+namespace {
+
+struct CopyShaderEntry {
+    u32 offset;
+    IR::Attribute attribute;
+    u32 component;
+};
+
+// Types written as raw bytes. Changing their layout requires bumping SerializationVersion.
+static_assert(std::is_trivially_copyable_v<CopyShaderEntry>);
+static_assert(std::is_trivially_copyable_v<BufferResource>);
+static_assert(std::is_trivially_copyable_v<TextureBufferResource>);
+static_assert(std::is_trivially_copyable_v<ImageResource>);
+static_assert(std::is_trivially_copyable_v<SamplerResource>);
+static_assert(std::is_trivially_copyable_v<FMaskResource>);
+static_assert(std::is_trivially_copyable_v<VsInput>);
+static_assert(std::is_trivially_copyable_v<decltype(Info::loads)>);
+static_assert(std::is_trivially_copyable_v<decltype(Info::stores)>);
+static_assert(std::is_trivially_copyable_v<PersistentSrtInfo::SrtSharpReservation>);
+static_assert(std::is_trivially_copyable_v<SrtWalkerProgram::value_type>);
+
+} // Anonymous namespace
+
+void Info::Serialize(Serialization::Writer& writer) const {
+    writer.Write(SerializationVersion);
+    writer.Write(stage);
+    writer.Write(l_stage);
+    writer.Write(pgm_hash);
+    writer.Write(loads);
+    writer.Write(stores);
+    writer.Write(ud_mask);
+
+    std::vector<CopyShaderEntry> copy_entries;
+    copy_entries.reserve(gs_copy_data.attr_map.size());
+    for (const auto& [offset, attr] : gs_copy_data.attr_map) {
+        copy_entries.emplace_back(offset, attr.first, attr.second);
+    }
+    writer.WriteVector(copy_entries);
+    writer.Write(gs_copy_data.num_attrs);
+    writer.Write(uses_patches);
+
+    writer.WriteVector(buffers);
+    writer.WriteVector(texture_buffers);
+    writer.WriteVector(images);
+    writer.WriteVector(samplers);
+    writer.WriteVector(fmasks);
+    writer.WriteVector(vs_inputs);
+
+    writer.WriteVector(srt_info.srt_reservations);
+    writer.WriteVector(srt_info.walker_program);
+    writer.Write(srt_info.flattened_bufsize_dw);
+
+    writer.Write(tess_consts_ptr_base);
+    writer.Write(tess_consts_dword_offset);
+
+    writer.Write(has_storage_images);
+    writer.Write(has_image_buffers);
+    writer.Write(has_texel_buffers);
+    writer.Write(has_discard);
+    writer.Write(has_image_gather);
+    writer.Write(has_image_query);
+    writer.Write(uses_lane_id);
+    writer.Write(uses_group_quad);
+    writer.Write(uses_group_ballot);
+    writer.Write(uses_shared);
+    writer.Write(uses_fp16);
+    writer.Write(uses_fp64);
+    writer.Write(stores_tess_level_outer);
+    writer.Write(stores_tess_level_inner);
+    writer.Write(translation_failed);
+    writer.Write(has_readconst);
+    writer.Write(mrt_mask);
+    writer.Write(has_fetch_shader);
+    writer.Write(fetch_shader_sgpr_base);
+}
+
+bool Info::Deserialize(Serialization::Reader& reader) {
+    u32 version{};
+    Stage saved_stage{};
+    LogicalStage saved_l_stage{};
+    u64 saved_hash{};
+    reader.Read(version);
+    reader.Read(saved_stage);
+    reader.Read(saved_l_stage);
+    reader.Read(saved_hash);
+    if (reader.Failed() || version != SerializationVersion || saved_stage != stage ||
+        saved_l_stage != l_stage || saved_hash != pgm_hash) {
+        return false;
+    }
+
+    reader.Read(loads);
+    reader.Read(stores);
+    reader.Read(ud_mask);
+
+    std::vector<CopyShaderEntry> copy_entries;
+    reader.ReadVector(copy_entries);
+    for (const auto& [offset, attribute, component] : copy_entries) {
+        gs_copy_data.attr_map.emplace(offset, std::make_pair(attribute, component));
+    }
+    reader.Read(gs_copy_data.num_attrs);
+    reader.Read(uses_patches);
+
+    reader.ReadVector(buffers);
+    reader.ReadVector(texture_buffers);
+    reader.ReadVector(images);
+    reader.ReadVector(samplers);
+    reader.ReadVector(fmasks);
+    reader.ReadVector(vs_inputs);
+
+    reader.ReadVector(srt_info.srt_reservations);
+    reader.ReadVector(srt_info.walker_program);
+    reader.Read(srt_info.flattened_bufsize_dw);
+
+    reader.Read(tess_consts_ptr_base);
+    reader.Read(tess_consts_dword_offset);
+
+    reader.Read(has_storage_images);
+    reader.Read(has_image_buffers);
+    reader.Read(has_texel_buffers);
+    reader.Read(has_discard);
+    reader.Read(has_image_gather);
+    reader.Read(has_image_query);
+    reader.Read(uses_lane_id);
+    reader.Read(uses_group_quad);
+    reader.Read(uses_group_ballot);
+    reader.Read(uses_shared);
+    reader.Read(uses_fp16);
+    reader.Read(uses_fp64);
+    reader.Read(stores_tess_level_outer);
+    reader.Read(stores_tess_level_inner);
+    reader.Read(translation_failed);
+    reader.Read(has_readconst);
+    reader.Read(mrt_mask);
+    reader.Read(has_fetch_shader);
+    reader.Read(fetch_shader_sgpr_base);
+    if (reader.Failed()) {
+        return false;
+    }
+
+    // The SRT walker is host code, regenerate it from its description.
+    const auto& ops = srt_info.walker_program;
+    srt_info.walker_func = ops.empty() ? nullptr : CompileSrtWalker({ops.data(), ops.size()});
+    return true;
+}
+
+} // namespace Shader
@@ -21,6 +21,11 @@
 #include "video_core/amdgpu/liverpool.h"
 #include "video_core/amdgpu/resource.h"
 
+namespace Serialization {
+class Writer;
+class Reader;
+} // namespace Serialization
+
 namespace Shader {
 
 static constexpr size_t NumUserDataRegs = 16;
@@ -99,6 +104,17 @@ struct FMaskResource {
 };
 using FMaskResourceList = boost::container::small_vector<FMaskResource, 16>;
 
+/// Vertex attribute loaded by the fetch shader, with the formats of its V# resolved during
+/// translation so the backend does not have to read guest memory.
+struct VsInput {
+    u8 semantic;
+    u8 num_elements;
+    u8 instance_data; ///< Gcn::VertexAttribute::InstanceIdType
+    AmdGpu::NumberFormat num_fmt;
+    AmdGpu::DataFormat data_fmt;
+};
+using VsInputList = boost::container::small_vector<VsInput, 8>;
+
 struct PushData {
     static constexpr u32 BufOffsetIndex = 2;
     static constexpr u32 UdRegsIndex = 4;
@@ -177,6 +193,7 @@ struct Info {
     ImageResourceList images;
     SamplerResourceList samplers;
     FMaskResourceList fmasks;
+    VsInputList vs_inputs;
 
     PersistentSrtInfo srt_info;
     std::vector<u32> flattened_ud_buf;
@@ -259,6 +276,15 @@ struct Info {
         }
     }
 
+    /// Version of the serialized analysis results. Bump when any serialized field or the layout
+    /// of a type written as raw bytes changes.
+    static constexpr u32 SerializationVersion = 2;
+
+    /// Serializes the results of program analysis. Runtime state (user data, program base) is
+    /// not included and must be supplied by the constructor when loading.
+    void Serialize(Serialization::Writer& writer) const;
+    bool Deserialize(Serialization::Reader& reader);
+
     void ReadTessConstantBuffer(TessellationDataConstantBuffer& tess_constants) const {
         ASSERT(tess_consts_dword_offset >= 0); // We've already tracked the V# UD
         auto buf = ReadUdReg<AmdGpu::Buffer>(static_cast<u32>(tess_consts_ptr_base),
@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "shader_recompiler/ir/dominator_tree.h"
+
+namespace Shader::IR {
+
+static constexpr u32 Undefined = ~0U;
+
+DominatorTree::DominatorTree(const BlockList& post_order_blocks)
+    : rpo_blocks(post_order_blocks.rbegin(), post_order_blocks.rend()) {
+    const u32 num_blocks = static_cast<u32>(rpo_blocks.size());
+    block_index.reserve(num_blocks);
+    for (u32 i = 0; i < num_blocks; ++i) {
+        block_index.emplace(rpo_blocks[i], i);
+    }
+    idoms.assign(num_blocks, Undefined);
+    if (num_blocks == 0) {
+        return;
+    }
+
+    // Blocks are numbered in reverse post order, so dominators have lower indices.
+    const auto intersect = [this](u32 a, u32 b) {
+        while (a != b) {
+            while (a > b) {
+                a = idoms[a];
+            }
+            while (b > a) {
+                b = idoms[b];
+            }
+        }
+        return a;
+    };
+    idoms[0] = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 i = 1; i < num_blocks; ++i) {
+            u32 new_idom = Undefined;
+            for (Block* const pred : rpo_blocks[i]->ImmPredecessors()) {
+                const auto it = block_index.find(pred);
+                if (it == block_index.end() || idoms[it->second] == Undefined) {
+                    // Unreachable or not processed yet.
+                    continue;
+                }
+                new_idom = new_idom == Undefined ? it->second : intersect(it->second, new_idom);
+            }
+            if (idoms[i] != new_idom) {
+                idoms[i] = new_idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+Block* DominatorTree::ImmediateDominator(const Block* block) const {
+    const u32 index = Index(block);
+    return index == 0 ? nullptr : rpo_blocks[idoms[index]];
+}
+
+bool DominatorTree::Dominates(const Block* a, const Block* b) const {
+    const u32 a_index = Index(a);
+    u32 b_index = Index(b);
+    while (b_index > a_index) {
+        b_index = idoms[b_index];
+    }
+    return b_index == a_index;
+}
+
+} // namespace Shader::IR
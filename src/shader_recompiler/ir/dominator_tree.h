@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "shader_recompiler/ir/basic_block.h"
+
+namespace Shader::IR {
+
+/**
+ * Immediate dominators of all blocks reachable from the entry, computed with the iterative
+ * algorithm from "A Simple, Fast Dominance Algorithm" (Cooper, Harvey, Kennedy).
+ * The tree is a snapshot, it has to be rebuilt after the control flow graph changes.
+ */
+class DominatorTree {
+public:
+    explicit DominatorTree(const BlockList& post_order_blocks);
+
+    /// Returns the immediate dominator of a block, or nullptr for the entry block.
+    [[nodiscard]] Block* ImmediateDominator(const Block* block) const;
+
+    /// Returns true if every path from the entry to b goes through a. Blocks dominate themselves.
+    [[nodiscard]] bool Dominates(const Block* a, const Block* b) const;
+
+    /// Returns the reachable blocks in reverse post order, dominators come before the blocks
+    /// they dominate.
+    [[nodiscard]] const BlockList& ReversePostOrder() const noexcept {
+        return rpo_blocks;
+    }
+
+private:
+    [[nodiscard]] u32 Index(const Block* block) const {
+        return block_index.at(const_cast<Block*>(block));
+    }
+
+    BlockList rpo_blocks;
+    std::vector<u32> idoms;
+    std::unordered_map<Block*, u32> block_index;
+};
+
+} // namespace Shader::IR
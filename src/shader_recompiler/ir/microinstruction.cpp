@@ -104,6 +104,251 @@ bool Inst::MayHaveSideEffects() const noexcept {
     }
 }
 
+bool Inst::IsPure() const noexcept {
+    // Opcodes must be added here explicitly, anything not known to be pure is assumed to depend
+    // on state other than its arguments. Loads from memory the shader can write to, image
+    // sampling (implicit derivatives depend on the active lanes) and cross lane operations are
+    // deliberately left out.
+    switch (op) {
+    // Constant memory, shader inputs and invocation ids, which do not change during an
+    // invocation. ReadConst reads the resource tables through scalar loads, passes that move it
+    // across writes to memory must check for aliasing themselves. ReadConstBuffer is not listed
+    // as it goes through a V# that may alias a buffer written by the shader.
+    case Opcode::ReadConst:
+    case Opcode::GetUserData:
+    case Opcode::GetAttribute:
+    case Opcode::GetAttributeU32:
+    case Opcode::GetTessGenericAttribute:
+    case Opcode::ImageQueryDimensions:
+    case Opcode::LaneId:
+    case Opcode::WarpId:
+    // Composites, selects and bit casts.
+    case Opcode::CompositeConstructU32x2:
+    case Opcode::CompositeConstructU32x3:
+    case Opcode::CompositeConstructU32x4:
+    case Opcode::CompositeExtractU32x2:
+    case Opcode::CompositeExtractU32x3:
+    case Opcode::CompositeExtractU32x4:
+    case Opcode::CompositeInsertU32x2:
+    case Opcode::CompositeInsertU32x3:
+    case Opcode::CompositeInsertU32x4:
+    case Opcode::CompositeShuffleU32x2:
+    case Opcode::CompositeShuffleU32x3:
+    case Opcode::CompositeShuffleU32x4:
+    case Opcode::CompositeConstructF16x2:
+    case Opcode::CompositeConstructF16x3:
+    case Opcode::CompositeConstructF16x4:
+    case Opcode::CompositeExtractF16x2:
+    case Opcode::CompositeExtractF16x3:
+    case Opcode::CompositeExtractF16x4:
+    case Opcode::CompositeInsertF16x2:
+    case Opcode::CompositeInsertF16x3:
+    case Opcode::CompositeInsertF16x4:
+    case Opcode::CompositeShuffleF16x2:
+    case Opcode::CompositeShuffleF16x3:
+    case Opcode::CompositeShuffleF16x4:
+    case Opcode::CompositeConstructF32x2:
+    case Opcode::CompositeConstructF32x3:
+    case Opcode::CompositeConstructF32x4:
+    case Opcode::CompositeExtractF32x2:
+    case Opcode::CompositeExtractF32x3:
+    case Opcode::CompositeExtractF32x4:
+    case Opcode::CompositeInsertF32x2:
+    case Opcode::CompositeInsertF32x3:
+    case Opcode::CompositeInsertF32x4:
+    case Opcode::CompositeShuffleF32x2:
+    case Opcode::CompositeShuffleF32x3:
+    case Opcode::CompositeShuffleF32x4:
+    case Opcode::CompositeConstructF64x2:
+    case Opcode::CompositeConstructF64x3:
+    case Opcode::CompositeConstructF64x4:
+    case Opcode::CompositeExtractF64x2:
+    case Opcode::CompositeExtractF64x3:
+    case Opcode::CompositeExtractF64x4:
+    case Opcode::CompositeInsertF64x2:
+    case Opcode::CompositeInsertF64x3:
+    case Opcode::CompositeInsertF64x4:
+    case Opcode::CompositeShuffleF64x2:
+    case Opcode::CompositeShuffleF64x3:
+    case Opcode::CompositeShuffleF64x4:
+    case Opcode::SelectU1:
+    case Opcode::SelectU8:
+    case Opcode::SelectU16:
+    case Opcode::SelectU32:
+    case Opcode::SelectU64:
+    case Opcode::SelectF32:
+    case Opcode::SelectF64:
+    case Opcode::BitCastU16F16:
+    case Opcode::BitCastU32F32:
+    case Opcode::BitCastU64F64:
+    case Opcode::BitCastF16U16:
+    case Opcode::BitCastF32U32:
+    case Opcode::BitCastF64U64:
+    case Opcode::PackUint2x32:
+    case Opcode::UnpackUint2x32:
+    case Opcode::PackFloat2x32:
+    case Opcode::PackFloat2x16:
+    case Opcode::UnpackFloat2x16:
+    case Opcode::PackHalf2x16:
+    case Opcode::UnpackHalf2x16:
+    // Floating point arithmetic and comparisons.
+    case Opcode::FPAbs32:
+    case Opcode::FPAbs64:
+    case Opcode::FPAdd32:
+    case Opcode::FPAdd64:
+    case Opcode::FPSub32:
+    case Opcode::FPFma32:
+    case Opcode::FPFma64:
+    case Opcode::FPMax32:
+    case Opcode::FPMax64:
+    case Opcode::FPMin32:
+    case Opcode::FPMin64:
+    case Opcode::FPMul32:
+    case Opcode::FPMul64:
+    case Opcode::FPDiv32:
+    case Opcode::FPDiv64:
+    case Opcode::FPNeg32:
+    case Opcode::FPNeg64:
+    case Opcode::FPRecip32:
+    case Opcode::FPRecip64:
+    case Opcode::FPRecipSqrt32:
+    case Opcode::FPRecipSqrt64:
+    case Opcode::FPSqrt:
+    case Opcode::FPSin:
+    case Opcode::FPExp2:
+    case Opcode::FPLdexp:
+    case Opcode::FPCos:
+    case Opcode::FPLog2:
+    case Opcode::FPSaturate32:
+    case Opcode::FPSaturate64:
+    case Opcode::FPClamp32:
+    case Opcode::FPClamp64:
+    case Opcode::FPRoundEven32:
+    case Opcode::FPRoundEven64:
+    case Opcode::FPFloor32:
+    case Opcode::FPFloor64:
+    case Opcode::FPCeil32:
+    case Opcode::FPCeil64:
+    case Opcode::FPTrunc32:
+    case Opcode::FPTrunc64:
+    case Opcode::FPFract32:
+    case Opcode::FPFract64:
+    case Opcode::FPFrexpSig32:
+    case Opcode::FPFrexpSig64:
+    case Opcode::FPFrexpExp32:
+    case Opcode::FPFrexpExp64:
+    case Opcode::FPOrdEqual32:
+    case Opcode::FPOrdEqual64:
+    case Opcode::FPUnordEqual32:
+    case Opcode::FPUnordEqual64:
+    case Opcode::FPOrdNotEqual32:
+    case Opcode::FPOrdNotEqual64:
+    case Opcode::FPUnordNotEqual32:
+    case Opcode::FPUnordNotEqual64:
+    case Opcode::FPOrdLessThan32:
+    case Opcode::FPOrdLessThan64:
+    case Opcode::FPUnordLessThan32:
+    case Opcode::FPUnordLessThan64:
+    case Opcode::FPOrdGreaterThan32:
+    case Opcode::FPOrdGreaterThan64:
+    case Opcode::FPUnordGreaterThan32:
+    case Opcode::FPUnordGreaterThan64:
+    case Opcode::FPOrdLessThanEqual32:
+    case Opcode::FPOrdLessThanEqual64:
+    case Opcode::FPUnordLessThanEqual32:
+    case Opcode::FPUnordLessThanEqual64:
+    case Opcode::FPOrdGreaterThanEqual32:
+    case Opcode::FPOrdGreaterThanEqual64:
+    case Opcode::FPUnordGreaterThanEqual32:
+    case Opcode::FPUnordGreaterThanEqual64:
+    case Opcode::FPIsNan32:
+    case Opcode::FPIsNan64:
+    case Opcode::FPIsInf32:
+    case Opcode::FPIsInf64:
+    case Opcode::FPCmpClass32:
+    // Integer, bitwise and logical operations and comparisons.
+    case Opcode::IAdd32:
+    case Opcode::IAdd64:
+    case Opcode::IAddCary32:
+    case Opcode::ISub32:
+    case Opcode::ISub64:
+    case Opcode::IMul32:
+    case Opcode::IMul64:
+    case Opcode::SMulExt:
+    case Opcode::UMulExt:
+    case Opcode::SDiv32:
+    case Opcode::UDiv32:
+    case Opcode::SMod32:
+    case Opcode::UMod32:
+    case Opcode::INeg32:
+    case Opcode::INeg64:
+    case Opcode::IAbs32:
+    case Opcode::ShiftLeftLogical32:
+    case Opcode::ShiftLeftLogical64:
+    case Opcode::ShiftRightLogical32:
+    case Opcode::ShiftRightLogical64:
+    case Opcode::ShiftRightArithmetic32:
+    case Opcode::ShiftRightArithmetic64:
+    case Opcode::BitwiseAnd32:
+    case Opcode::BitwiseAnd64:
+    case Opcode::BitwiseOr32:
+    case Opcode::BitwiseOr64:
+    case Opcode::BitwiseXor32:
+    case Opcode::BitFieldInsert:
+    case Opcode::BitFieldSExtract:
+    case Opcode::BitFieldUExtract:
+    case Opcode::BitReverse32:
+    case Opcode::BitCount32:
+    case Opcode::BitCount64:
+    case Opcode::BitwiseNot32:
+    case Opcode::FindSMsb32:
+    case Opcode::FindUMsb32:
+    case Opcode::FindILsb32:
+    case Opcode::FindILsb64:
+    case Opcode::SMin32:
+    case Opcode::UMin32:
+    case Opcode::SMax32:
+    case Opcode::UMax32:
+    case Opcode::SClamp32:
+    case Opcode::UClamp32:
+    case Opcode::SLessThan32:
+    case Opcode::SLessThan64:
+    case Opcode::ULessThan32:
+    case Opcode::ULessThan64:
+    case Opcode::IEqual32:
+    case Opcode::IEqual64:
+    case Opcode::SLessThanEqual:
+    case Opcode::ULessThanEqual:
+    case Opcode::SGreaterThan:
+    case Opcode::UGreaterThan:
+    case Opcode::INotEqual:
+    case Opcode::SGreaterThanEqual:
+    case Opcode::UGreaterThanEqual:
+    case Opcode::LogicalOr:
+    case Opcode::LogicalAnd:
+    case Opcode::LogicalXor:
+    case Opcode::LogicalNot:
+    // Conversions.
+    case Opcode::ConvertS32F32:
+    case Opcode::ConvertS32F64:
+    case Opcode::ConvertU32F32:
+    case Opcode::ConvertF16F32:
+    case Opcode::ConvertF32F16:
+    case Opcode::ConvertF32F64:
+    case Opcode::ConvertF64F32:
+    case Opcode::ConvertF32S32:
+    case Opcode::ConvertF32U32:
+    case Opcode::ConvertF64S32:
+    case Opcode::ConvertF64U32:
+    case Opcode::ConvertF32U16:
+    case Opcode::ConvertU16U32:
+    case Opcode::ConvertU32U16:
+        return true;
+    default:
+        return false;
+    }
+}
+
 bool Inst::AreAllArgsImmediates() const {
     if (op == Opcode::Phi) {
         UNREACHABLE_MSG("Testing for all arguments are immediates on phi instruction");
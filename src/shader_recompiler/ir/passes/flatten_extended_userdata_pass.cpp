@@ -2,6 +2,7 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <mutex>
 #include <unordered_map>
 #include <boost/container/flat_map.hpp>
 #include <xbyak/xbyak.h>
@@ -24,6 +25,7 @@
 using namespace Xbyak::util;
 
 static Xbyak::CodeGenerator g_srt_codegen(32_MB);
+static std::mutex g_srt_codegen_mutex;
 
 namespace {
 
@@ -105,9 +107,34 @@ static inline void PopPtr(Xbyak::CodeGenerator& c) {
     c.pop(rdi);
 };
 
+static PFN_SrtWalker EmitSrtWalker(std::span<const SrtWalkerOp> ops, size_t& code_size) {
+    // Shaders may be compiled from several threads, all sharing the same code buffer.
+    std::scoped_lock lk{g_srt_codegen_mutex};
+    Xbyak::CodeGenerator& c = g_srt_codegen;
+    const u8* code = c.getCurr();
+    for (const auto& op : ops) {
+        switch (op.type) {
+        case SrtWalkerOp::Type::PushPtr:
+            PushPtr(c, op.src_off_dw);
+            break;
+        case SrtWalkerOp::Type::Copy:
+            c.mov(r10d, ptr[rdi + (op.src_off_dw << 2)]);
+            c.mov(ptr[rsi + (op.dst_off_dw << 2)], r10d);
+            break;
+        case SrtWalkerOp::Type::PopPtr:
+            PopPtr(c);
+            break;
+        }
+    }
+    c.ret();
+    c.ready();
+    code_size = c.getCurr() - code;
+    return reinterpret_cast<PFN_SrtWalker>(code);
+}
+
 static void VisitPointer(u32 off_dw, IR::Inst* subtree, PassInfo& pass_info,
-                         Xbyak::CodeGenerator& c) {
-    PushPtr(c, off_dw);
+                         SrtWalkerProgram& ops) {
+    ops.emplace_back(SrtWalkerOp::Type::PushPtr, off_dw, 0U);
     PassInfo::PtrUserList* use_list = pass_info.GetUsesAsPointer(subtree);
     ASSERT(use_list);
 
@@ -117,8 +144,7 @@ static void VisitPointer(u32 off_dw, IR::Inst* subtree, PassInfo& pass_info,
     // TODO src and dst are contiguous. Optimize with wider loads/stores
     // TODO if this subtree is dynamically indexed, don't compact it (keep it sparse)
     for (auto [src_off_dw, use] : *use_list) {
-        c.mov(r10d, ptr[rdi + (src_off_dw << 2)]);
-        c.mov(ptr[rsi + (pass_info.dst_off_dw << 2)], r10d);
+        ops.emplace_back(SrtWalkerOp::Type::Copy, src_off_dw, pass_info.dst_off_dw);
 
         use->SetFlags<u32>(pass_info.dst_off_dw);
         pass_info.dst_off_dw++;
@@ -127,21 +153,20 @@ static void VisitPointer(u32 off_dw, IR::Inst* subtree, PassInfo& pass_info,
     // Then visit any children used as pointers
     for (const auto [src_off_dw, use] : *use_list) {
         if (pass_info.GetUsesAsPointer(use)) {
-            VisitPointer(src_off_dw, use, pass_info, c);
+            VisitPointer(src_off_dw, use, pass_info, ops);
         }
     }
 
-    PopPtr(c);
+    ops.emplace_back(SrtWalkerOp::Type::PopPtr, 0U, 0U);
 }
 
 static void GenerateSrtProgram(Info& info, PassInfo& pass_info) {
-    Xbyak::CodeGenerator& c = g_srt_codegen;
-
     if (info.srt_info.srt_reservations.empty() && pass_info.srt_roots.empty()) {
         return;
     }
 
-    info.srt_info.walker_func = c.getCurr<PFN_SrtWalker>();
+    auto& ops = info.srt_info.walker_program;
+    ops.clear();
 
     pass_info.dst_off_dw = NumUserDataRegs;
 
@@ -149,34 +174,29 @@ static void GenerateSrtProgram(Info& info, PassInfo& pass_info) {
     for (const auto [sgpr_base, dword_offset, num_dwords] : info.srt_info.srt_reservations) {
         // get pointer to V#
         if (sgpr_base != IR::NumScalarRegs) {
-            PushPtr(c, sgpr_base);
+            ops.emplace_back(SrtWalkerOp::Type::PushPtr, sgpr_base, 0U);
         }
-        u32 src_off = dword_offset << 2;
-
         for (auto j = 0; j < num_dwords; j++) {
-            c.mov(r11d, ptr[rdi + src_off]);
-            c.mov(ptr[rsi + (pass_info.dst_off_dw << 2)], r11d);
-
-            src_off += 4;
+            ops.emplace_back(SrtWalkerOp::Type::Copy, dword_offset + j, pass_info.dst_off_dw);
             ++pass_info.dst_off_dw;
         }
         if (sgpr_base != IR::NumScalarRegs) {
-            PopPtr(c);
+            ops.emplace_back(SrtWalkerOp::Type::PopPtr, 0U, 0U);
         }
     }
 
     ASSERT(pass_info.dst_off_dw == info.srt_info.flattened_bufsize_dw);
 
     for (const auto& [sgpr_base, root] : pass_info.srt_roots) {
-        VisitPointer(static_cast<u32>(sgpr_base), root, pass_info, c);
+        VisitPointer(static_cast<u32>(sgpr_base), root, pass_info, ops);
     }
 
-    c.ret();
-    c.ready();
+    size_t code_size{};
+    info.srt_info.walker_func = EmitSrtWalker({ops.data(), ops.size()}, code_size);
 
     if (Config::dumpShaders()) {
-        size_t codesize = c.getCurr() - reinterpret_cast<const u8*>(info.srt_info.walker_func);
-        DumpSrtProgram(info, reinterpret_cast<const u8*>(info.srt_info.walker_func), codesize);
+        const auto* code = reinterpret_cast<const u8*>(info.srt_info.walker_func);
+        DumpSrtProgram(info, code, code_size);
     }
 
     info.srt_info.flattened_bufsize_dw = pass_info.dst_off_dw;
@@ -250,4 +270,13 @@ void FlattenExtendedUserdataPass(IR::Program& program) {
     info.RefreshFlatBuf();
 }
 
-} // namespace Shader::Optimization
\ No newline at end of file
+} // namespace Shader::Optimization
+
+namespace Shader {
+
+PFN_SrtWalker CompileSrtWalker(std::span<const SrtWalkerOp> ops) {
+    size_t code_size{};
+    return Optimization::EmitSrtWalker(ops, code_size);
+}
+
+} // namespace Shader
@@ -0,0 +1,118 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <memory_resource>
+#include <unordered_map>
+#include <boost/container/small_vector.hpp>
+#include "common/hash.h"
+#include "shader_recompiler/ir/dominator_tree.h"
+#include "shader_recompiler/ir/program.h"
+
+namespace Shader::Optimization {
+
+namespace {
+
+struct Expression {
+    IR::Opcode opcode;
+    u32 flags;
+    std::array<IR::Value, 6> args;
+
+    bool operator==(const Expression&) const = default;
+};
+
+struct ExpressionHash {
+    size_t operator()(const Expression& expr) const {
+        size_t hash = HashCombine(static_cast<u64>(expr.opcode), static_cast<u64>(expr.flags));
+        for (const IR::Value& arg : expr.args) {
+            hash = HashCombine(hash, std::hash<IR::Value>{}(arg));
+        }
+        return hash;
+    }
+};
+
+bool IsCommutative(IR::Opcode opcode) {
+    switch (opcode) {
+    case IR::Opcode::IAdd32:
+    case IR::Opcode::IAdd64:
+    case IR::Opcode::IMul32:
+    case IR::Opcode::IMul64:
+    case IR::Opcode::BitwiseAnd32:
+    case IR::Opcode::BitwiseAnd64:
+    case IR::Opcode::BitwiseOr32:
+    case IR::Opcode::BitwiseOr64:
+    case IR::Opcode::BitwiseXor32:
+    case IR::Opcode::LogicalAnd:
+    case IR::Opcode::LogicalOr:
+    case IR::Opcode::LogicalXor:
+    case IR::Opcode::IEqual32:
+    case IR::Opcode::IEqual64:
+    case IR::Opcode::INotEqual:
+    case IR::Opcode::SMin32:
+    case IR::Opcode::UMin32:
+    case IR::Opcode::SMax32:
+    case IR::Opcode::UMax32:
+    case IR::Opcode::FPAdd32:
+    case IR::Opcode::FPAdd64:
+    case IR::Opcode::FPMul32:
+    case IR::Opcode::FPMul64:
+        return true;
+    default:
+        return false;
+    }
+}
+
+Expression MakeExpression(const IR::Inst& inst) {
+    Expression expr{
+        .opcode = inst.GetOpcode(),
+        .flags = inst.Flags<u32>(),
+        .args = {},
+    };
+    const size_t num_args = inst.NumArgs();
+    for (size_t i = 0; i < num_args; ++i) {
+        expr.args[i] = inst.Arg(i).Resolve();
+    }
+    if (IsCommutative(expr.opcode)) {
+        // Any fixed order works, it only has to be the same for both operand orders.
+        const std::hash<IR::Value> hash;
+        if (hash(expr.args[0]) > hash(expr.args[1])) {
+            std::swap(expr.args[0], expr.args[1]);
+        }
+    }
+    return expr;
+}
+
+} // Anonymous namespace
+
+void GlobalValueNumberingPass(IR::Program& program, std::pmr::memory_resource* resource) {
+    const IR::DominatorTree dom_tree{program.post_order_blocks};
+    std::pmr::unordered_map<Expression, boost::container::small_vector<IR::Inst*, 2>,
+                            ExpressionHash>
+        leaders{resource};
+
+    // Visiting blocks in reverse post order sees every dominator before the blocks it
+    // dominates, and replacing uses as we go makes operands refer to their leaders already.
+    for (IR::Block* const block : dom_tree.ReversePostOrder()) {
+        for (auto it = block->begin(); it != block->end();) {
+            IR::Inst& inst = *it;
+            if (!inst.IsPure()) {
+                ++it;
+                continue;
+            }
+            auto& candidates = leaders[MakeExpression(inst)];
+            const auto leader = std::ranges::find_if(candidates, [&](IR::Inst* candidate) {
+                return dom_tree.Dominates(candidate->GetParent(), block);
+            });
+            if (leader == candidates.end()) {
+                candidates.push_back(&inst);
+                ++it;
+                continue;
+            }
+            inst.ReplaceUsesWithAndRemove(IR::Value{*leader});
+            it = block->Instructions().erase(it);
+        }
+    }
+}
+
+} // namespace Shader::Optimization
@@ -1,13 +1,14 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <memory_resource>
 #include <vector>
 #include "shader_recompiler/ir/program.h"
 
 namespace Shader::Optimization {
 
-void IdentityRemovalPass(IR::BlockList& program) {
-    std::vector<IR::Inst*> to_invalidate;
+void IdentityRemovalPass(IR::BlockList& program, std::pmr::memory_resource* resource) {
+    std::pmr::vector<IR::Inst*> to_invalidate{resource};
     for (IR::Block* const block : program) {
         for (auto inst = block->begin(); inst != block->end();) {
             const size_t num_args{inst->NumArgs()};
@@ -12,9 +12,15 @@ struct Profile;
 
 namespace Shader::Optimization {
 
-void SsaRewritePass(IR::BlockList& program);
-void IdentityRemovalPass(IR::BlockList& program);
+void SsaRewritePass(IR::BlockList& program,
+                    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+void IdentityRemovalPass(IR::BlockList& program,
+                         std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 void DeadCodeEliminationPass(IR::Program& program);
+void GlobalValueNumberingPass(
+    IR::Program& program, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+void LoopInvariantCodeMotionPass(
+    IR::Program& program, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 void ConstantPropagationPass(IR::BlockList& program);
 void FlattenExtendedUserdataPass(IR::Program& program);
 void ResourceTrackingPass(IR::Program& program);
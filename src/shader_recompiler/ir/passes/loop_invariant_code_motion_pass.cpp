@@ -0,0 +1,257 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <memory_resource>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "shader_recompiler/ir/ir_emitter.h"
+#include "shader_recompiler/ir/program.h"
+
+namespace Shader::Optimization {
+
+namespace {
+
+struct Loop {
+    explicit Loop(std::pmr::memory_resource* resource)
+        : body{resource}, blocks{resource}, guaranteed{resource} {}
+
+    IR::Block* preheader{};
+    IR::Block* header{};
+    IR::Block* continue_block{};
+    /// Blocks of the loop in syntax order, definitions come before their non-phi uses.
+    std::pmr::vector<IR::Block*> body;
+    std::pmr::unordered_set<const IR::Block*> blocks;
+    /// Blocks executed at least once every time the loop is entered.
+    std::pmr::unordered_set<const IR::Block*> guaranteed;
+};
+
+/// Returns the single block outside the loop that branches to the header, or null if the loop
+/// is entered from a block that has other successors.
+IR::Block* FindPreheader(IR::Block* header, const IR::Block* continue_block) {
+    IR::Block* preheader{};
+    for (IR::Block* const pred : header->ImmPredecessors()) {
+        if (pred == continue_block) {
+            continue;
+        }
+        if (preheader || pred->ImmSuccessors().size() != 1) {
+            return nullptr;
+        }
+        preheader = pred;
+    }
+    return preheader;
+}
+
+/// Collects the blocks of the loop whose Loop node is at loop_index and Repeat node is at
+/// repeat_index. The loop header is always the block node right before the Loop node.
+bool BuildLoop(const IR::AbstractSyntaxList& syntax_list, size_t loop_index, size_t repeat_index,
+               Loop& loop) {
+    const IR::AbstractSyntaxNode& loop_node{syntax_list[loop_index]};
+    const IR::AbstractSyntaxNode& repeat_node{syntax_list[repeat_index]};
+    loop.header = repeat_node.data.repeat.loop_header;
+    loop.continue_block = loop_node.data.loop.continue_block;
+    loop.preheader = FindPreheader(loop.header, loop.continue_block);
+    if (!loop.preheader) {
+        return false;
+    }
+    loop.body.push_back(loop.header);
+    loop.blocks.insert(loop.header);
+    loop.guaranteed.insert(loop.header);
+
+    // Loops are do-while, so nested loop bodies run at least once. Code under an if or after a
+    // break out of this loop may never run.
+    u32 if_depth{};
+    u32 loop_depth{};
+    bool after_break{};
+    for (size_t index = loop_index + 1; index < repeat_index; ++index) {
+        const IR::AbstractSyntaxNode& node{syntax_list[index]};
+        switch (node.type) {
+        case IR::AbstractSyntaxNode::Type::Block:
+            loop.body.push_back(node.data.block);
+            loop.blocks.insert(node.data.block);
+            if (if_depth == 0 && !after_break) {
+                loop.guaranteed.insert(node.data.block);
+            }
+            break;
+        case IR::AbstractSyntaxNode::Type::If:
+            ++if_depth;
+            break;
+        case IR::AbstractSyntaxNode::Type::EndIf:
+            --if_depth;
+            break;
+        case IR::AbstractSyntaxNode::Type::Loop:
+            ++loop_depth;
+            break;
+        case IR::AbstractSyntaxNode::Type::Repeat:
+            --loop_depth;
+            break;
+        case IR::AbstractSyntaxNode::Type::Break:
+            after_break |= loop_depth == 0;
+            break;
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+bool IsInvariant(const Loop& loop, const IR::Value& value) {
+    return value.IsImmediate() || !loop.blocks.contains(value.InstRecursive()->GetParent());
+}
+
+/// Returns true if the instruction reads memory. Other pure instructions only depend on their
+/// arguments.
+bool ReadsMemory(const IR::Inst& inst) {
+    return inst.GetOpcode() == IR::Opcode::ReadConst;
+}
+
+/// Returns true if the instruction may write memory. Side effects are assumed to be memory
+/// writes unless known to only affect control flow or shader outputs.
+bool MayWriteMemory(const IR::Inst& inst) {
+    switch (inst.GetOpcode()) {
+    case IR::Opcode::ConditionRef:
+    case IR::Opcode::Reference:
+    case IR::Opcode::PhiMove:
+    case IR::Opcode::Prologue:
+    case IR::Opcode::Epilogue:
+    case IR::Opcode::Discard:
+    case IR::Opcode::DiscardCond:
+    case IR::Opcode::SetAttribute:
+    case IR::Opcode::SetTcsGenericAttribute:
+    case IR::Opcode::SetPatch:
+    case IR::Opcode::EmitVertex:
+    case IR::Opcode::EmitPrimitive:
+    case IR::Opcode::DebugPrint:
+        return false;
+    default:
+        return inst.MayHaveSideEffects();
+    }
+}
+
+void HoistInvariants(const Loop& loop) {
+    // Memory read in the loop may be written by it, in which case the read is not invariant.
+    bool loop_writes_memory{};
+    for (const IR::Block* const block : loop.body) {
+        loop_writes_memory |= std::ranges::any_of(*block, MayWriteMemory);
+    }
+    const auto insert_point{loop.preheader->end()};
+    for (IR::Block* const block : loop.body) {
+        const bool is_guaranteed{loop.guaranteed.contains(block)};
+        for (auto it = block->begin(); it != block->end();) {
+            IR::Inst& inst{*it};
+            // Memory reads may also fault on addresses the shader guards, so they are only
+            // hoisted from blocks that run on every iteration.
+            const bool reads_memory{ReadsMemory(inst)};
+            bool hoist{inst.IsPure() && (!reads_memory || (is_guaranteed && !loop_writes_memory))};
+            for (size_t arg = 0; hoist && arg < inst.NumArgs(); ++arg) {
+                hoist = IsInvariant(loop, inst.Arg(arg));
+            }
+            if (!hoist) {
+                ++it;
+                continue;
+            }
+            it = block->Instructions().erase(it);
+            loop.preheader->Instructions().insert(insert_point, inst);
+            inst.SetParent(loop.preheader);
+        }
+    }
+}
+
+/// Replaces multiplications of a basic induction variable i = phi(init, i + step) by a loop
+/// invariant with a new induction variable j = phi(init * c, j + step * c).
+void ReduceInductionMultiplies(const Loop& loop, std::pmr::memory_resource* resource) {
+    std::pmr::vector<IR::Inst*> phis{resource};
+    for (IR::Inst& inst : *loop.header) {
+        if (inst.GetOpcode() == IR::Opcode::Phi && inst.Flags<IR::Type>() == IR::Type::U32 &&
+            inst.NumArgs() == 2) {
+            phis.push_back(&inst);
+        }
+    }
+    for (IR::Inst* const phi : phis) {
+        const size_t backedge{phi->PhiBlock(0) == loop.continue_block ? 0U : 1U};
+        if (phi->PhiBlock(backedge) != loop.continue_block ||
+            phi->PhiBlock(1 - backedge) != loop.preheader) {
+            continue;
+        }
+        const IR::Value init{phi->Arg(1 - backedge)};
+        const IR::Value next_value{phi->Arg(backedge)};
+        if (next_value.IsImmediate()) {
+            continue;
+        }
+        IR::Inst* const next{next_value.InstRecursive()};
+        if (next->GetOpcode() != IR::Opcode::IAdd32 || !loop.blocks.contains(next->GetParent())) {
+            continue;
+        }
+        const bool phi_is_lhs{next->Arg(0).Resolve() == IR::Value{phi}};
+        if (!phi_is_lhs && next->Arg(1).Resolve() != IR::Value{phi}) {
+            continue;
+        }
+        const IR::Value step{next->Arg(phi_is_lhs ? 1 : 0).Resolve()};
+        if (!IsInvariant(loop, step)) {
+            continue;
+        }
+
+        std::pmr::unordered_map<IR::Value, IR::Inst*> reduced{resource};
+        for (const IR::Use& use : phi->Uses()) {
+            IR::Inst* const mul{use.user};
+            if (mul->GetOpcode() != IR::Opcode::IMul32 || !loop.blocks.contains(mul->GetParent())) {
+                continue;
+            }
+            const IR::Value factor{mul->Arg(1 - use.operand).Resolve()};
+            if (!IsInvariant(loop, factor)) {
+                continue;
+            }
+            auto [it, is_new] = reduced.try_emplace(factor);
+            if (is_new) {
+                IR::IREmitter pre_ir{*loop.preheader};
+                const IR::U32 init_mul{pre_ir.IMul(IR::U32{init}, IR::U32{factor})};
+                const IR::U32 step_mul{pre_ir.IMul(IR::U32{step}, IR::U32{factor})};
+                IR::Inst* const new_phi{
+                    &*loop.header->PrependNewInst(loop.header->begin(), IR::Opcode::Phi)};
+                new_phi->SetFlags(IR::Type::U32);
+                IR::Block* const next_block{next->GetParent()};
+                IR::IREmitter next_ir{*next_block,
+                                      std::next(next_block->Instructions().iterator_to(*next))};
+                const IR::U32 new_next{next_ir.IAdd(IR::U32{new_phi}, step_mul)};
+                new_phi->AddPhiOperand(loop.preheader, init_mul);
+                new_phi->AddPhiOperand(loop.continue_block, new_next);
+                it->second = new_phi;
+            }
+            IR::Block* const mul_block{mul->GetParent()};
+            mul->ReplaceUsesWithAndRemove(IR::Value{it->second});
+            mul_block->Instructions().erase(mul_block->Instructions().iterator_to(*mul));
+        }
+    }
+}
+
+} // Anonymous namespace
+
+void LoopInvariantCodeMotionPass(IR::Program& program, std::pmr::memory_resource* resource) {
+    // Repeat nodes close inner loops first, so code hoisted into a preheader that is itself
+    // part of an outer loop gets another chance to move further out.
+    std::pmr::vector<size_t> open_loops{resource};
+    const IR::AbstractSyntaxList& syntax_list{program.syntax_list};
+    for (size_t index = 0; index < syntax_list.size(); ++index) {
+        switch (syntax_list[index].type) {
+        case IR::AbstractSyntaxNode::Type::Loop:
+            open_loops.push_back(index);
+            break;
+        case IR::AbstractSyntaxNode::Type::Repeat: {
+            const size_t loop_index{open_loops.back()};
+            open_loops.pop_back();
+            Loop loop{resource};
+            if (!BuildLoop(syntax_list, loop_index, index, loop)) {
+                break;
+            }
+            HoistInvariants(loop);
+            ReduceInductionMultiplies(loop, resource);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+} // namespace Shader::Optimization
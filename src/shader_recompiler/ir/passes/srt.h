@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <span>
 #include <boost/container/set.hpp>
 #include <boost/container/small_vector.hpp>
 #include "common/types.h"
@@ -11,6 +12,23 @@ namespace Shader {
 
 using PFN_SrtWalker = void PS4_SYSV_ABI (*)(const u32* /*user_data*/, u32* /*flat_dst*/);
 
+// Host independent description of the SRT walker program. It is kept alongside the JIT
+// function so the walker can be regenerated when shader info is loaded from the disk cache.
+struct SrtWalkerOp {
+    enum class Type : u32 {
+        PushPtr, ///< Dereference pointer at src_off_dw of the current table
+        Copy,    ///< Copy dword at src_off_dw of the current table to dst_off_dw of flat buffer
+        PopPtr,  ///< Return to the parent table
+    };
+
+    Type type;
+    u32 src_off_dw;
+    u32 dst_off_dw;
+};
+using SrtWalkerProgram = boost::container::small_vector<SrtWalkerOp, 32>;
+
+[[nodiscard]] PFN_SrtWalker CompileSrtWalker(std::span<const SrtWalkerOp> ops);
+
 struct PersistentSrtInfo {
     // Special case when fetch shader uses step rates.
     struct SrtSharpReservation {
@@ -20,6 +38,7 @@ struct PersistentSrtInfo {
     };
 
     PFN_SrtWalker walker_func{};
+    SrtWalkerProgram walker_program;
     boost::container::small_vector<SrtSharpReservation, 2> srt_reservations;
     u32 flattened_bufsize_dw = 16; // NumUserDataRegs
 
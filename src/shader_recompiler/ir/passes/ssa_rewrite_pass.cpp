@@ -14,6 +14,7 @@
 //
 
 #include <map>
+#include <memory_resource>
 #include <span>
 #include <unordered_map>
 #include <variant>
@@ -55,9 +56,14 @@ struct ThreadBitScalar : FlagTag {
 
 using Variant = std::variant<IR::ScalarReg, IR::VectorReg, GotoVariable, ThreadBitScalar,
                              SccFlagTag, ExecFlagTag, VccFlagTag, VccLoTag, VccHiTag, M0Tag>;
-using ValueMap = std::unordered_map<IR::Block*, IR::Value>;
+using ValueMap = std::pmr::unordered_map<IR::Block*, IR::Value>;
 
 struct DefTable {
+    explicit DefTable(std::pmr::memory_resource* resource)
+        : goto_vars{resource}, scc_flag{resource}, exec_flag{resource}, vcc_flag{resource},
+          scc_lo_flag{resource}, vcc_lo_flag{resource}, vcc_hi_flag{resource},
+          m0_flag{resource} {}
+
     const IR::Value& Def(IR::Block* block, IR::ScalarReg variable) {
         return block->ssa_sreg_values[RegIndex(variable)];
     }
@@ -127,7 +133,7 @@ struct DefTable {
         m0_flag.insert_or_assign(block, value);
     }
 
-    std::unordered_map<u32, ValueMap> goto_vars;
+    std::pmr::unordered_map<u32, ValueMap> goto_vars;
     ValueMap scc_flag;
     ValueMap exec_flag;
     ValueMap vcc_flag;
@@ -182,6 +188,9 @@ struct ReadState {
 
 class Pass {
 public:
+    explicit Pass(std::pmr::memory_resource* resource)
+        : incomplete_phis{resource}, current_def{resource} {}
+
     template <typename Type>
     void WriteVariable(Type variable, IR::Block* block, const IR::Value& value) {
         current_def.SetDef(block, variable, value);
@@ -321,7 +330,7 @@ private:
         return same;
     }
 
-    std::unordered_map<IR::Block*, std::map<Variant, IR::Inst*>> incomplete_phis;
+    std::pmr::unordered_map<IR::Block*, std::pmr::map<Variant, IR::Inst*>> incomplete_phis;
     DefTable current_def;
 };
 
@@ -417,8 +426,8 @@ void VisitBlock(Pass& pass, IR::Block* block) {
 
 } // Anonymous namespace
 
-void SsaRewritePass(IR::BlockList& program) {
-    Pass pass;
+void SsaRewritePass(IR::BlockList& program, std::pmr::memory_resource* resource) {
+    Pass pass{resource};
     const auto end{program.rend()};
     for (auto block = program.rbegin(); block != end; ++block) {
         VisitBlock(pass, *block);
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <memory_resource>
 #include <string>
 #include "shader_recompiler/frontend/instruction.h"
 #include "shader_recompiler/info.h"
@@ -12,12 +13,14 @@
 namespace Shader::IR {
 
 struct Program {
-    explicit Program(Info& info_) : info{info_} {}
+    explicit Program(Info& info_,
+                     std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : ins_list{resource}, info{info_} {}
 
     AbstractSyntaxList syntax_list;
     BlockList blocks;
     BlockList post_order_blocks;
-    std::vector<Gcn::GcnInst> ins_list;
+    std::pmr::vector<Gcn::GcnInst> ins_list;
     Info& info;
 };
 
@@ -159,6 +159,10 @@ public:
     /// Determines whether or not this instruction may have side effects.
     [[nodiscard]] bool MayHaveSideEffects() const noexcept;
 
+    /// Determines whether this instruction always produces the same result for the same
+    /// arguments, so it can be deduplicated or moved to any block where they are available.
+    [[nodiscard]] bool IsPure() const noexcept;
+
     /// Determines if all arguments of this instruction are immediates.
     [[nodiscard]] bool AreAllArgsImmediates() const;
 
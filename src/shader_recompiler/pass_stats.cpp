@@ -0,0 +1,92 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <iterator>
+#include <fmt/format.h>
+#include "shader_recompiler/pass_stats.h"
+
+namespace Shader {
+
+namespace {
+
+double ToMs(std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+}
+
+double ToUs(std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::micro>(time).count();
+}
+
+} // Anonymous namespace
+
+void PassStatsCollector::Add(const PassStats& stats) {
+    std::scoped_lock lk{mutex};
+    ++num_shaders;
+    for (const auto& entry : stats.passes) {
+        auto it = std::ranges::find_if(
+            totals, [&](const auto& total) { return total.first == entry.name; });
+        if (it == totals.end()) {
+            it = totals.emplace(totals.end(), entry.name, PassTotal{});
+        }
+        auto& total = it->second;
+        total.time += entry.time;
+        total.max_time = std::max(total.max_time, entry.time);
+        ++total.runs;
+        total.insts_before += entry.insts_before;
+        total.insts_after += entry.insts_after;
+        total.blocks_before += entry.blocks_before;
+        total.blocks_after += entry.blocks_after;
+        total_time += entry.time;
+    }
+}
+
+u64 PassStatsCollector::NumShaders() const {
+    std::scoped_lock lk{mutex};
+    return num_shaders;
+}
+
+std::string PassStatsCollector::Summary() const {
+    std::scoped_lock lk{mutex};
+    fmt::memory_buffer buffer;
+    auto out = std::back_inserter(buffer);
+    fmt::format_to(out, "Shader compilation: {} shaders, {:.3f} ms total\n", num_shaders,
+                   ToMs(total_time));
+    fmt::format_to(out, "{:<28} {:>11} {:>7} {:>10} {:>10} {:>6} {:>12} {:>12}\n", "Pass",
+                   "Total (ms)", "Runs", "Avg (us)", "Max (us)", "Share", "Insts in/out",
+                   "Blocks in/out");
+    for (const auto& [name, total] : totals) {
+        const double runs = static_cast<double>(total.runs);
+        fmt::format_to(out,
+                       "{:<28} {:>11.3f} {:>7} {:>10.2f} {:>10.2f} {:>5.1f}% {:>5.0f}/{:<6.0f} "
+                       "{:>5.0f}/{:<6.0f}\n",
+                       name, ToMs(total.time), total.runs, ToUs(total.time) / runs,
+                       ToUs(total.max_time),
+                       total_time.count() ? 100.0 * total.time.count() / total_time.count() : 0.0,
+                       total.insts_before / runs, total.insts_after / runs,
+                       total.blocks_before / runs, total.blocks_after / runs);
+    }
+    return fmt::to_string(buffer);
+}
+
+std::string PassStatsCollector::ToJson() const {
+    std::scoped_lock lk{mutex};
+    fmt::memory_buffer buffer;
+    auto out = std::back_inserter(buffer);
+    fmt::format_to(out, "{{\n  \"shaders\": {},\n  \"total_ns\": {},\n  \"passes\": [", num_shaders,
+                   total_time.count());
+    for (size_t i = 0; i < totals.size(); ++i) {
+        const auto& [name, total] = totals[i];
+        fmt::format_to(out,
+                       "{}\n    {{\"name\": \"{}\", \"runs\": {}, \"total_ns\": {}, "
+                       "\"max_ns\": {}, \"insts_before\": {}, \"insts_after\": {}, "
+                       "\"blocks_before\": {}, \"blocks_after\": {}}}",
+                       i == 0 ? "" : ",", name, total.runs, total.time.count(),
+                       total.max_time.count(), total.insts_before, total.insts_after,
+                       total.blocks_before, total.blocks_after);
+    }
+    fmt::format_to(out, "\n  ]\n}}\n");
+    return fmt::to_string(buffer);
+}
+
+} // namespace Shader
@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <boost/container/small_vector.hpp>
+#include "common/types.h"
+
+namespace Shader {
+
+/// Wall time and IR size around every pass run by a single TranslateProgram invocation, in
+/// execution order. Passes that run several times are recorded once per invocation.
+struct PassStats {
+    struct Entry {
+        std::string_view name;
+        std::chrono::nanoseconds time;
+        u32 insts_before;
+        u32 insts_after;
+        u32 blocks_before;
+        u32 blocks_after;
+    };
+
+    boost::container::small_vector<Entry, 24> passes;
+
+    void Add(const Entry& entry) {
+        passes.push_back(entry);
+    }
+
+    /// Records a stage that consumes the final IR without modifying it, such as the backend.
+    void AddBackend(std::string_view name, std::chrono::nanoseconds time) {
+        const u32 num_insts = passes.empty() ? 0 : passes.back().insts_after;
+        const u32 num_blocks = passes.empty() ? 0 : passes.back().blocks_after;
+        passes.push_back({name, time, num_insts, num_insts, num_blocks, num_blocks});
+    }
+
+    [[nodiscard]] std::chrono::nanoseconds TotalTime() const noexcept {
+        std::chrono::nanoseconds total{};
+        for (const auto& entry : passes) {
+            total += entry.time;
+        }
+        return total;
+    }
+};
+
+/// Thread safe accumulation of PassStats over many compilations.
+class PassStatsCollector {
+public:
+    struct PassTotal {
+        std::chrono::nanoseconds time{};
+        std::chrono::nanoseconds max_time{};
+        u64 runs{};
+        u64 insts_before{};
+        u64 insts_after{};
+        u64 blocks_before{};
+        u64 blocks_after{};
+    };
+
+    void Add(const PassStats& stats);
+
+    [[nodiscard]] u64 NumShaders() const;
+
+    /// Human readable table of all passes, ordered by first execution.
+    [[nodiscard]] std::string Summary() const;
+
+    /// Same data as a JSON document.
+    [[nodiscard]] std::string ToJson() const;
+
+private:
+    mutable std::mutex mutex;
+    std::vector<std::pair<std::string_view, PassTotal>> totals;
+    std::chrono::nanoseconds total_time{};
+    u64 num_shaders{};
+};
+
+} // namespace Shader
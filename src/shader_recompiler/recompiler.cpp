@@ -1,6 +1,9 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <chrono>
+#include <optional>
+#include "common/assert.h"
 #include "common/config.h"
 #include "common/io_file.h"
 #include "common/path_util.h"
@@ -9,6 +12,7 @@
 #include "shader_recompiler/frontend/structured_control_flow.h"
 #include "shader_recompiler/ir/passes/ir_passes.h"
 #include "shader_recompiler/ir/post_order.h"
+#include "shader_recompiler/pass_stats.h"
 #include "shader_recompiler/recompiler.h"
 
 namespace Shader {
@@ -31,8 +35,38 @@ IR::BlockList GenerateBlocks(const IR::AbstractSyntaxList& syntax_list) {
     return blocks;
 }
 
+static u32 CountInsts(const IR::Program& program) {
+    u32 num_insts{};
+    for (const IR::Block* block : program.blocks) {
+        num_insts += static_cast<u32>(block->size());
+    }
+    return num_insts;
+}
+
+template <typename Pass, typename... Args>
+static void RunPass(PassStats* stats, const IR::Program& program, std::string_view name,
+                    Pass&& pass, Args&&... args) {
+    if (!stats) {
+        pass(std::forward<Args>(args)...);
+        return;
+    }
+    const u32 insts_before = CountInsts(program);
+    const u32 blocks_before = static_cast<u32>(program.blocks.size());
+    const auto start = std::chrono::steady_clock::now();
+    pass(std::forward<Args>(args)...);
+    const auto time = std::chrono::steady_clock::now() - start;
+    stats->Add({
+        .name = name,
+        .time = time,
+        .insts_before = insts_before,
+        .insts_after = CountInsts(program),
+        .blocks_before = blocks_before,
+        .blocks_after = static_cast<u32>(program.blocks.size()),
+    });
+}
+
 IR::Program TranslateProgram(std::span<const u32> code, Pools& pools, Info& info,
-                             RuntimeInfo& runtime_info, const Profile& profile) {
+                             RuntimeInfo& runtime_info, const Profile& profile, PassStats* stats) {
     // Ensure first instruction is expected.
     constexpr u32 token_mov_vcchi = 0xBEEB03FF;
     if (code[0] != token_mov_vcchi) {
@@ -42,56 +76,85 @@ IR::Program TranslateProgram(std::span<const u32> code, Pools& pools, Info& info
     Gcn::GcnCodeSlice slice(code.data(), code.data() + code.size());
     Gcn::GcnDecodeContext decoder;
 
-    // Decode and save instructions
-    IR::Program program{info};
-    program.ins_list.reserve(code.size());
-    while (!slice.atEnd()) {
-        program.ins_list.emplace_back(decoder.decodeInstruction(slice));
-    }
-
-    // Clear any previous pooled data.
+    // Clear any previous pooled data. The returned program references pooled memory, so the
+    // previous one must not be used past this point.
     pools.ReleaseContents();
 
+    // Decode and save instructions
+    IR::Program program{info, &pools.arena};
+    RunPass(stats, program, "Decode", [&] {
+        program.ins_list.reserve(code.size());
+        while (!slice.atEnd()) {
+            [[maybe_unused]] const auto remaining = slice.remaining();
+            program.ins_list.emplace_back(decoder.decodeInstruction(slice));
+            DEBUG_ASSERT_MSG(remaining.size() - slice.remaining().size() ==
+                                 Gcn::GetInstructionLength(remaining) / sizeof(u32),
+                             "Decoder and length table disagree on instruction {:#x}",
+                             remaining[0]);
+        }
+    });
+
     // Create control flow graph
-    Common::ObjectPool<Gcn::Block> gcn_block_pool{64};
-    Gcn::CFG cfg{gcn_block_pool, program.ins_list};
+    std::optional<Gcn::CFG> cfg;
+    RunPass(stats, program, "ControlFlow", [&] {
+        cfg.emplace(pools.gcn_block_pool, program.ins_list, &pools.arena);
 
-    // Structurize control flow graph and create program.
-    program.syntax_list = Shader::Gcn::BuildASL(pools.inst_pool, pools.block_pool, cfg,
-                                                program.info, runtime_info, profile);
-    program.blocks = GenerateBlocks(program.syntax_list);
-    program.post_order_blocks = Shader::IR::PostOrder(program.syntax_list.front());
+        // Structurize control flow graph and create program.
+        program.syntax_list = Shader::Gcn::BuildASL(pools.inst_pool, pools.block_pool, *cfg,
+                                                    program.info, runtime_info, profile,
+                                                    &pools.arena);
+        program.blocks = GenerateBlocks(program.syntax_list);
+        program.post_order_blocks = Shader::IR::PostOrder(program.syntax_list.front());
+    });
 
     // Run optimization passes
     const auto stage = program.info.stage;
+    using namespace Shader::Optimization;
 
-    Shader::Optimization::SsaRewritePass(program.post_order_blocks);
-    Shader::Optimization::IdentityRemovalPass(program.blocks);
+    RunPass(stats, program, "SsaRewrite", SsaRewritePass, program.post_order_blocks,
+            &pools.arena);
+    RunPass(stats, program, "IdentityRemoval", IdentityRemovalPass, program.blocks,
+            &pools.arena);
     if (info.l_stage == LogicalStage::TessellationControl) {
         // Tess passes require previous const prop passes for now (for simplicity). TODO allow
         // fine grained folding or opportunistic folding we set an operand to an immediate
-        Shader::Optimization::ConstantPropagationPass(program.post_order_blocks);
-        Shader::Optimization::TessellationPreprocess(program, runtime_info);
-        Shader::Optimization::ConstantPropagationPass(program.post_order_blocks);
-        Shader::Optimization::HullShaderTransform(program, runtime_info);
+        RunPass(stats, program, "ConstantPropagation", ConstantPropagationPass,
+                program.post_order_blocks);
+        RunPass(stats, program, "TessellationPreprocess", TessellationPreprocess, program,
+                runtime_info);
+        RunPass(stats, program, "ConstantPropagation", ConstantPropagationPass,
+                program.post_order_blocks);
+        RunPass(stats, program, "HullShaderTransform", HullShaderTransform, program, runtime_info);
     } else if (info.l_stage == LogicalStage::TessellationEval) {
-        Shader::Optimization::ConstantPropagationPass(program.post_order_blocks);
-        Shader::Optimization::TessellationPreprocess(program, runtime_info);
-        Shader::Optimization::ConstantPropagationPass(program.post_order_blocks);
-        Shader::Optimization::DomainShaderTransform(program, runtime_info);
+        RunPass(stats, program, "ConstantPropagation", ConstantPropagationPass,
+                program.post_order_blocks);
+        RunPass(stats, program, "TessellationPreprocess", TessellationPreprocess, program,
+                runtime_info);
+        RunPass(stats, program, "ConstantPropagation", ConstantPropagationPass,
+                program.post_order_blocks);
+        RunPass(stats, program, "DomainShaderTransform", DomainShaderTransform, program,
+                runtime_info);
     }
-    Shader::Optimization::ConstantPropagationPass(program.post_order_blocks);
-    Shader::Optimization::RingAccessElimination(program, runtime_info, stage);
+    RunPass(stats, program, "ConstantPropagation", ConstantPropagationPass,
+            program.post_order_blocks);
+    RunPass(stats, program, "RingAccessElimination", RingAccessElimination, program, runtime_info,
+            stage);
     if (stage != Stage::Compute) {
-        Shader::Optimization::LowerSharedMemToRegisters(program);
+        RunPass(stats, program, "LowerSharedMemToRegisters", LowerSharedMemToRegisters, program);
     }
-    Shader::Optimization::ConstantPropagationPass(program.post_order_blocks);
-    Shader::Optimization::FlattenExtendedUserdataPass(program);
-    Shader::Optimization::ResourceTrackingPass(program);
-    Shader::Optimization::IdentityRemovalPass(program.blocks);
-    Shader::Optimization::DeadCodeEliminationPass(program);
-    Shader::Optimization::CollectShaderInfoPass(program);
-    Shader::Optimization::SharedMemoryBarrierPass(program, profile);
+    RunPass(stats, program, "ConstantPropagation", ConstantPropagationPass,
+            program.post_order_blocks);
+    RunPass(stats, program, "FlattenExtendedUserdata", FlattenExtendedUserdataPass, program);
+    RunPass(stats, program, "ResourceTracking", ResourceTrackingPass, program);
+    RunPass(stats, program, "IdentityRemoval", IdentityRemovalPass, program.blocks,
+            &pools.arena);
+    RunPass(stats, program, "GlobalValueNumbering", GlobalValueNumberingPass, program,
+            &pools.arena);
+    RunPass(stats, program, "LoopInvariantCodeMotion", LoopInvariantCodeMotionPass, program,
+            &pools.arena);
+    RunPass(stats, program, "DeadCodeElimination", DeadCodeEliminationPass, program);
+    RunPass(stats, program, "CollectShaderInfo", CollectShaderInfoPass, program);
+    RunPass(stats, program, "SharedMemoryBarrier", SharedMemoryBarrierPass, program, profile);
 
     return program;
 }
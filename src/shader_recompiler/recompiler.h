@@ -3,31 +3,42 @@
 
 #pragma once
 
+#include "common/arena.h"
 #include "common/object_pool.h"
+#include "shader_recompiler/frontend/control_flow_graph.h"
 #include "shader_recompiler/ir/basic_block.h"
 #include "shader_recompiler/ir/program.h"
 
 namespace Shader {
 
+struct PassStats;
 struct Profile;
 struct RuntimeInfo;
 
 struct Pools {
     static constexpr u32 InstPoolSize = 8192;
     static constexpr u32 BlockPoolSize = 32;
+    static constexpr u32 GcnBlockPoolSize = 64;
 
     Common::ObjectPool<IR::Inst> inst_pool;
     Common::ObjectPool<IR::Block> block_pool;
+    Common::ObjectPool<Gcn::Block> gcn_block_pool;
+    /// Scratch memory of the decoder, control flow analysis and passes.
+    Common::Arena arena;
 
-    explicit Pools() : inst_pool{InstPoolSize}, block_pool{BlockPoolSize} {}
+    explicit Pools()
+        : inst_pool{InstPoolSize}, block_pool{BlockPoolSize}, gcn_block_pool{GcnBlockPoolSize} {}
 
     void ReleaseContents() {
         inst_pool.ReleaseContents();
         block_pool.ReleaseContents();
+        gcn_block_pool.ReleaseContents();
+        arena.Reset();
     }
 };
 
 [[nodiscard]] IR::Program TranslateProgram(std::span<const u32> code, Pools& pools, Info& info,
-                                           RuntimeInfo& runtime_info, const Profile& profile);
+                                           RuntimeInfo& runtime_info, const Profile& profile,
+                                           PassStats* stats = nullptr);
 
 } // namespace Shader
@@ -0,0 +1,142 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <cstring>
+#include "common/serdes.h"
+#include "shader_recompiler/frontend/fetch_shader.h"
+#include "shader_recompiler/info.h"
+#include "shader_recompiler/replay.h"
+
+namespace Shader {
+
+namespace {
+
+constexpr VAddr PointerMask = 0xFFFFFFFFFFFFULL;
+
+struct MemoryRange {
+    VAddr begin;
+    VAddr end;
+};
+
+} // Anonymous namespace
+
+void ShaderReplay::Capture(const Info& info) {
+    stage = info.stage;
+    l_stage = info.l_stage;
+    hash = info.pgm_hash;
+    std::ranges::copy(info.user_data.first(user_data.size()), user_data.begin());
+
+    std::vector<MemoryRange> ranges;
+    const auto add_range = [&](VAddr address, size_t size) {
+        ranges.emplace_back(address, address + size);
+    };
+    const auto read_pointer = [](const void* src) {
+        u64 value;
+        std::memcpy(&value, src, sizeof(value));
+        return VAddr(value) & PointerMask;
+    };
+
+    // Fetch shader code and the vertex buffer V# it loads.
+    if (const auto fetch_data = Gcn::ParseFetchShader(info)) {
+        add_range(reinterpret_cast<VAddr>(fetch_data->code), fetch_data->size);
+        for (const auto& attrib : fetch_data->attributes) {
+            if (attrib.sgpr_base == IR::NumScalarRegs) {
+                continue;
+            }
+            const VAddr table = read_pointer(&user_data[attrib.sgpr_base]);
+            add_range(table + attrib.dword_offset * sizeof(u32), sizeof(AmdGpu::Buffer));
+        }
+    }
+
+    // Replay the SRT walker to find the tables it dereferences. The root table is user data.
+    boost::container::small_vector<VAddr, 8> tables{0};
+    for (const auto& op : info.srt_info.walker_program) {
+        const VAddr table = tables.back();
+        switch (op.type) {
+        case SrtWalkerOp::Type::PushPtr:
+            if (table == 0) {
+                tables.push_back(read_pointer(&user_data[op.src_off_dw]));
+            } else {
+                const VAddr slot = table + op.src_off_dw * sizeof(u32);
+                add_range(slot, sizeof(u64));
+                tables.push_back(read_pointer(reinterpret_cast<const void*>(slot)));
+            }
+            break;
+        case SrtWalkerOp::Type::Copy:
+            if (table != 0) {
+                add_range(table + op.src_off_dw * sizeof(u32), sizeof(u32));
+            }
+            break;
+        case SrtWalkerOp::Type::PopPtr:
+            tables.pop_back();
+            break;
+        }
+    }
+
+    // Tessellation constant buffer and its V#.
+    if (info.tess_consts_dword_offset >= 0) {
+        const auto ptr_base = static_cast<u32>(info.tess_consts_ptr_base);
+        const auto dword_offset = static_cast<u32>(info.tess_consts_dword_offset);
+        if (ptr_base != IR::NumScalarRegs) {
+            const VAddr table = read_pointer(&user_data[ptr_base]);
+            add_range(table + dword_offset * sizeof(u32), sizeof(AmdGpu::Buffer));
+        }
+        const auto buffer = info.ReadUdReg<AmdGpu::Buffer>(ptr_base, dword_offset);
+        add_range(buffer.base_address, sizeof(TessellationDataConstantBuffer));
+    }
+
+    // Coalesce overlapping ranges and snapshot their contents.
+    std::ranges::sort(ranges, {}, &MemoryRange::begin);
+    memory.clear();
+    for (size_t i = 0; i < ranges.size();) {
+        const VAddr begin = ranges[i].begin;
+        VAddr end = ranges[i].end;
+        for (++i; i < ranges.size() && ranges[i].begin <= end; ++i) {
+            end = std::max(end, ranges[i].end);
+        }
+        auto& block = memory.emplace_back(begin, std::vector<u8>(end - begin));
+        std::memcpy(block.data.data(), reinterpret_cast<const void*>(begin), block.data.size());
+    }
+}
+
+void ShaderReplay::Serialize(Serialization::Writer& writer) const {
+    writer.Write(Version);
+    writer.Write(stage);
+    writer.Write(l_stage);
+    writer.Write(hash);
+    writer.Write(user_data);
+    writer.Write(runtime_info);
+    writer.Write(profile);
+    writer.Write(binding);
+    writer.Write(static_cast<u32>(memory.size()));
+    for (const auto& block : memory) {
+        writer.Write(block.address);
+        writer.WriteVector(block.data);
+    }
+}
+
+bool ShaderReplay::Deserialize(Serialization::Reader& reader) {
+    u32 version{};
+    if (!reader.Read(version) || version != Version) {
+        return false;
+    }
+    reader.Read(stage);
+    reader.Read(l_stage);
+    reader.Read(hash);
+    reader.Read(user_data);
+    reader.Read(runtime_info);
+    reader.Read(profile);
+    reader.Read(binding);
+    u32 num_blocks{};
+    reader.Read(num_blocks);
+    memory.clear();
+    for (u32 i = 0; i < num_blocks && !reader.Failed(); ++i) {
+        auto& block = memory.emplace_back();
+        reader.Read(block.address);
+        reader.ReadVector(block.data);
+    }
+    return !reader.Failed();
+}
+
+} // namespace Shader
@@ -0,0 +1,56 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include "common/types.h"
+#include "shader_recompiler/backend/bindings.h"
+#include "shader_recompiler/params.h"
+#include "shader_recompiler/profile.h"
+#include "shader_recompiler/runtime_info.h"
+
+namespace Serialization {
+class Writer;
+class Reader;
+} // namespace Serialization
+
+namespace Shader {
+
+struct Info;
+
+/**
+ * Inputs of a single shader compilation, dumped next to the shader binary so the recompiler
+ * can be run again outside of the emulator. Besides user data the recompiler reads guest
+ * memory through it (fetch shader, vertex V# tables, SRT tables, tessellation constants);
+ * those ranges are captured with their original addresses and have to be mapped back at the
+ * same location before recompiling.
+ */
+struct ShaderReplay {
+    static constexpr u32 Version = 1;
+
+    struct MemoryBlock {
+        VAddr address;
+        std::vector<u8> data;
+    };
+
+    Stage stage{};
+    LogicalStage l_stage{};
+    u64 hash{};
+    std::array<u32, ShaderParams::NumShaderUserData> user_data{};
+    RuntimeInfo runtime_info{};
+    Profile profile{};
+    Backend::Bindings binding{};
+    std::vector<MemoryBlock> memory;
+
+    /// Records stage, user data and the guest memory read while compiling the program
+    /// described by info. Runtime info, profile and bindings are left to the caller as they
+    /// must be captured before TranslateProgram modifies them.
+    void Capture(const Info& info);
+
+    void Serialize(Serialization::Writer& writer) const;
+    bool Deserialize(Serialization::Reader& reader);
+};
+
+} // namespace Shader
@@ -5,6 +5,7 @@
 
 #include <bitset>
 
+#include "common/serdes.h"
 #include "common/types.h"
 #include "frontend/fetch_shader.h"
 #include "shader_recompiler/backend/bindings.h"
@@ -67,7 +68,7 @@ struct SamplerSpecialization {
 struct StageSpecialization {
     static constexpr size_t MaxStageResources = 64;
 
-    const Shader::Info* info;
+    const Shader::Info* info{};
     RuntimeInfo runtime_info;
     std::optional<Gcn::FetchShaderData> fetch_shader_data{};
     boost::container::small_vector<VsAttribSpecialization, 32> vs_attribs;
@@ -79,6 +80,8 @@ struct StageSpecialization {
     boost::container::small_vector<SamplerSpecialization, 16> samplers;
     Backend::Bindings start{};
 
+    StageSpecialization() : runtime_info{} {}
+
     explicit StageSpecialization(const Info& info_, RuntimeInfo runtime_info_,
                                  const Profile& profile_, Backend::Bindings start_)
         : info{&info_}, runtime_info{runtime_info_}, start{start_} {
@@ -164,6 +167,63 @@ struct StageSpecialization {
         }
     }
 
+    /// Version of the serialized specialization. Bump when any serialized field or the layout of
+    /// a type written as raw bytes changes.
+    static constexpr u32 SerializationVersion = 1;
+
+    void Serialize(Serialization::Writer& writer) const {
+        static_assert(std::is_trivially_copyable_v<RuntimeInfo>);
+        static_assert(std::is_trivially_copyable_v<Backend::Bindings>);
+        static_assert(std::is_trivially_copyable_v<BufferSpecialization>);
+        static_assert(std::is_trivially_copyable_v<ImageSpecialization>);
+        writer.Write(SerializationVersion);
+        writer.Write(runtime_info);
+        writer.Write(fetch_shader_data.has_value());
+        if (fetch_shader_data) {
+            writer.WriteVector(fetch_shader_data->attributes);
+            writer.Write(fetch_shader_data->vertex_offset_sgpr);
+            writer.Write(fetch_shader_data->instance_offset_sgpr);
+        }
+        writer.WriteVector(vs_attribs);
+        writer.Write(u64(bitset.to_ullong()));
+        writer.WriteVector(buffers);
+        writer.WriteVector(tex_buffers);
+        writer.WriteVector(images);
+        writer.WriteVector(fmasks);
+        writer.WriteVector(samplers);
+        writer.Write(start);
+    }
+
+    bool Deserialize(Serialization::Reader& reader, const Shader::Info& info_) {
+        info = &info_;
+        u32 version{};
+        bool has_fetch_shader{};
+        if (!reader.Read(version) || version != SerializationVersion) {
+            return false;
+        }
+        reader.Read(runtime_info);
+        reader.Read(has_fetch_shader);
+        if (has_fetch_shader) {
+            // Guest code pointer is only valid for live specializations, it is not compared.
+            auto& data = fetch_shader_data.emplace();
+            data.code = nullptr;
+            reader.ReadVector(data.attributes);
+            reader.Read(data.vertex_offset_sgpr);
+            reader.Read(data.instance_offset_sgpr);
+        }
+        u64 bits{};
+        reader.ReadVector(vs_attribs);
+        reader.Read(bits);
+        bitset = bits;
+        reader.ReadVector(buffers);
+        reader.ReadVector(tex_buffers);
+        reader.ReadVector(images);
+        reader.ReadVector(fmasks);
+        reader.ReadVector(samplers);
+        reader.Read(start);
+        return !reader.Failed();
+    }
+
     bool operator==(const StageSpecialization& other) const {
         if (start != other.start) {
             return false;
@@ -0,0 +1,184 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Microbenchmark of the buffer cache range lookups done by ObtainBuffer when it has to resolve
+// overlaps. Populates the address space with large and fragmented buffer layouts and compares
+// walking the page table page by page against querying the ordered buffer index.
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+#include "common/div_ceil.h"
+#include "video_core/buffer_cache/buffer_index.h"
+#include "video_core/multi_level_page_table.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using BufferId = Common::SlotId;
+
+constexpr u32 CachingPageBits = 12;
+constexpr u64 CachingPageSize = u64{1} << CachingPageBits;
+constexpr VAddr SpanBase = 0x200000000ULL;
+
+struct Traits {
+    using Entry = BufferId;
+    static constexpr size_t AddressSpaceBits = 40;
+    static constexpr size_t FirstLevelBits = 14;
+    static constexpr size_t PageBits = CachingPageBits;
+};
+
+struct FakeBuffer {
+    VAddr begin;
+    VAddr end;
+};
+
+/// Buffer placement of a scenario: buffers of buffer_size placed every stride bytes.
+struct Layout {
+    std::string_view name;
+    u64 buffer_size;
+    u64 stride;
+};
+
+struct Cache {
+    std::vector<FakeBuffer> buffers{{}}; // Slot zero is the null buffer.
+    VideoCore::MultiLevelPageTable<Traits> page_table;
+    VideoCore::BufferIndex index;
+
+    void Insert(VAddr begin, VAddr end) {
+        const BufferId id{static_cast<u32>(buffers.size())};
+        buffers.push_back({begin, end});
+        for (u64 page = begin >> CachingPageBits; page < (end >> CachingPageBits); ++page) {
+            page_table[page] = id;
+        }
+        index.Insert(begin, end, id);
+    }
+
+    /// The lookup the buffer cache did before the index existed.
+    u64 WalkPages(VAddr addr, u64 size) {
+        u64 checksum = 0;
+        const u64 page_end = Common::DivCeil(addr + size, CachingPageSize);
+        for (u64 page = addr >> CachingPageBits; page < page_end;) {
+            const BufferId buffer_id = page_table[page];
+            if (!buffer_id) {
+                ++page;
+                continue;
+            }
+            checksum += buffer_id.index;
+            page = Common::DivCeil(buffers[buffer_id.index].end, CachingPageSize);
+        }
+        return checksum;
+    }
+
+    u64 QueryIndex(VAddr addr, u64 size) {
+        u64 checksum = 0;
+        index.ForEachOverlapping(addr, addr + size,
+                                 [&](BufferId buffer_id) { checksum += buffer_id.index; });
+        return checksum;
+    }
+};
+
+} // Anonymous namespace
+
+int main(int argc, char* argv[]) {
+    u64 span = 1_GB;
+    size_t num_queries = 20000;
+
+    std::unordered_map<std::string, std::function<void(int&)>> arg_map = {
+        {"-h",
+         [&](int&) {
+             std::cout << "Usage: shadps4-buffer-lookup-bench [options]\n"
+                          "Measures buffer cache range lookups on populated address spaces.\n"
+                          "Options:\n"
+                          "  -s, --span <MB>        Size of the populated region (default 1024)\n"
+                          "  -q, --queries <N>      Lookups per measurement (default 20000)\n"
+                          "  -h, --help             Display this help message\n";
+             exit(0);
+         }},
+        {"--help", [&](int& i) { arg_map["-h"](i); }},
+        {"-s",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for -s/--span\n";
+                 exit(1);
+             }
+             span = std::max(std::stoul(argv[i]), 64UL) * 1_MB;
+         }},
+        {"--span", [&](int& i) { arg_map["-s"](i); }},
+        {"-q",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for -q/--queries\n";
+                 exit(1);
+             }
+             num_queries = std::max(std::stoul(argv[i]), 1UL);
+         }},
+        {"--queries", [&](int& i) { arg_map["-q"](i); }},
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        std::string cur_arg = argv[i];
+        auto it = arg_map.find(cur_arg);
+        if (it == arg_map.end()) {
+            std::cerr << "Unknown argument: " << cur_arg << ", see --help for info.\n";
+            return 1;
+        }
+        it->second(i);
+    }
+
+    static constexpr Layout layouts[] = {
+        {"large", 16_MB, 32_MB},
+        {"fragmented", 64_KB, 1_MB},
+        {"dense", 4_KB, 8_KB},
+    };
+    static constexpr u64 query_sizes[] = {64_KB, 4_MB, 64_MB};
+
+    int num_mismatches = 0;
+    fmt::print("{:<11} {:>8} {:>8} {:>12} {:>12}\n", "layout", "buffers", "range", "pages ns",
+               "index ns");
+    for (const Layout& layout : layouts) {
+        Cache cache;
+        for (VAddr addr = SpanBase; addr + layout.buffer_size <= SpanBase + span;
+             addr += layout.stride) {
+            cache.Insert(addr, addr + layout.buffer_size);
+        }
+        for (const u64 query_size : query_sizes) {
+            std::mt19937_64 rng{1234};
+            std::uniform_int_distribution<u64> dist{0, (span - query_size) / CachingPageSize};
+            std::vector<VAddr> queries(num_queries);
+            for (VAddr& addr : queries) {
+                addr = SpanBase + dist(rng) * CachingPageSize;
+            }
+
+            const auto measure = [&](auto&& lookup, u64& checksum) {
+                const auto start = Clock::now();
+                for (const VAddr addr : queries) {
+                    checksum += lookup(addr, query_size);
+                }
+                const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+                return elapsed.count() / queries.size();
+            };
+            u64 pages_checksum = 0;
+            u64 index_checksum = 0;
+            const double pages_ns = measure(
+                [&](VAddr addr, u64 size) { return cache.WalkPages(addr, size); }, pages_checksum);
+            const double index_ns = measure(
+                [&](VAddr addr, u64 size) { return cache.QueryIndex(addr, size); }, index_checksum);
+            if (pages_checksum != index_checksum) {
+                fmt::print("Mismatch: {} {}KB\n", layout.name, query_size / 1_KB);
+                ++num_mismatches;
+            }
+            fmt::print("{:<11} {:>8} {:>6}KB {:>12.1f} {:>12.1f}\n", layout.name,
+                       cache.index.Size(), query_size / 1_KB, pages_ns, index_ns);
+        }
+    }
+    return num_mismatches == 0 ? 0 : 1;
+}
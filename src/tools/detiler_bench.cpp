@@ -0,0 +1,214 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Microbenchmark of the CPU detiler. Detiles synthetic images of every supported tiling mode and
+// bpp with each instruction set the host supports and reports the throughput.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+#include "video_core/texture_cache/cpu_detiler.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using VideoCore::DetilerIsa;
+
+constexpr std::array AllIsas{DetilerIsa::Generic, DetilerIsa::Sse41, DetilerIsa::Avx2};
+
+std::string_view NameOf(DetilerIsa isa) {
+    switch (isa) {
+    case DetilerIsa::Generic:
+        return "generic";
+    case DetilerIsa::Sse41:
+        return "sse4.1";
+    case DetilerIsa::Avx2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+/// A synthetic square image of the requested size, tiled in one of the supported modes.
+struct BenchImage {
+    bool is_volume;
+    u32 bpp;
+    u32 num_units;
+    VideoCore::MicroTileLayout micro;
+    VideoCore::MacroTileLayout macro;
+};
+
+BenchImage MakeImage(bool is_volume, u32 bpp, size_t size) {
+    BenchImage image{.is_volume = is_volume, .bpp = bpp};
+    const u32 bytes = bpp / 8;
+    if (is_volume) {
+        // Volumes are 4 slices deep so every slice of a thick tile is populated.
+        u32 dim = 8;
+        while (u64(dim * 2) * dim * 2 * 4 * bytes <= size) {
+            dim *= 2;
+        }
+        image.macro = {
+            .bpp = bpp,
+            .pitch = dim,
+            .height = dim,
+            .tiles_per_row = dim / 8,
+            .tiles_per_slice = (dim / 8) * (dim / 8),
+        };
+        image.num_units = dim * dim * 4;
+    } else {
+        u32 dim = 8;
+        while (u64(dim * 2) * dim * 2 * bytes <= size) {
+            dim *= 2;
+        }
+        image.micro = {.bpp = bpp, .pitch = dim, .num_levels = 1};
+        image.micro.level_ends[0] = dim * dim * bytes;
+        image.num_units = dim * dim / 64;
+    }
+    return image;
+}
+
+size_t SizeOf(const BenchImage& image) {
+    return image.is_volume ? size_t(image.num_units) * image.bpp / 8
+                           : size_t(image.num_units) * 64 * image.bpp / 8;
+}
+
+void Detile(const BenchImage& image, std::span<u8> out, std::span<const u8> in, DetilerIsa isa) {
+    if (image.is_volume) {
+        VideoCore::DetileMacro(image.macro, out, in, 0, image.num_units, isa);
+    } else {
+        VideoCore::DetileMicro(image.micro, out, in, 0, image.num_units, isa);
+    }
+}
+
+} // Anonymous namespace
+
+int main(int argc, char* argv[]) {
+    size_t image_size = 16_MB;
+    size_t iterations = 20;
+    bool verify = false;
+    std::vector<DetilerIsa> isas;
+
+    std::unordered_map<std::string, std::function<void(int&)>> arg_map = {
+        {"-h",
+         [&](int&) {
+             std::cout << "Usage: shadps4-detiler-bench [options]\n"
+                          "Measures the CPU detiler throughput for every tiling mode and bpp.\n"
+                          "Options:\n"
+                          "  -s, --size <MB>        Size of the detiled images (default 16)\n"
+                          "  -i, --iterations <n>   Number of timed runs per image (default 20)\n"
+                          "  --isa <name>           Only run generic, sse4.1 or avx2 kernels\n"
+                          "  --verify               Compare every kernel with the generic one\n"
+                          "  -h, --help             Display this help message\n";
+             exit(0);
+         }},
+        {"--help", [&](int& i) { arg_map["-h"](i); }},
+        {"-s",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for -s/--size\n";
+                 exit(1);
+             }
+             image_size = std::max(std::stoul(argv[i]), 1UL) * 1_MB;
+         }},
+        {"--size", [&](int& i) { arg_map["-s"](i); }},
+        {"-i",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for -i/--iterations\n";
+                 exit(1);
+             }
+             iterations = std::max(std::stoul(argv[i]), 1UL);
+         }},
+        {"--iterations", [&](int& i) { arg_map["-i"](i); }},
+        {"--isa",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for --isa\n";
+                 exit(1);
+             }
+             const auto it = std::ranges::find(AllIsas, std::string_view{argv[i]}, NameOf);
+             if (it == AllIsas.end()) {
+                 std::cerr << "Error: Unknown instruction set " << argv[i] << "\n";
+                 exit(1);
+             }
+             isas.push_back(*it);
+         }},
+        {"--verify", [&](int&) { verify = true; }},
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        std::string cur_arg = argv[i];
+        auto it = arg_map.find(cur_arg);
+        if (it == arg_map.end()) {
+            std::cerr << "Unknown argument: " << cur_arg << ", see --help for info.\n";
+            return 1;
+        }
+        it->second(i);
+    }
+
+    const DetilerIsa host_isa = VideoCore::GetHostDetilerIsa();
+    if (isas.empty()) {
+        for (const DetilerIsa isa : AllIsas) {
+            if (isa <= host_isa) {
+                isas.push_back(isa);
+            }
+        }
+    } else if (std::ranges::any_of(isas, [&](DetilerIsa isa) { return isa > host_isa; })) {
+        std::cerr << "Error: The host CPU only supports up to " << NameOf(host_isa) << "\n";
+        return 1;
+    }
+
+    std::vector<BenchImage> images;
+    for (const u32 bpp : {8U, 16U, 32U, 64U, 128U}) {
+        images.push_back(MakeImage(false, bpp, image_size));
+    }
+    for (const u32 bpp : {8U, 32U, 64U}) {
+        images.push_back(MakeImage(true, bpp, image_size));
+    }
+
+    std::mt19937 rng{0x5D4};
+    std::vector<u8> input(image_size);
+    std::ranges::generate(input, [&] { return static_cast<u8>(rng()); });
+    std::vector<u8> output(image_size);
+    std::vector<u8> reference(image_size);
+
+    int num_mismatches = 0;
+    fmt::print("{:<6} {:>4} {:<8} {:>10} {:>10}\n", "mode", "bpp", "isa", "size", "GB/s");
+    for (const BenchImage& image : images) {
+        const size_t size = SizeOf(image);
+        const std::span<const u8> in{input.data(), size};
+        const std::span<u8> out{output.data(), size};
+        if (verify) {
+            Detile(image, {reference.data(), size}, in, DetilerIsa::Generic);
+        }
+        for (const DetilerIsa isa : isas) {
+            // Warm up caches and page in the output before timing.
+            Detile(image, out, in, isa);
+            if (verify && !std::equal(out.begin(), out.end(), reference.begin())) {
+                fmt::print("Mismatch: {} {}bpp {}\n", image.is_volume ? "macro" : "micro",
+                           image.bpp, NameOf(isa));
+                ++num_mismatches;
+            }
+            const auto start = Clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                Detile(image, out, in, isa);
+            }
+            const std::chrono::duration<double> elapsed = Clock::now() - start;
+            const double bytes_per_second = double(size) * iterations / elapsed.count();
+            fmt::print("{:<6} {:>4} {:<8} {:>8}KB {:>10.2f}\n", image.is_volume ? "macro" : "micro",
+                       image.bpp, NameOf(isa), size / 1_KB, bytes_per_second / 1e9);
+        }
+    }
+    if (verify) {
+        fmt::print("{} mismatches\n", num_mismatches);
+    }
+    return num_mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,513 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Offline shader recompiler. Recompiles shader dumps (.bin + .replay, written by the emulator
+// when shader dumping is enabled) without a GPU and reports per-pass timings.
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <latch>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+#include "common/io_file.h"
+#include "common/logging/backend.h"
+#include "common/path_util.h"
+#include "common/scope_exit.h"
+#include "common/serdes.h"
+#include "common/thread_pool.h"
+#include "shader_recompiler/backend/spirv/emit_spirv.h"
+#include "shader_recompiler/frontend/decode.h"
+#include "shader_recompiler/info.h"
+#include "shader_recompiler/pass_stats.h"
+#include "shader_recompiler/recompiler.h"
+#include "shader_recompiler/replay.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct ShaderDump {
+    std::string name;
+    std::vector<u32> code;
+    Shader::ShaderReplay replay;
+};
+
+struct CompileResult {
+    bool compiled{};
+    std::string error;
+    Shader::PassStats stats;
+    std::chrono::nanoseconds translate_time{};
+    std::chrono::nanoseconds emit_time{};
+    std::vector<u32> spv;
+};
+
+/**
+ * Guest memory captured by a set of replays, kept at page granularity so it can be mapped
+ * back at its original addresses. Replays are only compatible with each other if the bytes
+ * they captured agree wherever they overlap.
+ */
+class GuestMemory {
+public:
+    // Allocation granularity on Windows, also a multiple of the host page size everywhere else.
+    static constexpr VAddr PageSize = 64_KB;
+
+    GuestMemory() = default;
+    ~GuestMemory() {
+        Unmap();
+    }
+
+    GuestMemory(const GuestMemory&) = delete;
+    GuestMemory& operator=(const GuestMemory&) = delete;
+    GuestMemory(GuestMemory&&) = default;
+    GuestMemory& operator=(GuestMemory&&) = default;
+
+    bool IsCompatible(const Shader::ShaderReplay& replay) const {
+        for (const auto& block : replay.memory) {
+            for (size_t i = 0; i < block.data.size(); ++i) {
+                const VAddr addr = block.address + i;
+                const auto it = pages.find(addr & ~(PageSize - 1));
+                if (it == pages.end()) {
+                    continue;
+                }
+                const size_t offset = addr & (PageSize - 1);
+                if (it->second->valid[offset] && it->second->data[offset] != block.data[i]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void Add(const Shader::ShaderReplay& replay) {
+        for (const auto& block : replay.memory) {
+            for (size_t i = 0; i < block.data.size(); ++i) {
+                const VAddr addr = block.address + i;
+                auto& page = pages[addr & ~(PageSize - 1)];
+                if (!page) {
+                    page = std::make_unique<Page>();
+                }
+                const size_t offset = addr & (PageSize - 1);
+                page->data[offset] = block.data[i];
+                page->valid[offset] = true;
+            }
+        }
+    }
+
+    /// Maps all captured pages at their guest address. Returns false if any of them is
+    /// already in use by the host process.
+    bool Map() {
+        for (auto it = pages.begin(); it != pages.end();) {
+            // Map contiguous runs of pages at once.
+            const VAddr begin = it->first;
+            VAddr end = begin + PageSize;
+            auto run_end = std::next(it);
+            while (run_end != pages.end() && run_end->first == end) {
+                end += PageSize;
+                ++run_end;
+            }
+            if (!MapRange(begin, end - begin)) {
+                fmt::print(stderr, "Unable to map guest memory at {:#x}-{:#x}\n", begin, end);
+                Unmap();
+                return false;
+            }
+            mapped.emplace_back(begin, end - begin);
+            for (; it != run_end; ++it) {
+                std::memcpy(reinterpret_cast<void*>(it->first), it->second->data.data(),
+                            PageSize);
+            }
+        }
+        return true;
+    }
+
+    void Unmap() {
+        for (const auto& [address, size] : mapped) {
+            UnmapRange(address, size);
+        }
+        mapped.clear();
+    }
+
+private:
+    struct Page {
+        std::array<u8, PageSize> data{};
+        std::bitset<PageSize> valid;
+    };
+
+    static bool MapRange(VAddr address, size_t size) {
+        void* const target = reinterpret_cast<void*>(address);
+#ifdef _WIN32
+        void* const ptr = VirtualAlloc(target, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        return ptr == target;
+#else
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_FIXED_NOREPLACE
+        flags |= MAP_FIXED_NOREPLACE;
+#endif
+        void* const ptr = mmap(target, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+        if (ptr != target) {
+            munmap(ptr, size);
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    static void UnmapRange(VAddr address, size_t size) {
+#ifdef _WIN32
+        VirtualFree(reinterpret_cast<void*>(address), 0, MEM_RELEASE);
+#else
+        munmap(reinterpret_cast<void*>(address), size);
+#endif
+    }
+
+    std::map<VAddr, std::unique_ptr<Page>> pages;
+    std::vector<std::pair<VAddr, size_t>> mapped;
+};
+
+std::vector<ShaderDump> LoadDumps(const std::filesystem::path& dump_dir) {
+    using namespace Common::FS;
+    std::vector<ShaderDump> dumps;
+    size_t num_missing_replays{};
+    for (const auto& entry : std::filesystem::directory_iterator{dump_dir}) {
+        const auto& bin_path = entry.path();
+        if (!entry.is_regular_file() || bin_path.extension() != ".bin") {
+            continue;
+        }
+        auto replay_path = bin_path;
+        replay_path.replace_extension(".replay");
+        if (!std::filesystem::exists(replay_path)) {
+            ++num_missing_replays;
+            continue;
+        }
+
+        ShaderDump dump{.name = PathToUTF8String(bin_path.stem())};
+        {
+            const auto file = IOFile{bin_path, FileAccessMode::Read};
+            dump.code.resize(file.GetSize() / sizeof(u32));
+            file.Read(dump.code);
+        }
+        std::vector<u8> replay_data;
+        {
+            const auto file = IOFile{replay_path, FileAccessMode::Read};
+            replay_data.resize(file.GetSize());
+            file.Read(replay_data);
+        }
+        Serialization::Reader reader{replay_data};
+        if (dump.code.empty() || !dump.replay.Deserialize(reader)) {
+            fmt::print(stderr, "Skipping {}: invalid or outdated replay\n", dump.name);
+            continue;
+        }
+        dumps.emplace_back(std::move(dump));
+    }
+    if (num_missing_replays != 0) {
+        fmt::print(stderr, "Skipped {} shader binaries without a replay file\n",
+                   num_missing_replays);
+    }
+    return dumps;
+}
+
+CompileResult Compile(const ShaderDump& dump, Shader::Pools& pools) {
+    const auto& replay = dump.replay;
+    const Shader::ShaderParams params = {
+        .user_data = replay.user_data,
+        .code = dump.code,
+        .hash = replay.hash,
+    };
+    auto info = Shader::Info(replay.stage, replay.l_stage, params);
+    auto runtime_info = replay.runtime_info;
+    auto binding = replay.binding;
+
+    CompileResult result{};
+    try {
+        const auto translate_start = Clock::now();
+        const auto program = Shader::TranslateProgram(dump.code, pools, info, runtime_info,
+                                                      replay.profile, &result.stats);
+        const auto emit_start = Clock::now();
+        result.spv =
+            Shader::Backend::SPIRV::EmitSPIRV(replay.profile, runtime_info, program, binding);
+        const auto emit_end = Clock::now();
+        result.stats.AddBackend("EmitSPIRV", emit_end - emit_start);
+
+        result.translate_time = emit_start - translate_start;
+        result.emit_time = emit_end - emit_start;
+        result.compiled = true;
+    } catch (const std::exception& e) {
+        // Unsupported shaders are reported and skipped, the rest of the round keeps going.
+        result = CompileResult{.error = e.what()};
+    }
+    return result;
+}
+
+double ToMs(std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+}
+
+void PrintReport(std::span<const ShaderDump> dumps, std::span<const CompileResult> results,
+                 std::chrono::nanoseconds wall_time, size_t num_workers,
+                 const std::filesystem::path& json_path) {
+    Shader::PassStatsCollector pass_stats;
+    std::chrono::nanoseconds total_translate{};
+    std::chrono::nanoseconds total_emit{};
+    size_t num_compiled{};
+    size_t spv_bytes{};
+
+    for (const auto& result : results) {
+        if (!result.compiled) {
+            continue;
+        }
+        ++num_compiled;
+        total_translate += result.translate_time;
+        total_emit += result.emit_time;
+        spv_bytes += result.spv.size() * sizeof(u32);
+        pass_stats.Add(result.stats);
+    }
+
+    fmt::print("\n{}", pass_stats.Summary());
+    if (!json_path.empty()) {
+        const auto file = Common::FS::IOFile{json_path, Common::FS::FileAccessMode::Write};
+        file.WriteString(pass_stats.ToJson());
+    }
+
+    fmt::print("\nCompiled {} of {} shaders in {:.1f} ms using {} threads ({:.1f} shaders/s)\n",
+               num_compiled, dumps.size(), ToMs(wall_time), num_workers,
+               wall_time.count() ? num_compiled / std::chrono::duration<double>(wall_time).count()
+                                 : 0.0);
+    fmt::print("Translate: {:.3f} ms, EmitSPIRV: {:.3f} ms (summed over threads)\n",
+               ToMs(total_translate), ToMs(total_emit));
+    fmt::print("SPIR-V: {} bytes total, {} bytes average\n", spv_bytes,
+               num_compiled ? spv_bytes / num_compiled : 0);
+}
+
+/// Decodes every dump repeatedly on the calling thread and reports decoder throughput.
+void RunDecodeBenchmark(std::span<const ShaderDump> dumps, size_t iterations) {
+    size_t num_insts{};
+    size_t num_bytes{};
+    for (const auto& dump : dumps) {
+        num_insts += Shader::Gcn::CountInstructions(dump.code);
+        num_bytes += dump.code.size() * sizeof(u32);
+    }
+
+    const auto scan_start = Clock::now();
+    size_t scanned{};
+    for (size_t i = 0; i < iterations; ++i) {
+        for (const auto& dump : dumps) {
+            scanned += Shader::Gcn::CountInstructions(dump.code);
+        }
+    }
+    const auto scan_time = Clock::now() - scan_start;
+
+    const auto decode_start = Clock::now();
+    size_t decoded{};
+    std::vector<Shader::Gcn::GcnInst> ins_list;
+    for (size_t i = 0; i < iterations; ++i) {
+        for (const auto& dump : dumps) {
+            Shader::Gcn::GcnCodeSlice slice(dump.code.data(), dump.code.data() + dump.code.size());
+            Shader::Gcn::GcnDecodeContext decoder;
+            ins_list.clear();
+            while (!slice.atEnd()) {
+                ins_list.emplace_back(decoder.decodeInstruction(slice));
+            }
+            decoded += ins_list.size();
+        }
+    }
+    const auto decode_time = Clock::now() - decode_start;
+
+    const auto per_second = [](size_t count, std::chrono::nanoseconds time) {
+        return time.count() ? count / std::chrono::duration<double>(time).count() : 0.0;
+    };
+    fmt::print("Decoded {} shaders ({} instructions, {} bytes) {} times\n", dumps.size(),
+               num_insts, num_bytes, iterations);
+    fmt::print("Length scan: {:.3f} ms, {:.1f} M instructions/s\n", ToMs(scan_time),
+               per_second(scanned, scan_time) / 1e6);
+    fmt::print("Full decode: {:.3f} ms, {:.1f} M instructions/s, {:.1f} MB/s\n",
+               ToMs(decode_time), per_second(decoded, decode_time) / 1e6,
+               per_second(num_bytes * iterations, decode_time) / 1e6);
+}
+
+} // Anonymous namespace
+
+int main(int argc, char* argv[]) {
+    size_t num_workers = std::max(std::thread::hardware_concurrency(), 1U);
+    std::filesystem::path dump_dir;
+    std::filesystem::path output_dir;
+    std::filesystem::path json_path;
+    size_t decode_iterations = 0;
+    bool verbose = false;
+
+    std::unordered_map<std::string, std::function<void(int&)>> arg_map = {
+        {"-h",
+         [&](int&) {
+             std::cout << "Usage: shadps4-shader-recompiler [options] <dump directory>\n"
+                          "Recompiles shader dumps (.bin with a matching .replay) produced by\n"
+                          "shadps4 with dumpShaders enabled and reports per-pass timings.\n"
+                          "Options:\n"
+                          "  -j, --jobs <count>     Number of compile threads\n"
+                          "  -o, --output <dir>     Write the resulting SPIR-V to this directory\n"
+                          "  --json <file>          Write aggregate pass statistics as JSON\n"
+                          "  --bench-decode <n>     Only decode all shaders n times and report\n"
+                          "                         decoder throughput\n"
+                          "  -v, --verbose          Print timings of every shader\n"
+                          "  -h, --help             Display this help message\n";
+             exit(0);
+         }},
+        {"--help", [&](int& i) { arg_map["-h"](i); }},
+        {"-j",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for -j/--jobs\n";
+                 exit(1);
+             }
+             num_workers = std::max(std::stoul(argv[i]), 1UL);
+         }},
+        {"--jobs", [&](int& i) { arg_map["-j"](i); }},
+        {"-o",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for -o/--output\n";
+                 exit(1);
+             }
+             output_dir = argv[i];
+         }},
+        {"--output", [&](int& i) { arg_map["-o"](i); }},
+        {"--json",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for --json\n";
+                 exit(1);
+             }
+             json_path = argv[i];
+         }},
+        {"--bench-decode",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for --bench-decode\n";
+                 exit(1);
+             }
+             decode_iterations = std::max(std::stoul(argv[i]), 1UL);
+         }},
+        {"-v", [&](int&) { verbose = true; }},
+        {"--verbose", [&](int& i) { arg_map["-v"](i); }},
+    };
+
+    if (argc == 1) {
+        int dummy = 0;
+        arg_map.at("-h")(dummy);
+        return -1;
+    }
+    for (int i = 1; i < argc; ++i) {
+        std::string cur_arg = argv[i];
+        auto it = arg_map.find(cur_arg);
+        if (it != arg_map.end()) {
+            it->second(i);
+        } else if (i == argc - 1) {
+            dump_dir = argv[i];
+        } else {
+            std::cerr << "Unknown argument: " << cur_arg << ", see --help for info.\n";
+            return 1;
+        }
+    }
+    if (!std::filesystem::is_directory(dump_dir)) {
+        std::cerr << "Error: " << dump_dir << " is not a directory\n";
+        return 1;
+    }
+    if (!output_dir.empty()) {
+        std::filesystem::create_directories(output_dir);
+    }
+
+    Common::Log::Initialize("shader_recompiler.log");
+    Common::Log::Start();
+
+    const auto dumps = LoadDumps(dump_dir);
+    if (dumps.empty()) {
+        std::cerr << "No shader dumps found in " << dump_dir << "\n";
+        return 1;
+    }
+    if (decode_iterations != 0) {
+        RunDecodeBenchmark(dumps, decode_iterations);
+        Common::Log::Stop();
+        return 0;
+    }
+
+    // Group shaders whose captured guest memory does not conflict, each group is mapped and
+    // compiled in parallel in turn.
+    std::vector<GuestMemory> rounds;
+    std::vector<std::vector<size_t>> round_shaders;
+    for (size_t i = 0; i < dumps.size(); ++i) {
+        const auto& replay = dumps[i].replay;
+        auto it = std::ranges::find_if(
+            rounds, [&](const GuestMemory& memory) { return memory.IsCompatible(replay); });
+        if (it == rounds.end()) {
+            rounds.emplace_back();
+            round_shaders.emplace_back();
+            it = std::prev(rounds.end());
+        }
+        it->Add(replay);
+        round_shaders[std::distance(rounds.begin(), it)].push_back(i);
+    }
+
+    std::vector<CompileResult> results(dumps.size());
+    std::vector<Shader::Pools> pools(num_workers);
+    Common::ThreadPool pool{num_workers, "ShaderRecompiler"};
+
+    const auto start = Clock::now();
+    for (size_t round = 0; round < rounds.size(); ++round) {
+        if (!rounds[round].Map()) {
+            continue;
+        }
+        const auto& indices = round_shaders[round];
+        std::latch done{static_cast<std::ptrdiff_t>(indices.size())};
+        for (const size_t index : indices) {
+            pool.Submit([&, index](size_t worker) {
+                SCOPE_EXIT {
+                    done.count_down();
+                };
+                results[index] = Compile(dumps[index], pools[worker]);
+            });
+        }
+        done.wait();
+        rounds[round].Unmap();
+    }
+    const auto wall_time = Clock::now() - start;
+
+    for (size_t i = 0; i < dumps.size(); ++i) {
+        const auto& result = results[i];
+        if (!result.compiled) {
+            fmt::print(stderr, "Failed to compile {}: {}\n", dumps[i].name, result.error);
+            continue;
+        }
+        if (verbose) {
+            fmt::print("{}: translate {:.3f} ms, emit {:.3f} ms, {} bytes\n", dumps[i].name,
+                       ToMs(result.translate_time), ToMs(result.emit_time),
+                       result.spv.size() * sizeof(u32));
+        }
+        if (!output_dir.empty()) {
+            const auto file = Common::FS::IOFile{output_dir / fmt::format("{}.spv", dumps[i].name),
+                                                 Common::FS::FileAccessMode::Write};
+            file.WriteSpan(std::span<const u32>{result.spv});
+        }
+    }
+    PrintReport(dumps, results, wall_time, num_workers, json_path);
+
+    Common::Log::Stop();
+    return 0;
+}
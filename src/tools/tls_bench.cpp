@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Microbenchmark of guest __tls_get_addr calls from many threads. Compares looking up the DTV of
+// the calling thread behind the linker wide lock, as TlsGetAddr used to, with the lock-free
+// lookup it does now when the DTV is current.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include "core/tls.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr u32 NumModules = 4;
+constexpr size_t TlsBlockSize = 256;
+
+/// DTV and TLS blocks of one guest thread, set up like the linker does for loaded modules.
+struct ThreadTls {
+    explicit ThreadTls(std::size_t generation) {
+        dtv[0].counter = generation;
+        dtv[1].counter = NumModules;
+        for (u32 i = 0; i < NumModules; ++i) {
+            dtv[i + 2].pointer = blocks[i].data();
+        }
+    }
+
+    std::array<Core::DtvEntry, NumModules + 2> dtv{};
+    std::array<std::array<u8, TlsBlockSize>, NumModules> blocks{};
+};
+
+struct Linker {
+    std::mutex mutex;
+    std::atomic<u32> generation{1};
+
+    void* TlsGetAddrLocked(const Core::DtvEntry* dtv, u64 module_index, u64 offset) {
+        std::scoped_lock lk{mutex};
+        return Core::TryGetTlsAddr(dtv, generation.load(std::memory_order_relaxed), module_index,
+                                   offset);
+    }
+
+    void* TlsGetAddr(const Core::DtvEntry* dtv, u64 module_index, u64 offset) {
+        return Core::TryGetTlsAddr(dtv, generation.load(std::memory_order_acquire), module_index,
+                                   offset);
+    }
+};
+
+} // Anonymous namespace
+
+int main(int argc, char* argv[]) {
+    u32 max_threads = std::max(std::thread::hardware_concurrency(), 1U);
+    u64 calls_per_thread = 2'000'000;
+
+    std::unordered_map<std::string, std::function<void(int&)>> arg_map = {
+        {"-h",
+         [&](int&) {
+             std::cout << "Usage: shadps4-tls-bench [options]\n"
+                          "Measures __tls_get_addr lookups issued from several threads.\n"
+                          "Options:\n"
+                          "  -t, --threads <N>      Largest number of threads (default: cores)\n"
+                          "  -c, --calls <N>        Lookups per thread (default 2000000)\n"
+                          "  -h, --help             Display this help message\n";
+             exit(0);
+         }},
+        {"--help", [&](int& i) { arg_map["-h"](i); }},
+        {"-t",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for -t/--threads\n";
+                 exit(1);
+             }
+             max_threads = std::max(std::stoul(argv[i]), 1UL);
+         }},
+        {"--threads", [&](int& i) { arg_map["-t"](i); }},
+        {"-c",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for -c/--calls\n";
+                 exit(1);
+             }
+             calls_per_thread = std::max(std::stoul(argv[i]), 1UL);
+         }},
+        {"--calls", [&](int& i) { arg_map["-c"](i); }},
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        std::string cur_arg = argv[i];
+        auto it = arg_map.find(cur_arg);
+        if (it == arg_map.end()) {
+            std::cerr << "Unknown argument: " << cur_arg << ", see --help for info.\n";
+            return 1;
+        }
+        it->second(i);
+    }
+
+    Linker linker;
+    const auto run = [&](u32 num_threads, bool locked) {
+        std::vector<std::unique_ptr<ThreadTls>> tls(num_threads);
+        for (auto& thread_tls : tls) {
+            thread_tls = std::make_unique<ThreadTls>(linker.generation.load());
+        }
+        std::atomic<u32> num_failed{};
+        std::vector<std::jthread> threads;
+        const auto start = Clock::now();
+        for (u32 t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&, t] {
+                const Core::DtvEntry* dtv = tls[t]->dtv.data();
+                u32 failed = 0;
+                for (u64 i = 0; i < calls_per_thread; ++i) {
+                    const u64 module_index = 1 + i % NumModules;
+                    const u64 offset = (i * 8) % TlsBlockSize;
+                    void* addr = locked ? linker.TlsGetAddrLocked(dtv, module_index, offset)
+                                        : linker.TlsGetAddr(dtv, module_index, offset);
+                    failed += addr != tls[t]->blocks[module_index - 1].data() + offset;
+                }
+                num_failed += failed;
+            });
+        }
+        threads.clear();
+        const std::chrono::duration<double> elapsed = Clock::now() - start;
+        if (num_failed != 0) {
+            fmt::print("Mismatch: {} wrong addresses\n", num_failed.load());
+        }
+        return std::pair{double(num_threads) * calls_per_thread / elapsed.count() / 1e6,
+                         num_failed == 0};
+    };
+
+    bool all_passed = true;
+    fmt::print("{:>8} {:>14} {:>16}\n", "threads", "locked Mops/s", "lock-free Mops/s");
+    for (u32 num_threads = 1; num_threads <= max_threads;
+         num_threads = num_threads == max_threads ? max_threads + 1
+                                                  : std::min(num_threads * 2, max_threads)) {
+        const auto [locked_rate, locked_passed] = run(num_threads, true);
+        const auto [free_rate, free_passed] = run(num_threads, false);
+        all_passed &= locked_passed && free_passed;
+        fmt::print("{:>8} {:>14.1f} {:>16.1f}\n", num_threads, locked_rate, free_rate);
+    }
+    return all_passed ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Microbenchmark of the buffer cache staging copies. Uploads buffers of increasing size with a
+// plain memcpy, with streaming stores and with the threaded copier and reports the throughput.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+#include "common/logging/backend.h"
+#include "video_core/buffer_cache/staging_copy.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/// Memory allocated as a whole but handed out with an offset, like guest memory and ring buffer
+/// allocations are, so copies are not always nicely aligned.
+struct Allocation {
+    explicit Allocation(size_t size) : storage{std::make_unique<u8[]>(size + 64)} {
+        for (size_t i = 0; i < size + 64; ++i) {
+            storage[i] = static_cast<u8>(i * 131 + 7);
+        }
+    }
+
+    u8* Data(size_t misalignment) {
+        return storage.get() + misalignment;
+    }
+
+    std::unique_ptr<u8[]> storage;
+};
+
+} // Anonymous namespace
+
+int main(int argc, char* argv[]) {
+    size_t max_size = 256_MB;
+    size_t total_bytes = 4_GB;
+
+    std::unordered_map<std::string, std::function<void(int&)>> arg_map = {
+        {"-h",
+         [&](int&) {
+             std::cout << "Usage: shadps4-upload-bench [options]\n"
+                          "Measures the staging copy throughput for buffers of varying size.\n"
+                          "Options:\n"
+                          "  -s, --max-size <MB>    Largest uploaded buffer (default 256)\n"
+                          "  -t, --total <MB>       Bytes copied per measurement (default 4096)\n"
+                          "  -h, --help             Display this help message\n";
+             exit(0);
+         }},
+        {"--help", [&](int& i) { arg_map["-h"](i); }},
+        {"-s",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for -s/--max-size\n";
+                 exit(1);
+             }
+             max_size = std::max(std::stoul(argv[i]), 1UL) * 1_MB;
+         }},
+        {"--max-size", [&](int& i) { arg_map["-s"](i); }},
+        {"-t",
+         [&](int& i) {
+             if (++i >= argc) {
+                 std::cerr << "Error: Missing argument for -t/--total\n";
+                 exit(1);
+             }
+             total_bytes = std::max(std::stoul(argv[i]), 1UL) * 1_MB;
+         }},
+        {"--total", [&](int& i) { arg_map["-t"](i); }},
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        std::string cur_arg = argv[i];
+        auto it = arg_map.find(cur_arg);
+        if (it == arg_map.end()) {
+            std::cerr << "Unknown argument: " << cur_arg << ", see --help for info.\n";
+            return 1;
+        }
+        it->second(i);
+    }
+
+    // Naming the copier threads may log errors.
+    Common::Log::Initialize("upload_bench.log");
+    Common::Log::Start();
+
+    Allocation src{max_size};
+    Allocation dst{max_size};
+    VideoCore::StagingCopier copier;
+
+    const auto methods = std::to_array<std::pair<std::string_view, std::function<void(size_t)>>>({
+        {"memcpy", [&](size_t size) { std::memcpy(dst.Data(0), src.Data(8), size); }},
+        {"stream", [&](size_t size) { VideoCore::CopyToStaging(dst.Data(0), src.Data(8), size); }},
+        {"threaded",
+         [&](size_t size) {
+             const VideoCore::StagingCopier::Copy copy{dst.Data(0), src.Data(8), size};
+             copier.Run({&copy, 1});
+         }},
+    });
+
+    int num_mismatches = 0;
+    fmt::print("{:<10} {:>10} {:>10}\n", "method", "size", "GB/s");
+    for (size_t size = 64_KB; size <= max_size; size *= 4) {
+        const size_t iterations = std::max<size_t>(total_bytes / size, 1);
+        for (const auto& [name, copy] : methods) {
+            std::memset(dst.Data(0), 0, size);
+            // Warm up caches and page in the destination before timing.
+            copy(size);
+            if (std::memcmp(dst.Data(0), src.Data(8), size) != 0) {
+                fmt::print("Mismatch: {} {}KB\n", name, size / 1_KB);
+                ++num_mismatches;
+            }
+            const auto start = Clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                copy(size);
+            }
+            const std::chrono::duration<double> elapsed = Clock::now() - start;
+            const double bytes_per_second = double(size) * iterations / elapsed.count();
+            fmt::print("{:<10} {:>8}KB {:>10.2f}\n", name, size / 1_KB, bytes_per_second / 1e9);
+        }
+    }
+    Common::Log::Stop();
+    return num_mismatches == 0 ? 0 : 1;
+}
@@ -1,6 +1,7 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <chrono>
 #include <boost/preprocessor/stringize.hpp>
 
 #include "common/assert.h"
@@ -68,67 +69,52 @@ Liverpool::Liverpool() {
 }
 
 Liverpool::~Liverpool() {
+    // Ring workers may wait on commands executed by the processor, stop them first.
+    for (auto& queue : mapped_queues) {
+        if (queue.worker.joinable()) {
+            queue.worker.request_stop();
+            queue.worker_idle.Wake();
+            queue.worker.join();
+        }
+    }
     process_thread.request_stop();
+    processor_idle.Wake();
     process_thread.join();
 }
 
 void Liverpool::Process(std::stop_token stoken) {
     Common::SetCurrentThreadName("shadPS4:GpuCommandProcessor");
+    auto& queue = mapped_queues[GfxQueueId];
 
     while (!stoken.stop_requested()) {
-        {
-            std::unique_lock lk{submit_mutex};
-            Common::CondvarWait(submit_cv, lk, stoken,
-                                [this] { return num_commands || num_submits || submit_done; });
-        }
+        processor_idle.Wait(stoken, [&] {
+            return !command_queue.Empty() || !queue.submits.Empty() || submit_done;
+        });
         if (stoken.stop_requested()) {
             break;
         }
 
         VideoCore::StartCapture();
 
-        curr_qid = -1;
-
-        while (num_submits || num_commands) {
-
+        Task::Handle task{};
+        while (true) {
             // Process incoming commands with high priority
-            while (num_commands) {
-
-                Common::UniqueFunction<void> callback{};
-                {
-                    std::unique_lock lk{submit_mutex};
-                    callback = std::move(command_queue.back());
-                    command_queue.pop();
-                }
-
+            Common::UniqueFunction<void> callback{};
+            while (command_queue.TryPop(callback)) {
                 callback();
-
-                --num_commands;
             }
 
-            curr_qid = (curr_qid + 1) % num_mapped_queues;
-
-            auto& queue = mapped_queues[curr_qid];
-
-            Task::Handle task{};
-            {
-                std::scoped_lock lock{queue.m_access};
-                if (queue.submits.empty()) {
-                    continue;
-                }
-                task = queue.submits.front();
+            if (!task && !queue.submits.TryPop(task)) {
+                break;
             }
+            curr_qid = GfxQueueId;
             task.resume();
 
             if (task.done()) {
                 task.destroy();
-
-                std::scoped_lock lock{queue.m_access};
-                queue.submits.pop();
-
-                --num_submits;
-                std::scoped_lock lock2{submit_mutex};
-                submit_cv.notify_all();
+                task = {};
+                --num_gfx_submits;
+                FinishSubmit();
             }
         }
 
@@ -141,10 +127,77 @@ void Liverpool::Process(std::stop_token stoken) {
             submit_done = false;
         }
 
-        Platform::IrqC::Instance()->Signal(Platform::InterruptId::GpuIdle);
+        if (num_submits == 0) {
+            Platform::IrqC::Instance()->Signal(Platform::InterruptId::GpuIdle);
+        }
+    }
+}
+
+/// Longest sleep of a ring worker between polls of a guest memory wait.
+static constexpr std::chrono::microseconds MaxRingPollInterval{100};
+
+void Liverpool::ProcessRing(u32 qid, std::stop_token stoken) {
+    Common::SetCurrentThreadName(fmt::format("shadPS4:AscRing{}", qid - 1).c_str());
+    auto& queue = mapped_queues[qid];
+
+    while (!stoken.stop_requested()) {
+        Task::Handle task{};
+        queue.worker_idle.Wait(stoken, [&queue] { return !queue.submits.Empty(); });
+        if (stoken.stop_requested() || !queue.submits.TryPop(task)) {
+            continue;
+        }
+
+        // A suspended task waits either for its forwarded commands to retire, which the command
+        // processor signals, or on guest memory, which is polled with a growing sleep.
+        std::chrono::microseconds poll_interval{};
+        task.resume();
+        while (!task.done()) {
+            if (queue.pending_commands != 0) {
+                queue.worker_idle.Wait(stoken, [&queue] { return queue.pending_commands == 0; });
+                poll_interval = {};
+            } else if (poll_interval.count() == 0) {
+                std::this_thread::yield();
+                poll_interval = std::chrono::microseconds{1};
+            } else {
+                std::this_thread::sleep_for(poll_interval);
+                poll_interval = std::min(poll_interval * 2, MaxRingPollInterval);
+            }
+            if (stoken.stop_requested()) {
+                break;
+            }
+            task.resume();
+        }
+        // The frame of a task interrupted by shutdown is released here as well.
+        const bool finished = task.done();
+        task.destroy();
+        if (!finished) {
+            break;
+        }
+
+        FinishSubmit();
+        if (num_submits == 0) {
+            Platform::IrqC::Instance()->Signal(Platform::InterruptId::GpuIdle);
+        }
+    }
+}
+
+void Liverpool::FinishSubmit() {
+    // Waiters in WaitGpuIdle only care about the transition to idle.
+    if (--num_submits == 0) {
+        num_submits.notify_all();
     }
 }
 
+void Liverpool::SendRingCommand(GpuQueue& ring, Common::UniqueFunction<void>&& func) {
+    ++ring.pending_commands;
+    SendCommand([&ring, func = std::move(func)] {
+        func();
+        if (--ring.pending_commands == 0) {
+            ring.worker_idle.Wake();
+        }
+    });
+}
+
 Liverpool::Task Liverpool::ProcessCeUpdate(std::span<const u32> ccb) {
     FIBER_ENTER(ccb_task_name);
 
@@ -209,6 +262,49 @@ Liverpool::Task Liverpool::ProcessCeUpdate(std::span<const u32> ccb) {
     FIBER_EXIT;
 }
 
+void Liverpool::MarkContextRegsDirty(u32 reg_addr, u32 num_regs) {
+    struct StateRegs {
+        u32 begin;
+        u32 end;
+        DirtyState state;
+    };
+#define STATE_REGS(field, state)                                                                   \
+    StateRegs {                                                                                    \
+        offsetof(Regs, field) / sizeof(u32),                                                       \
+            (offsetof(Regs, field) + sizeof(Regs::field) + sizeof(u32) - 1) / sizeof(u32),         \
+            DirtyState::state                                                                      \
+    }
+    static constexpr std::array state_regs = {
+        STATE_REGS(screen_scissor, Viewports),
+        STATE_REGS(window_offset, Viewports),
+        STATE_REGS(window_scissor, Viewports),
+        STATE_REGS(generic_scissor, Viewports),
+        STATE_REGS(viewport_scissors, Viewports),
+        STATE_REGS(viewport_depths, Viewports),
+        STATE_REGS(viewports, Viewports),
+        STATE_REGS(viewport_control, Viewports),
+        STATE_REGS(clipper_control, Viewports),
+        STATE_REGS(mode_control, Viewports),
+        STATE_REGS(blend_constants, BlendConstants),
+        STATE_REGS(depth_bounds_min, DepthBounds),
+        STATE_REGS(depth_bounds_max, DepthBounds),
+        STATE_REGS(depth_control, DepthBounds),
+        STATE_REGS(polygon_control, DepthBias),
+        STATE_REGS(poly_offset, DepthBias),
+        STATE_REGS(depth_control, Stencil),
+        STATE_REGS(stencil_control, Stencil),
+        STATE_REGS(stencil_ref_front, Stencil),
+        STATE_REGS(stencil_ref_back, Stencil),
+    };
+#undef STATE_REGS
+    const u32 reg_end = reg_addr + num_regs;
+    for (const StateRegs& regs_range : state_regs) {
+        if (reg_addr < regs_range.end && regs_range.begin < reg_end) {
+            dirty_state |= regs_range.state;
+        }
+    }
+}
+
 Liverpool::Task Liverpool::ProcessGraphics(std::span<const u32> dcb, std::span<const u32> ccb) {
     FIBER_ENTER(dcb_task_name);
 
@@ -291,6 +387,7 @@ Liverpool::Task Liverpool::ProcessGraphics(std::span<const u32> dcb, std::span<c
             }
             case PM4ItOpcode::ClearState: {
                 regs.SetDefaults();
+                dirty_state = DirtyState::All;
                 break;
             }
             case PM4ItOpcode::SetConfigReg: {
@@ -306,6 +403,7 @@ Liverpool::Task Liverpool::ProcessGraphics(std::span<const u32> dcb, std::span<c
                 const auto* payload = reinterpret_cast<const u32*>(header + 2);
 
                 std::memcpy(&regs.reg_array[reg_addr], payload, (count - 1) * sizeof(u32));
+                MarkContextRegsDirty(reg_addr, count - 1);
 
                 // In the case of HW, render target memory has alignment as color block operates on
                 // tiles. There is no information of actual resource extents stored in CB context
@@ -660,7 +758,7 @@ Liverpool::Task Liverpool::ProcessGraphics(std::span<const u32> dcb, std::span<c
                 // instead and allow other tasks to run.
                 const u64* wait_addr = wait_reg_mem->Address<u64*>();
                 if (vo_port->IsVoLabel(wait_addr) &&
-                    num_submits == mapped_queues[GfxQueueId].submits.size()) {
+                    num_submits == num_gfx_submits) {
                     vo_port->WaitVoLabel([&] { return wait_reg_mem->Test(); });
                 }
                 while (!wait_reg_mem->Test()) {
@@ -717,6 +815,7 @@ template <bool is_indirect>
 Liverpool::Task Liverpool::ProcessCompute(std::span<const u32> acb, u32 vqid) {
     FIBER_ENTER(acb_task_name[vqid]);
     const auto& queue = asc_queues[{vqid}];
+    auto& ring = mapped_queues[vqid + 1];
 
     auto base_addr = reinterpret_cast<uintptr_t>(acb.data());
     while (!acb.empty()) {
@@ -752,28 +851,28 @@ Liverpool::Task Liverpool::ProcessCompute(std::span<const u32> acb, u32 vqid) {
             if (dma_data->dst_addr_lo == 0x3022C || !rasterizer) {
                 break;
             }
-            if (dma_data->src_sel == DmaDataSrc::Data && dma_data->dst_sel == DmaDataDst::Gds) {
-                rasterizer->InlineData(dma_data->dst_addr_lo, &dma_data->data, sizeof(u32), true);
-            } else if (dma_data->src_sel == DmaDataSrc::Memory &&
-                       dma_data->dst_sel == DmaDataDst::Gds) {
-                rasterizer->InlineData(dma_data->dst_addr_lo, dma_data->SrcAddress<const void*>(),
-                                       dma_data->NumBytes(), true);
-            } else if (dma_data->src_sel == DmaDataSrc::Data &&
-                       dma_data->dst_sel == DmaDataDst::Memory) {
-                rasterizer->InlineData(dma_data->DstAddress<VAddr>(), &dma_data->data, sizeof(u32),
-                                       false);
-            } else if (dma_data->src_sel == DmaDataSrc::Gds &&
-                       dma_data->dst_sel == DmaDataDst::Memory) {
-                // LOG_WARNING(Render_Vulkan, "GDS memory read");
-            } else if (dma_data->src_sel == DmaDataSrc::Memory &&
-                       dma_data->dst_sel == DmaDataDst::Memory) {
-                rasterizer->InlineData(dma_data->DstAddress<VAddr>(),
-                                       dma_data->SrcAddress<const void*>(), dma_data->NumBytes(),
-                                       false);
-            } else {
-                UNREACHABLE_MSG("WriteData src_sel = {}, dst_sel = {}",
-                                u32(dma_data->src_sel.Value()), u32(dma_data->dst_sel.Value()));
-            }
+            // The packet is copied as the ring space may be reused before the command runs.
+            SendRingCommand(ring, [this, dma = *dma_data] {
+                if (dma.src_sel == DmaDataSrc::Data && dma.dst_sel == DmaDataDst::Gds) {
+                    rasterizer->InlineData(dma.dst_addr_lo, &dma.data, sizeof(u32), true);
+                } else if (dma.src_sel == DmaDataSrc::Memory && dma.dst_sel == DmaDataDst::Gds) {
+                    rasterizer->InlineData(dma.dst_addr_lo, dma.SrcAddress<const void*>(),
+                                           dma.NumBytes(), true);
+                } else if (dma.src_sel == DmaDataSrc::Data &&
+                           dma.dst_sel == DmaDataDst::Memory) {
+                    rasterizer->InlineData(dma.DstAddress<VAddr>(), &dma.data, sizeof(u32),
+                                           false);
+                } else if (dma.src_sel == DmaDataSrc::Gds && dma.dst_sel == DmaDataDst::Memory) {
+                    // LOG_WARNING(Render_Vulkan, "GDS memory read");
+                } else if (dma.src_sel == DmaDataSrc::Memory &&
+                           dma.dst_sel == DmaDataDst::Memory) {
+                    rasterizer->InlineData(dma.DstAddress<VAddr>(), dma.SrcAddress<const void*>(),
+                                           dma.NumBytes(), false);
+                } else {
+                    UNREACHABLE_MSG("WriteData src_sel = {}, dst_sel = {}",
+                                    u32(dma.src_sel.Value()), u32(dma.dst_sel.Value()));
+                }
+            });
             break;
         }
         case PM4ItOpcode::AcquireMem: {
@@ -793,18 +892,23 @@ Liverpool::Task Liverpool::ProcessCompute(std::span<const u32> acb, u32 vqid) {
             if (set_data->reg_offset >= 0x200 &&
                 set_data->reg_offset <= (0x200 + sizeof(ComputeProgram) / 4)) {
                 ASSERT(set_size <= sizeof(ComputeProgram));
-                auto* addr = reinterpret_cast<u32*>(&mapped_queues[vqid + 1].cs_state) +
+                auto* addr = reinterpret_cast<u32*>(&ring.cs_pending) +
                              (set_data->reg_offset - 0x200);
                 std::memcpy(addr, header + 2, set_size);
             } else {
-                std::memcpy(&regs.reg_array[ShRegWordOffset + set_data->reg_offset], header + 2,
-                            set_size);
+                // Registers outside of the compute program are shared with the graphics ring.
+                const auto* data = reinterpret_cast<const u32*>(header + 2);
+                SendRingCommand(ring, [this, reg_offset = set_data->reg_offset,
+                                       values = std::vector<u32>(data, data + count - 1)] {
+                    std::memcpy(&regs.reg_array[ShRegWordOffset + reg_offset], values.data(),
+                                values.size() * sizeof(u32));
+                });
             }
             break;
         }
         case PM4ItOpcode::DispatchDirect: {
             const auto* dispatch_direct = reinterpret_cast<const PM4CmdDispatchDirect*>(header);
-            auto& cs_program = GetCsRegs();
+            auto& cs_program = ring.cs_pending;
             cs_program.dim_x = dispatch_direct->dim_x;
             cs_program.dim_y = dispatch_direct->dim_y;
             cs_program.dim_z = dispatch_direct->dim_z;
@@ -815,16 +919,20 @@ Liverpool::Task Liverpool::ProcessCompute(std::span<const u32> acb, u32 vqid) {
             }
             if (rasterizer && (cs_program.dispatch_initiator & 1)) {
                 const auto cmd_address = reinterpret_cast<const void*>(header);
-                rasterizer->ScopeMarkerBegin(
-                    fmt::format("acb[{}]:{}:DispatchIndirect", vqid, cmd_address));
-                rasterizer->DispatchDirect();
-                rasterizer->ScopeMarkerEnd();
+                SendRingCommand(ring, [this, vqid, cmd_address, cs_program] {
+                    curr_qid = vqid + 1;
+                    mapped_queues[curr_qid].cs_state = cs_program;
+                    rasterizer->ScopeMarkerBegin(
+                        fmt::format("acb[{}]:{}:DispatchIndirect", vqid, cmd_address));
+                    rasterizer->DispatchDirect();
+                    rasterizer->ScopeMarkerEnd();
+                });
             }
             break;
         }
         case PM4ItOpcode::DispatchIndirect: {
             const auto* dispatch_indirect = reinterpret_cast<const PM4CmdDispatchIndirect*>(header);
-            auto& cs_program = GetCsRegs();
+            const auto& cs_program = ring.cs_pending;
             const auto offset = dispatch_indirect->data_offset;
             const auto ib_address = mapped_queues[vqid].indirect_args_addr;
             const auto size = sizeof(PM4CmdDispatchIndirect::GroupDimensions);
@@ -834,9 +942,15 @@ Liverpool::Task Liverpool::ProcessCompute(std::span<const u32> acb, u32 vqid) {
             }
             if (rasterizer && (cs_program.dispatch_initiator & 1)) {
                 const auto cmd_address = reinterpret_cast<const void*>(header);
-                rasterizer->ScopeMarkerBegin(fmt::format("acb[{}]:{}:Dispatch", vqid, cmd_address));
-                rasterizer->DispatchIndirect(ib_address, offset, size);
-                rasterizer->ScopeMarkerEnd();
+                SendRingCommand(ring, [this, vqid, cmd_address, cs_program, ib_address, offset,
+                                       size] {
+                    curr_qid = vqid + 1;
+                    mapped_queues[curr_qid].cs_state = cs_program;
+                    rasterizer->ScopeMarkerBegin(
+                        fmt::format("acb[{}]:{}:Dispatch", vqid, cmd_address));
+                    rasterizer->DispatchIndirect(ib_address, offset, size);
+                    rasterizer->ScopeMarkerEnd();
+                });
             }
             break;
         }
@@ -845,7 +959,12 @@ Liverpool::Task Liverpool::ProcessCompute(std::span<const u32> acb, u32 vqid) {
             ASSERT(write_data->dst_sel.Value() == 2 || write_data->dst_sel.Value() == 5);
             const u32 data_size = (header->type3.count.Value() - 2) * 4;
             if (!write_data->wr_one_addr.Value()) {
-                std::memcpy(write_data->Address<void*>(), write_data->data, data_size);
+                // Keep the write ordered with dispatches that may read the same memory.
+                const u32* data = write_data->data;
+                SendRingCommand(ring, [address = write_data->Address<void*>(),
+                                       values = std::vector<u32>(data, data + data_size / 4)] {
+                    std::memcpy(address, values.data(), values.size() * sizeof(u32));
+                });
             } else {
                 UNREACHABLE();
             }
@@ -854,6 +973,9 @@ Liverpool::Task Liverpool::ProcessCompute(std::span<const u32> acb, u32 vqid) {
         case PM4ItOpcode::WaitRegMem: {
             const auto* wait_reg_mem = reinterpret_cast<const PM4CmdWaitRegMem*>(header);
             ASSERT(wait_reg_mem->engine.Value() == PM4CmdWaitRegMem::Engine::Me);
+            while (ring.pending_commands) {
+                YIELD_ASC(vqid);
+            }
             while (!wait_reg_mem->Test()) {
                 YIELD_ASC(vqid);
             }
@@ -861,11 +983,17 @@ Liverpool::Task Liverpool::ProcessCompute(std::span<const u32> acb, u32 vqid) {
         }
         case PM4ItOpcode::ReleaseMem: {
             const auto* release_mem = reinterpret_cast<const PM4CmdReleaseMem*>(header);
+            while (ring.pending_commands) {
+                YIELD_ASC(vqid);
+            }
             release_mem->SignalFence(static_cast<Platform::InterruptId>(queue.pipe_id));
             break;
         }
         case PM4ItOpcode::EventWrite: {
             // const auto* event = reinterpret_cast<const PM4CmdEventWrite*>(header);
+            while (ring.pending_commands) {
+                YIELD_ASC(vqid);
+            }
             break;
         }
         default:
@@ -882,12 +1010,20 @@ Liverpool::Task Liverpool::ProcessCompute(std::span<const u32> acb, u32 vqid) {
         }
     }
 
+    if constexpr (!is_indirect) {
+        // The submission only counts as done once the processor has executed all its commands.
+        while (ring.pending_commands) {
+            YIELD_ASC(vqid);
+        }
+    }
+
     FIBER_EXIT;
 }
 
 std::pair<std::span<const u32>, std::span<const u32>> Liverpool::CopyCmdBuffers(
     std::span<const u32> dcb, std::span<const u32> ccb) {
     auto& queue = mapped_queues[GfxQueueId];
+    std::scoped_lock lk{queue.copy_buffer_mutex};
 
     // std::vector resize can invalidate spans for commands in flight
     ASSERT_MSG(queue.dcb_buffer.capacity() >= queue.dcb_buffer_offset + dcb.size(),
@@ -929,14 +1065,10 @@ void Liverpool::SubmitGfx(std::span<const u32> dcb, std::span<const u32> ccb) {
     }
 
     auto task = ProcessGraphics(dcb, ccb);
-    {
-        std::scoped_lock lock{queue.m_access};
-        queue.submits.emplace(task.handle);
-    }
-
-    std::scoped_lock lk{submit_mutex};
+    ++num_gfx_submits;
     ++num_submits;
-    submit_cv.notify_one();
+    queue.submits.EmplaceWait(task.handle);
+    processor_idle.Wake();
 }
 
 void Liverpool::SubmitAsc(u32 gnm_vqid, std::span<const u32> acb) {
@@ -945,15 +1077,12 @@ void Liverpool::SubmitAsc(u32 gnm_vqid, std::span<const u32> acb) {
 
     const auto vqid = gnm_vqid - 1;
     const auto& task = ProcessCompute(acb, vqid);
-    {
-        std::scoped_lock lock{queue.m_access};
-        queue.submits.emplace(task.handle);
-    }
-
-    std::scoped_lock lk{submit_mutex};
-    num_mapped_queues = std::max(num_mapped_queues, gnm_vqid + 1);
     ++num_submits;
-    submit_cv.notify_one();
+    queue.submits.EmplaceWait(task.handle);
+    std::call_once(queue.worker_started, [&] {
+        queue.worker = std::jthread{std::bind_front(&Liverpool::ProcessRing, this, gnm_vqid)};
+    });
+    queue.worker_idle.Wake();
 }
 
 } // namespace AmdGpu
@@ -4,17 +4,17 @@
 #pragma once
 
 #include <array>
-#include <condition_variable>
 #include <coroutine>
 #include <exception>
 #include <mutex>
 #include <span>
 #include <thread>
 #include <vector>
-#include <queue>
 
 #include "common/assert.h"
 #include "common/bit_field.h"
+#include "common/bounded_threadsafe_queue.h"
+#include "common/enum.h"
 #include "common/polyfill_thread.h"
 #include "common/slot_vector.h"
 #include "common/types.h"
@@ -1369,6 +1369,19 @@ struct Liverpool {
     std::array<CbDbExtent, NumColorBuffers> last_cb_extent{};
     CbDbExtent last_db_extent{};
 
+    /// Groups of context registers the rasterizer records as dynamic state. Writes to them are
+    /// tracked so the state is only recomputed after it could have changed.
+    enum class DirtyState : u32 {
+        None = 0,
+        Viewports = 1 << 0,
+        BlendConstants = 1 << 1,
+        DepthBounds = 1 << 2,
+        DepthBias = 1 << 3,
+        Stencil = 1 << 4,
+        All = (1 << 5) - 1,
+    };
+    DirtyState dirty_state{DirtyState::All};
+
 public:
     Liverpool();
     ~Liverpool();
@@ -1377,16 +1390,17 @@ public:
     void SubmitAsc(u32 gnm_vqid, std::span<const u32> acb);
 
     void SubmitDone() noexcept {
-        std::scoped_lock lk{submit_mutex};
         mapped_queues[GfxQueueId].ccb_buffer_offset = 0;
         mapped_queues[GfxQueueId].dcb_buffer_offset = 0;
         submit_done = true;
-        submit_cv.notify_one();
+        processor_idle.Wake();
     }
 
     void WaitGpuIdle() noexcept {
-        std::unique_lock lk{submit_mutex};
-        submit_cv.wait(lk, [this] { return num_submits == 0; });
+        // Only the transition to zero is notified.
+        for (u32 count = num_submits.load(); count != 0; count = num_submits.load()) {
+            num_submits.wait(count);
+        }
     }
 
     bool IsGpuIdle() const {
@@ -1402,15 +1416,13 @@ public:
     }
 
     void SendCommand(Common::UniqueFunction<void>&& func) {
-        std::scoped_lock lk{submit_mutex};
-        command_queue.emplace(std::move(func));
-        ++num_commands;
-        submit_cv.notify_one();
+        command_queue.EmplaceWait(std::move(func));
+        processor_idle.Wake();
     }
 
     void reserveCopyBufferSpace() {
         GpuQueue& gfx_queue = mapped_queues[GfxQueueId];
-        std::scoped_lock<std::mutex> lk(gfx_queue.m_access);
+        std::scoped_lock lk{gfx_queue.copy_buffer_mutex};
 
         constexpr size_t GfxReservedSize = 2_MB >> 2;
         gfx_queue.ccb_buffer.reserve(GfxReservedSize);
@@ -1465,24 +1477,69 @@ private:
     std::pair<std::span<const u32>, std::span<const u32>> CopyCmdBuffers(std::span<const u32> dcb,
                                                                          std::span<const u32> ccb);
     Task ProcessGraphics(std::span<const u32> dcb, std::span<const u32> ccb);
+    void MarkContextRegsDirty(u32 reg_addr, u32 num_regs);
     Task ProcessCeUpdate(std::span<const u32> ccb);
     template <bool is_indirect = false>
     Task ProcessCompute(std::span<const u32> acb, u32 vqid);
 
-    void Process(std::stop_token stoken);
+    /**
+     * Lets a consumer thread sleep on a futex once it runs out of work. Producers only pay for
+     * an atomic exchange unless the consumer is actually asleep.
+     */
+    struct IdleWaiter {
+        template <typename Pred>
+        void Wait(std::stop_token stoken, Pred&& has_work) {
+            while (!has_work() && !stoken.stop_requested()) {
+                sleeping.store(true);
+                std::atomic_thread_fence(std::memory_order::seq_cst);
+                // Recheck after announcing, a producer may have missed the flag.
+                if (has_work() || stoken.stop_requested()) {
+                    sleeping.store(false);
+                    break;
+                }
+                sleeping.wait(true);
+            }
+        }
 
+        void Wake() {
+            std::atomic_thread_fence(std::memory_order::seq_cst);
+            if (sleeping.exchange(false)) {
+                sleeping.notify_one();
+            }
+        }
+
+        std::atomic<bool> sleeping{};
+    };
+
+    void Process(std::stop_token stoken);
+    void ProcessRing(u32 qid, std::stop_token stoken);
+    void FinishSubmit();
+
+    /**
+     * Each ASC ring is parsed on its own worker thread. Packets that touch the rasterizer or
+     * memory it may read are forwarded to the command processor in ring order, while register
+     * writes and waits stay on the worker. The ring only synchronizes with the command
+     * processor at WaitRegMem, ReleaseMem and EventWrite packets and at the end of a submission.
+     */
     struct GpuQueue {
-        std::mutex m_access{};
+        /// Guards dcb_buffer and ccb_buffer, reserving space reallocates them.
+        std::mutex copy_buffer_mutex{};
         std::atomic<u32> dcb_buffer_offset;
         std::atomic<u32> ccb_buffer_offset;
         std::vector<u32> dcb_buffer;
         std::vector<u32> ccb_buffer;
-        std::queue<Task::Handle> submits{};
+        Common::LockFreeMPSCQueue<Task::Handle, 256> submits{};
         ComputeProgram cs_state{};
+        ComputeProgram cs_pending{}; ///< Registers written by the ring worker
         VAddr indirect_args_addr{};
+        std::atomic<u32> pending_commands{};
+        IdleWaiter worker_idle{};
+        std::once_flag worker_started{};
+        std::jthread worker{};
     };
     std::array<GpuQueue, NumTotalQueues> mapped_queues{};
-    u32 num_mapped_queues{1u}; // GFX is always available
+
+    void SendRingCommand(GpuQueue& ring, Common::UniqueFunction<void>&& func);
 
     struct ConstantEngine {
         void Reset() {
@@ -1506,14 +1563,15 @@ private:
     Libraries::VideoOut::VideoOutPort* vo_port{};
     std::jthread process_thread{};
     std::atomic<u32> num_submits{};
-    std::atomic<u32> num_commands{};
+    std::atomic<u32> num_gfx_submits{};
     std::atomic<bool> submit_done{};
-    std::mutex submit_mutex;
-    std::condition_variable_any submit_cv;
-    std::queue<Common::UniqueFunction<void>> command_queue{};
+    IdleWaiter processor_idle{};
+    Common::LockFreeMPSCQueue<Common::UniqueFunction<void>> command_queue{};
     int curr_qid{-1};
 };
 
+DECLARE_ENUM_FLAG_OPERATORS(Liverpool::DirtyState)
+
 static_assert(GFX6_3D_REG_INDEX(ps_program) == 0x2C08);
 static_assert(GFX6_3D_REG_INDEX(vs_program) == 0x2C48);
 static_assert(GFX6_3D_REG_INDEX(vs_program.user_data) == 0x2C4C);
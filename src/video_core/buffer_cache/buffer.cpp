@@ -197,6 +197,13 @@ void StreamBuffer::Commit() {
     watch.tick = scheduler->CurrentTick();
 }
 
+void StreamBuffer::InvalidateRange(u64 range_offset, u64 range_size) {
+    if (!is_coherent) {
+        vmaInvalidateAllocation(instance->GetAllocator(), buffer.allocation, range_offset,
+                                range_size);
+    }
+}
+
 void StreamBuffer::ReserveWatches(std::vector<Watch>& watches, std::size_t grow_size) {
     watches.resize(watches.size() + grow_size);
 }
@@ -9,6 +9,7 @@
 #include <vector>
 #include "common/types.h"
 #include "video_core/amdgpu/resource.h"
+#include "video_core/buffer_cache/staging_copy.h"
 #include "video_core/renderer_vulkan/vk_common.h"
 
 namespace Vulkan {
@@ -144,6 +145,7 @@ public:
     bool is_coherent{};
     bool is_deleted{};
     int stream_score = 0;
+    size_t lru_id{};
     size_t size_bytes = 0;
     std::span<u8> mapped_data;
     const Vulkan::Instance* instance;
@@ -165,10 +167,13 @@ public:
     /// Ensures that reserved bytes of memory are available to the GPU.
     void Commit();
 
+    /// Makes GPU writes to a committed region of a download buffer visible to the host.
+    void InvalidateRange(u64 range_offset, u64 range_size);
+
     /// Maps and commits a memory region with user provided data
     u64 Copy(VAddr src, size_t size, size_t alignment = 0) {
         const auto [data, offset] = Map(size, alignment);
-        std::memcpy(data, reinterpret_cast<const void*>(src), size);
+        CopyToStaging(data, reinterpret_cast<const u8*>(src), size);
         Commit();
         return offset;
     }
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include <algorithm>
+#include <thread>
 #include "common/alignment.h"
 #include "common/scope_exit.h"
 #include "common/types.h"
@@ -19,7 +20,11 @@ namespace VideoCore {
 static constexpr size_t NumVertexBuffers = 32;
 static constexpr size_t GdsBufferSize = 64_KB;
 static constexpr size_t StagingBufferSize = 1_GB;
+static constexpr u64 MaxUploadBatchSize = StagingBufferSize / 4;
 static constexpr size_t UboStreamBufferSize = 64_MB;
+static constexpr size_t DownloadBufferSize = 128_MB;
+static constexpr u64 NumFramesBeforeRemoval = 32;
+static constexpr u64 MaxPageWalkSize = 256_KB;
 
 BufferCache::BufferCache(const Vulkan::Instance& instance_, Vulkan::Scheduler& scheduler_,
                          AmdGpu::Liverpool* liverpool_, TextureCache& texture_cache_,
@@ -29,6 +34,7 @@ BufferCache::BufferCache(const Vulkan::Instance& instance_, Vulkan::Scheduler& s
       staging_buffer{instance, scheduler, MemoryUsage::Upload, StagingBufferSize},
       stream_buffer{instance, scheduler, MemoryUsage::Stream, UboStreamBufferSize},
       gds_buffer{instance, scheduler, MemoryUsage::Stream, 0, AllFlags, GdsBufferSize},
+      download_buffer{instance, scheduler, MemoryUsage::Download, DownloadBufferSize},
       memory_tracker{&tracker} {
     Vulkan::SetObjectName(instance.GetDevice(), gds_buffer.Handle(), "GDS Buffer");
 
@@ -63,40 +69,133 @@ void BufferCache::InvalidateMemory(VAddr device_addr, u64 size) {
 
 void BufferCache::DownloadBufferMemory(Buffer& buffer, VAddr device_addr, u64 size) {
     boost::container::small_vector<vk::BufferCopy, 1> copies;
-    u64 total_size_bytes = 0;
     memory_tracker.ForEachDownloadRange<true>(
         device_addr, size, [&](u64 device_addr_out, u64 range_size) {
             const VAddr buffer_addr = buffer.CpuAddr();
             const auto add_download = [&](VAddr start, VAddr end) {
-                const u64 new_offset = start - buffer_addr;
-                const u64 new_size = end - start;
                 copies.push_back(vk::BufferCopy{
-                    .srcOffset = new_offset,
-                    .dstOffset = total_size_bytes,
-                    .size = new_size,
+                    .srcOffset = start - buffer_addr,
+                    .size = end - start,
                 });
-                total_size_bytes += new_size;
             };
             gpu_modified_ranges.ForEachInRange(device_addr_out, range_size, add_download);
             gpu_modified_ranges.Subtract(device_addr_out, range_size);
         });
-    if (total_size_bytes == 0) {
+    if (copies.empty()) {
         return;
     }
-    const auto [staging, offset] = staging_buffer.Map(total_size_bytes);
-    for (auto& copy : copies) {
-        // Modify copies to have the staging offset in mind
-        copy.dstOffset += offset;
-    }
-    staging_buffer.Commit();
     scheduler.EndRendering();
-    const auto cmdbuf = scheduler.CommandBuffer();
-    cmdbuf.copyBuffer(buffer.buffer, staging_buffer.Handle(), copies);
-    scheduler.Finish();
     for (const auto& copy : copies) {
-        const VAddr copy_device_addr = buffer.CpuAddr() + copy.srcOffset;
-        const u64 dst_offset = copy.dstOffset - offset;
-        std::memcpy(std::bit_cast<u8*>(copy_device_addr), staging + dst_offset, copy.size);
+        // Ranges larger than the download buffer are read back in pieces.
+        for (u64 done = 0; done < copy.size;) {
+            const u64 piece_size = std::min<u64>(copy.size - done, DownloadBufferSize);
+            if (piece_size > download_buffer.GetFreeSize()) {
+                // Mapping wraps around the download buffer, write back everything still in it.
+                scheduler.Finish();
+                ResolveCompletedReadbacks();
+                while (num_writing_readbacks.load() != 0) {
+                    std::this_thread::yield();
+                }
+            }
+            const auto [data, offset] = download_buffer.Map(piece_size);
+            download_buffer.Commit();
+            const auto cmdbuf = scheduler.CommandBuffer();
+            cmdbuf.copyBuffer(buffer.buffer, download_buffer.Handle(),
+                              vk::BufferCopy{
+                                  .srcOffset = copy.srcOffset + done,
+                                  .dstOffset = offset,
+                                  .size = piece_size,
+                              });
+            const VAddr piece_addr = buffer.CpuAddr() + copy.srcOffset + done;
+            tracker.UpdatePagesCachedCount(piece_addr, piece_size, 1);
+            {
+                std::scoped_lock lk{readback_mutex};
+                pending_readbacks.push_back({scheduler.CurrentTick(), piece_addr, piece_size,
+                                             offset});
+                num_pending_readbacks = pending_readbacks.size();
+            }
+            done += piece_size;
+        }
+    }
+    // Catch guest writes to the pages right away, they have to land after the readback.
+    tracker.FlushProtections();
+}
+
+void BufferCache::ResolveReadbacks(VAddr device_addr, u64 size) {
+    if (num_pending_readbacks.load() == 0) {
+        return;
+    }
+    // Pages are write protected as a whole, so whole pages are written back.
+    const VAddr begin = Common::AlignDown(device_addr, CACHING_PAGESIZE);
+    const VAddr end = Common::AlignUp(device_addr + size, CACHING_PAGESIZE);
+    const auto overlaps = [&](const PendingReadback& readback) {
+        return readback.device_addr < end && begin < readback.device_addr + readback.size;
+    };
+    boost::container::small_vector<PendingReadback, 4> resolved;
+    {
+        std::scoped_lock lk{readback_mutex};
+        if (std::ranges::none_of(pending_readbacks, overlaps)) {
+            return;
+        }
+        std::vector<PendingReadback> remaining;
+        for (const PendingReadback& readback : pending_readbacks) {
+            if (!overlaps(readback)) {
+                remaining.push_back(readback);
+                continue;
+            }
+            // Split at page boundaries, parts outside of the range stay pending.
+            const VAddr readback_end = readback.device_addr + readback.size;
+            const VAddr resolve_begin = std::max(begin, readback.device_addr);
+            const VAddr resolve_end = std::min(end, readback_end);
+            if (readback.device_addr < resolve_begin) {
+                remaining.push_back({readback.tick, readback.device_addr,
+                                     resolve_begin - readback.device_addr, readback.offset});
+            }
+            if (resolve_end < readback_end) {
+                remaining.push_back({readback.tick, resolve_end, readback_end - resolve_end,
+                                     readback.offset + (resolve_end - readback.device_addr)});
+            }
+            resolved.push_back({readback.tick, resolve_begin, resolve_end - resolve_begin,
+                                readback.offset + (resolve_begin - readback.device_addr)});
+        }
+        pending_readbacks = std::move(remaining);
+        num_pending_readbacks = pending_readbacks.size();
+        num_writing_readbacks += resolved.size();
+    }
+    WriteReadbacks(resolved);
+}
+
+void BufferCache::ResolveCompletedReadbacks() {
+    if (num_pending_readbacks.load() == 0) {
+        return;
+    }
+    boost::container::small_vector<PendingReadback, 16> completed;
+    {
+        std::scoped_lock lk{readback_mutex};
+        std::erase_if(pending_readbacks, [&](const PendingReadback& readback) {
+            if (!scheduler.IsFree(readback.tick)) {
+                return false;
+            }
+            completed.push_back(readback);
+            return true;
+        });
+        num_pending_readbacks = pending_readbacks.size();
+        num_writing_readbacks += completed.size();
+    }
+    WriteReadbacks(completed);
+}
+
+void BufferCache::WriteReadbacks(std::span<const PendingReadback> readbacks) {
+    for (const PendingReadback& readback : readbacks) {
+        // This may run on the fault handler, so only wait on the semaphore and never submit. The
+        // copies are submitted right after the garbage collector records them.
+        scheduler.GetMasterSemaphore()->Wait(readback.tick);
+        download_buffer.InvalidateRange(readback.offset, readback.size);
+        // Unprotect first so writing back does not fault into the caches again.
+        tracker.UpdatePagesCachedCount(readback.device_addr, readback.size, -1);
+        std::memcpy(std::bit_cast<u8*>(readback.device_addr),
+                    download_buffer.mapped_data.data() + readback.offset, readback.size);
+        --num_writing_readbacks;
     }
 }
 
@@ -303,6 +402,7 @@ std::pair<Buffer*, u32> BufferCache::ObtainBuffer(VAddr device_addr, u32 size, b
     // For small uniform buffers that have not been modified by gpu
     // use device local stream buffer to reduce renderpass breaks.
     static constexpr u64 StreamThreshold = CACHING_PAGESIZE;
+    ResolveReadbacks(device_addr, size);
     const bool is_gpu_dirty = memory_tracker.IsRegionGpuModified(device_addr, size);
     if (!is_written && size <= StreamThreshold && !is_gpu_dirty) {
         const u64 offset = stream_buffer.Copy(device_addr, size, instance.UniformMinAlignment());
@@ -313,6 +413,7 @@ std::pair<Buffer*, u32> BufferCache::ObtainBuffer(VAddr device_addr, u32 size, b
         buffer_id = FindBuffer(device_addr, size);
     }
     Buffer& buffer = slot_buffers[buffer_id];
+    TouchBuffer(buffer);
     SynchronizeBuffer(buffer, device_addr, size, is_texel_buffer);
     if (is_written) {
         memory_tracker.MarkRegionAsGpuModified(device_addr, size);
@@ -322,12 +423,14 @@ std::pair<Buffer*, u32> BufferCache::ObtainBuffer(VAddr device_addr, u32 size, b
 }
 
 std::pair<Buffer*, u32> BufferCache::ObtainViewBuffer(VAddr gpu_addr, u32 size, bool prefer_gpu) {
+    ResolveReadbacks(gpu_addr, size);
     // Check if any buffer contains the full requested range.
     const u64 page = gpu_addr >> CACHING_PAGEBITS;
     const BufferId buffer_id = page_table[page];
     if (buffer_id) {
         Buffer& buffer = slot_buffers[buffer_id];
         if (buffer.IsInBounds(gpu_addr, size)) {
+            TouchBuffer(buffer);
             SynchronizeBuffer(buffer, gpu_addr, size, false);
             return {&buffer, buffer.Offset(gpu_addr)};
         }
@@ -345,6 +448,11 @@ std::pair<Buffer*, u32> BufferCache::ObtainViewBuffer(VAddr gpu_addr, u32 size,
 
 bool BufferCache::IsRegionRegistered(VAddr addr, size_t size) {
     const VAddr end_addr = addr + size;
+    if (size > MaxPageWalkSize) {
+        std::shared_lock lk{mutex};
+        return buffer_index.IsOverlapping(addr, end_addr);
+    }
+    // Small ranges are answered faster by a few page table lookups than by the index.
     const u64 page_end = Common::DivCeil(end_addr, CACHING_PAGESIZE);
     for (u64 page = addr >> CACHING_PAGEBITS; page < page_end;) {
         const BufferId buffer_id = page_table[page];
@@ -381,13 +489,41 @@ BufferId BufferCache::FindBuffer(VAddr device_addr, u32 size) {
     if (!buffer_id) {
         return CreateBuffer(device_addr, size);
     }
-    const Buffer& buffer = slot_buffers[buffer_id];
+    Buffer& buffer = slot_buffers[buffer_id];
     if (buffer.IsInBounds(device_addr, size)) {
+        TouchBuffer(buffer);
         return buffer_id;
     }
     return CreateBuffer(device_addr, size);
 }
 
+u64 BufferCache::RunGarbageCollector(u64 bytes_to_free) {
+    const u64 current_tick = scheduler.CurrentTick();
+    if (current_tick <= NumFramesBeforeRemoval) {
+        return 0;
+    }
+    boost::container::small_vector<BufferId, 32> evicted;
+    u64 bytes_freed = 0;
+    lru_cache.ForEachItemBelow(current_tick - NumFramesBeforeRemoval, [&](BufferId buffer_id) {
+        evicted.push_back(buffer_id);
+        bytes_freed += slot_buffers[buffer_id].SizeBytes();
+        return bytes_freed >= bytes_to_free;
+    });
+    for (const BufferId buffer_id : evicted) {
+        Buffer& buffer = slot_buffers[buffer_id];
+        const VAddr device_addr = buffer.CpuAddr();
+        const u64 size = buffer.SizeBytes();
+        if (memory_tracker.IsRegionGpuModified(device_addr, size)) {
+            DownloadBufferMemory(buffer, device_addr, size);
+        }
+        // Guest memory is the only copy left, a buffer created over this range later must
+        // upload it again.
+        memory_tracker.MarkRegionAsCpuModified(device_addr, size);
+        DeleteBuffer(buffer_id);
+    }
+    return bytes_freed;
+}
+
 BufferCache::OverlapResult BufferCache::ResolveOverlaps(VAddr device_addr, u32 wanted_size) {
     static constexpr int STREAM_LEAP_THRESHOLD = 16;
     boost::container::small_vector<BufferId, 16> overlap_ids;
@@ -399,11 +535,9 @@ BufferCache::OverlapResult BufferCache::ResolveOverlaps(VAddr device_addr, u32 w
         static constexpr VAddr min_page = CACHING_PAGESIZE + DEVICE_PAGESIZE;
         if (add_value > begin - min_page) {
             begin = min_page;
-            device_addr = DEVICE_PAGESIZE;
             return;
         }
         begin -= add_value;
-        device_addr = begin - CACHING_PAGESIZE;
     };
     const auto expand_end = [&](VAddr add_value) {
         static constexpr VAddr max_page = 1ULL << MemoryTracker::MAX_CPU_PAGE_BITS;
@@ -421,12 +555,11 @@ BufferCache::OverlapResult BufferCache::ResolveOverlaps(VAddr device_addr, u32 w
             .has_stream_leap = has_stream_leap,
         };
     }
-    for (; device_addr >> CACHING_PAGEBITS < Common::DivCeil(end, CACHING_PAGESIZE);
-         device_addr += CACHING_PAGESIZE) {
-        const BufferId overlap_id = page_table[device_addr >> CACHING_PAGEBITS];
-        if (!overlap_id) {
-            continue;
-        }
+    // Buffers are visited in address order, end may grow while doing so.
+    auto it = buffer_index.FirstEndingAfter(device_addr);
+    while (it != buffer_index.End() && it->first < end) {
+        const BufferId overlap_id = it->second.id;
+        ++it;
         Buffer& overlap = slot_buffers[overlap_id];
         if (overlap.is_picked) {
             continue;
@@ -450,6 +583,8 @@ BufferCache::OverlapResult BufferCache::ResolveOverlaps(VAddr device_addr, u32 w
             has_stream_leap = true;
             if (expands_right) {
                 expand_begin(CACHING_PAGESIZE * 128);
+                // Look again from the new begin for buffers the expansion now covers.
+                it = buffer_index.FirstEndingAfter(begin);
             }
             if (expands_left) {
                 expand_end(CACHING_PAGESIZE * 128);
@@ -548,13 +683,23 @@ BufferId BufferCache::CreateBuffer(VAddr device_addr, u32 wanted_size) {
 }
 
 void BufferCache::Register(BufferId buffer_id) {
+    Buffer& buffer = slot_buffers[buffer_id];
+    buffer.lru_id = lru_cache.Insert(buffer_id, scheduler.CurrentTick());
+    total_used_memory += buffer.SizeBytes();
     ChangeRegister<true>(buffer_id);
 }
 
 void BufferCache::Unregister(BufferId buffer_id) {
+    Buffer& buffer = slot_buffers[buffer_id];
+    lru_cache.Free(buffer.lru_id);
+    total_used_memory -= buffer.SizeBytes();
     ChangeRegister<false>(buffer_id);
 }
 
+void BufferCache::TouchBuffer(Buffer& buffer) {
+    lru_cache.Touch(buffer.lru_id, scheduler.CurrentTick());
+}
+
 template <bool insert>
 void BufferCache::ChangeRegister(BufferId buffer_id) {
     Buffer& buffer = slot_buffers[buffer_id];
@@ -570,89 +715,105 @@ void BufferCache::ChangeRegister(BufferId buffer_id) {
             page_table[page] = BufferId{};
         }
     }
+    std::scoped_lock lk{mutex};
+    if constexpr (insert) {
+        buffer_index.Insert(device_addr_begin, device_addr_end, buffer_id);
+    } else {
+        buffer_index.Erase(device_addr_begin);
+    }
 }
 
 void BufferCache::SynchronizeBuffer(Buffer& buffer, VAddr device_addr, u32 size,
                                     bool is_texel_buffer) {
     boost::container::small_vector<vk::BufferCopy, 4> copies;
-    u64 total_size_bytes = 0;
     VAddr buffer_start = buffer.CpuAddr();
     memory_tracker.ForEachUploadRange(device_addr, size, [&](u64 device_addr_out, u64 range_size) {
         copies.push_back(vk::BufferCopy{
-            .srcOffset = total_size_bytes,
             .dstOffset = device_addr_out - buffer_start,
             .size = range_size,
         });
-        total_size_bytes += range_size;
     });
     SCOPE_EXIT {
         if (is_texel_buffer) {
             SynchronizeBufferFromImage(buffer, device_addr, size);
         }
     };
-    if (total_size_bytes == 0) {
+    if (copies.empty()) {
         return;
     }
-    vk::Buffer src_buffer = staging_buffer.Handle();
-    if (total_size_bytes < StagingBufferSize) {
-        const auto [staging, offset] = staging_buffer.Map(total_size_bytes);
-        for (auto& copy : copies) {
-            u8* const src_pointer = staging + copy.srcOffset;
-            const VAddr device_addr = buffer.CpuAddr() + copy.dstOffset;
-            std::memcpy(src_pointer, std::bit_cast<const u8*>(device_addr), copy.size);
+    // The upload ranges are tracked again, protect them before reading so CPU writes racing
+    // with the copy are caught.
+    tracker.FlushProtections(device_addr, size);
+    scheduler.EndRendering();
+
+    boost::container::small_vector<vk::BufferCopy, 4> batch;
+    boost::container::small_vector<StagingCopier::Copy, 4> staging_copies;
+    u64 batch_size = 0;
+    const auto upload_batch = [&] {
+        const auto [staging, offset] = staging_buffer.Map(batch_size);
+        for (auto& copy : batch) {
+            const VAddr copy_device_addr = buffer_start + copy.dstOffset;
+            staging_copies.push_back({staging + copy.srcOffset,
+                                      std::bit_cast<const u8*>(copy_device_addr), copy.size});
             // Apply the staging offset
             copy.srcOffset += offset;
         }
+        staging_copier.Run(staging_copies);
         staging_buffer.Commit();
-    } else {
-        // For large one time transfers use a temporary host buffer.
-        // RenderDoc can lag quite a bit if the stream buffer is too large.
-        Buffer temp_buffer{instance,
-                           scheduler,
-                           MemoryUsage::Upload,
-                           0,
-                           vk::BufferUsageFlagBits::eTransferSrc,
-                           total_size_bytes};
-        src_buffer = temp_buffer.Handle();
-        u8* const staging = temp_buffer.mapped_data.data();
-        for (auto& copy : copies) {
-            u8* const src_pointer = staging + copy.srcOffset;
-            const VAddr device_addr = buffer.CpuAddr() + copy.dstOffset;
-            std::memcpy(src_pointer, std::bit_cast<const u8*>(device_addr), copy.size);
+
+        const auto cmdbuf = scheduler.CommandBuffer();
+        const vk::BufferMemoryBarrier2 pre_barrier = {
+            .srcStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+            .srcAccessMask = vk::AccessFlagBits2::eMemoryRead,
+            .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+            .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .buffer = buffer.Handle(),
+            .offset = 0,
+            .size = buffer.SizeBytes(),
+        };
+        const vk::BufferMemoryBarrier2 post_barrier = {
+            .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+            .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+            .dstStageMask = vk::PipelineStageFlagBits2::eAllCommands,
+            .dstAccessMask = vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite,
+            .buffer = buffer.Handle(),
+            .offset = 0,
+            .size = buffer.SizeBytes(),
+        };
+        cmdbuf.pipelineBarrier2(vk::DependencyInfo{
+            .dependencyFlags = vk::DependencyFlagBits::eByRegion,
+            .bufferMemoryBarrierCount = 1,
+            .pBufferMemoryBarriers = &pre_barrier,
+        });
+        cmdbuf.copyBuffer(staging_buffer.Handle(), buffer.buffer, batch);
+        cmdbuf.pipelineBarrier2(vk::DependencyInfo{
+            .dependencyFlags = vk::DependencyFlagBits::eByRegion,
+            .bufferMemoryBarrierCount = 1,
+            .pBufferMemoryBarriers = &post_barrier,
+        });
+        batch.clear();
+        staging_copies.clear();
+        batch_size = 0;
+    };
+    // Uploads larger than a batch go through the staging buffer in several passes.
+    for (const auto& copy : copies) {
+        for (u64 done = 0; done < copy.size;) {
+            const u64 piece_size = std::min(copy.size - done, MaxUploadBatchSize - batch_size);
+            batch.push_back(vk::BufferCopy{
+                .srcOffset = batch_size,
+                .dstOffset = copy.dstOffset + done,
+                .size = piece_size,
+            });
+            batch_size += piece_size;
+            done += piece_size;
+            if (batch_size == MaxUploadBatchSize) {
+                upload_batch();
+            }
         }
-        scheduler.DeferOperation([buffer = std::move(temp_buffer)]() mutable {});
     }
-    scheduler.EndRendering();
-    const auto cmdbuf = scheduler.CommandBuffer();
-    const vk::BufferMemoryBarrier2 pre_barrier = {
-        .srcStageMask = vk::PipelineStageFlagBits2::eAllCommands,
-        .srcAccessMask = vk::AccessFlagBits2::eMemoryRead,
-        .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
-        .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
-        .buffer = buffer.Handle(),
-        .offset = 0,
-        .size = buffer.SizeBytes(),
-    };
-    const vk::BufferMemoryBarrier2 post_barrier = {
-        .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
-        .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
-        .dstStageMask = vk::PipelineStageFlagBits2::eAllCommands,
-        .dstAccessMask = vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite,
-        .buffer = buffer.Handle(),
-        .offset = 0,
-        .size = buffer.SizeBytes(),
-    };
-    cmdbuf.pipelineBarrier2(vk::DependencyInfo{
-        .dependencyFlags = vk::DependencyFlagBits::eByRegion,
-        .bufferMemoryBarrierCount = 1,
-        .pBufferMemoryBarriers = &pre_barrier,
-    });
-    cmdbuf.copyBuffer(src_buffer, buffer.buffer, copies);
-    cmdbuf.pipelineBarrier2(vk::DependencyInfo{
-        .dependencyFlags = vk::DependencyFlagBits::eByRegion,
-        .bufferMemoryBarrierCount = 1,
-        .pBufferMemoryBarriers = &post_barrier,
-    });
+    if (batch_size != 0) {
+        upload_batch();
+    }
 }
 
 bool BufferCache::SynchronizeBufferFromImage(Buffer& buffer, VAddr device_addr, u32 size) {
@@ -3,16 +3,22 @@
 
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <shared_mutex>
+#include <vector>
 #include <boost/container/small_vector.hpp>
 #include <boost/icl/interval_map.hpp>
 #include <tsl/robin_map.h>
 #include "common/div_ceil.h"
+#include "common/lru_cache.h"
 #include "common/slot_vector.h"
 #include "common/types.h"
 #include "video_core/buffer_cache/buffer.h"
+#include "video_core/buffer_cache/buffer_index.h"
 #include "video_core/buffer_cache/memory_tracker_base.h"
 #include "video_core/buffer_cache/range_set.h"
+#include "video_core/buffer_cache/staging_copy.h"
 #include "video_core/multi_level_page_table.h"
 
 namespace AmdGpu {
@@ -75,9 +81,21 @@ public:
         return null_buffer_view;
     }
 
+    /// Returns the host visible buffer used to stage uploads from guest memory.
+    [[nodiscard]] StreamBuffer& GetStagingBuffer() noexcept {
+        return staging_buffer;
+    }
+
     /// Invalidates any buffer in the logical page range.
     void InvalidateMemory(VAddr device_addr, u64 size);
 
+    /// Writes GPU data read back over the pages of the range to guest memory, waiting for the
+    /// copy to finish if needed.
+    void ResolveReadbacks(VAddr device_addr, u64 size);
+
+    /// Writes every readback the GPU has finished copying to guest memory.
+    void ResolveCompletedReadbacks();
+
     /// Binds host vertex buffers for the current draw.
     bool BindVertexBuffers(const Shader::Info& vs_info,
                            const std::optional<Shader::Gcn::FetchShaderData>& fetch_shader);
@@ -110,26 +128,43 @@ public:
 
     [[nodiscard]] BufferId FindBuffer(VAddr device_addr, u32 size);
 
+    /// Evicts buffers that were not used recently, least recently used first, until at least
+    /// bytes_to_free bytes are released. GPU modified contents are written back to guest memory.
+    /// Returns the number of bytes released.
+    u64 RunGarbageCollector(u64 bytes_to_free);
+
+    /// Returns the size of all cached buffers.
+    [[nodiscard]] u64 GetMemoryUsage() const noexcept {
+        return total_used_memory;
+    }
+
+    /// Returns the number of cached buffers, not counting the null buffer.
+    [[nodiscard]] size_t GetNumBuffers() const noexcept {
+        return slot_buffers.size() - 1;
+    }
+
 private:
     template <typename Func>
     void ForEachBufferInRange(VAddr device_addr, u64 size, Func&& func) {
-        const u64 page_end = Common::DivCeil(device_addr + size, CACHING_PAGESIZE);
-        for (u64 page = device_addr >> CACHING_PAGEBITS; page < page_end;) {
-            const BufferId buffer_id = page_table[page];
-            if (!buffer_id) {
-                ++page;
-                continue;
-            }
-            Buffer& buffer = slot_buffers[buffer_id];
-            func(buffer_id, buffer);
-
-            const VAddr end_addr = buffer.CpuAddr() + buffer.SizeBytes();
-            page = Common::DivCeil(end_addr, CACHING_PAGESIZE);
-        }
+        buffer_index.ForEachOverlapping(device_addr, device_addr + size, [&](BufferId buffer_id) {
+            func(buffer_id, slot_buffers[buffer_id]);
+        });
     }
 
+    /// Copies GPU modified contents of the buffer to the download buffer. Guest memory is only
+    /// written once the copy is resolved, its pages stay write protected until then.
     void DownloadBufferMemory(Buffer& buffer, VAddr device_addr, u64 size);
 
+    /// GPU to host copy of a range of guest memory waiting to be written back.
+    struct PendingReadback {
+        u64 tick;
+        VAddr device_addr;
+        u64 size;
+        u64 offset; ///< Offset of the data in the download buffer.
+    };
+
+    void WriteReadbacks(std::span<const PendingReadback> readbacks);
+
     [[nodiscard]] OverlapResult ResolveOverlaps(VAddr device_addr, u32 wanted_size);
 
     void JoinOverlap(BufferId new_buffer_id, BufferId overlap_id, bool accumulate_stream_score);
@@ -149,20 +184,31 @@ private:
 
     void DeleteBuffer(BufferId buffer_id);
 
+    void TouchBuffer(Buffer& buffer);
+
     const Vulkan::Instance& instance;
     Vulkan::Scheduler& scheduler;
     AmdGpu::Liverpool* liverpool;
     TextureCache& texture_cache;
     PageManager& tracker;
     StreamBuffer staging_buffer;
+    StagingCopier staging_copier;
     StreamBuffer stream_buffer;
     Buffer gds_buffer;
+    StreamBuffer download_buffer;
+    std::mutex readback_mutex;
+    std::vector<PendingReadback> pending_readbacks;
+    std::atomic<size_t> num_pending_readbacks{};
+    std::atomic<size_t> num_writing_readbacks{};
     std::shared_mutex mutex;
     Common::SlotVector<Buffer> slot_buffers;
     RangeSet gpu_modified_ranges;
     vk::BufferView null_buffer_view;
     MemoryTracker memory_tracker;
     PageTable page_table;
+    BufferIndex buffer_index;
+    Common::LeastRecentlyUsedCache<BufferId, u64> lru_cache;
+    u64 total_used_memory{};
 };
 
 } // namespace VideoCore
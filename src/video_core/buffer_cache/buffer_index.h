@@ -0,0 +1,75 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <iterator>
+#include <map>
+#include "common/slot_vector.h"
+#include "common/types.h"
+
+namespace VideoCore {
+
+/// Ordered index of the address ranges covered by cached buffers. Buffers never overlap, so
+/// sorting them by start address is enough to find every buffer touching a range with a single
+/// lookup, no matter how large the range is or how sparsely it is populated.
+class BufferIndex {
+    struct Entry {
+        VAddr end;
+        Common::SlotId id;
+    };
+    using Map = std::map<VAddr, Entry>;
+
+public:
+    using Iterator = Map::const_iterator;
+
+    void Insert(VAddr begin, VAddr end, Common::SlotId id) {
+        map.emplace(begin, Entry{end, id});
+    }
+
+    void Erase(VAddr begin) {
+        map.erase(begin);
+    }
+
+    /// Returns the first range, in address order, that ends after addr.
+    [[nodiscard]] Iterator FirstEndingAfter(VAddr addr) const {
+        auto it = map.upper_bound(addr);
+        if (it != map.begin()) {
+            const auto prev = std::prev(it);
+            if (prev->second.end > addr) {
+                return prev;
+            }
+        }
+        return it;
+    }
+
+    [[nodiscard]] Iterator End() const {
+        return map.end();
+    }
+
+    /// Calls func(id) for every range overlapping [begin, end), in address order. The range
+    /// being visited may be erased by func.
+    template <typename Func>
+    void ForEachOverlapping(VAddr begin, VAddr end, Func&& func) const {
+        for (auto it = FirstEndingAfter(begin); it != map.end() && it->first < end;) {
+            const Common::SlotId id = it->second.id;
+            ++it;
+            func(id);
+        }
+    }
+
+    /// Returns true if any range overlaps [begin, end).
+    [[nodiscard]] bool IsOverlapping(VAddr begin, VAddr end) const {
+        const auto it = FirstEndingAfter(begin);
+        return it != map.end() && it->first < end;
+    }
+
+    [[nodiscard]] size_t Size() const noexcept {
+        return map.size();
+    }
+
+private:
+    Map map;
+};
+
+} // namespace VideoCore
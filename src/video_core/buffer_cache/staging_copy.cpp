@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <cstring>
+#include <latch>
+#include <thread>
+#include <vector>
+
+#include "common/arch.h"
+#include "common/thread_pool.h"
+#include "video_core/buffer_cache/staging_copy.h"
+
+#ifdef ARCH_X86_64
+#include <immintrin.h>
+#endif
+
+namespace VideoCore {
+
+// Below this a regular copy is faster, the data likely sits in the caches already.
+static constexpr size_t StreamingThreshold = 1_MB;
+// Below this the cost of waking up workers outweighs the copy itself.
+static constexpr size_t JobSize = 1_MB;
+
+void CopyToStaging(u8* dst, const u8* src, size_t size) {
+#ifdef ARCH_X86_64
+    if (size < StreamingThreshold) {
+        std::memcpy(dst, src, size);
+        return;
+    }
+    // Streaming stores need an aligned destination, the source may be unaligned.
+    const size_t head = -reinterpret_cast<uintptr_t>(dst) & 15;
+    std::memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    size -= head;
+    const size_t body = size & ~size_t{63};
+    for (size_t i = 0; i < body; i += 64) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), a);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 16), b);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 32), c);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 48), d);
+    }
+    std::memcpy(dst + body, src + body, size - body);
+    // Streaming stores are weakly ordered, make them visible before the GPU is told to read.
+    _mm_sfence();
+#else
+    std::memcpy(dst, src, size);
+#endif
+}
+
+StagingCopier::StagingCopier() = default;
+
+StagingCopier::~StagingCopier() = default;
+
+void StagingCopier::Run(std::span<const Copy> copies) {
+    size_t total_size = 0;
+    for (const Copy& copy : copies) {
+        total_size += copy.size;
+    }
+    if (total_size <= JobSize) {
+        for (const Copy& copy : copies) {
+            CopyToStaging(copy.dst, copy.src, copy.size);
+        }
+        return;
+    }
+
+    // Cut copies in pieces of at most one job and group small ones into jobs of similar size.
+    std::vector<Copy> pieces;
+    std::vector<size_t> job_ends;
+    size_t job_size = 0;
+    for (const Copy& copy : copies) {
+        for (size_t offset = 0; offset < copy.size;) {
+            const size_t piece_size = std::min(copy.size - offset, JobSize - job_size);
+            pieces.push_back({copy.dst + offset, copy.src + offset, piece_size});
+            offset += piece_size;
+            job_size += piece_size;
+            if (job_size == JobSize) {
+                job_ends.push_back(pieces.size());
+                job_size = 0;
+            }
+        }
+    }
+    if (job_size != 0) {
+        job_ends.push_back(pieces.size());
+    }
+
+    if (!workers) {
+        const size_t num_workers =
+            std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 8);
+        workers = std::make_unique<Common::ThreadPool>(num_workers, "Uploader");
+    }
+    std::latch done{static_cast<std::ptrdiff_t>(job_ends.size())};
+    size_t job_begin = 0;
+    for (const size_t job_end : job_ends) {
+        workers->Submit([&, job_begin, job_end](size_t) {
+            for (size_t i = job_begin; i < job_end; ++i) {
+                CopyToStaging(pieces[i].dst, pieces[i].src, pieces[i].size);
+            }
+            done.count_down();
+        });
+        job_begin = job_end;
+    }
+    done.wait();
+}
+
+} // namespace VideoCore
@@ -0,0 +1,39 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <memory>
+#include <span>
+#include "common/types.h"
+
+namespace Common {
+class ThreadPool;
+}
+
+namespace VideoCore {
+
+/// Copies guest memory into staging memory. Large copies use non-temporal stores, staging
+/// memory is write combined and never read by the CPU so there is no point in caching it.
+void CopyToStaging(u8* dst, const u8* src, size_t size);
+
+/// Copies batches of ranges into staging memory, splitting large batches across worker threads.
+class StagingCopier {
+public:
+    struct Copy {
+        u8* dst;
+        const u8* src;
+        size_t size;
+    };
+
+    StagingCopier();
+    ~StagingCopier();
+
+    /// Performs all copies and returns once they are done.
+    void Run(std::span<const Copy> copies);
+
+private:
+    std::unique_ptr<Common::ThreadPool> workers;
+};
+
+} // namespace VideoCore
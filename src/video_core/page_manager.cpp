@@ -2,7 +2,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include <thread>
-#include <boost/icl/interval_set.hpp>
+#include <utility>
 #include "common/alignment.h"
 #include "common/assert.h"
 #include "common/error.h"
@@ -179,6 +179,11 @@ void PageManager::OnGpuMap(VAddr address, size_t size) {
 }
 
 void PageManager::OnGpuUnmap(VAddr address, size_t size) {
+    {
+        std::scoped_lock lk{lock};
+        pending_protect -= decltype(pending_protect)::interval_type::right_open(
+            address >> PAGEBITS, (address + size + PAGESIZE - 1) >> PAGEBITS);
+    }
     impl->OnUnmap(address, size);
 }
 
@@ -206,9 +211,28 @@ void PageManager::UpdatePagesCachedCount(VAddr addr, u64 size, s32 delta) {
                    "Attempted to track non-GPU memory at address {:#x}, size {:#x}.",
                    interval_start_addr, interval_size);
         if (delta > 0 && count == delta) {
-            impl->Protect(interval_start_addr, interval_size, false);
+            // Ranges tracked close together, like the resources of a draw, are usually adjacent
+            // so they get protected together on the next flush.
+            pending_protect += interval;
+            ++stats.num_requested;
         } else if (delta < 0 && count == -delta) {
-            impl->Protect(interval_start_addr, interval_size, true);
+            ++stats.num_requested;
+            if (!boost::icl::intersects(pending_protect, interval)) {
+                impl->Protect(interval_start_addr, interval_size, true);
+                ++stats.num_issued;
+                continue;
+            }
+            // Pages still waiting for their protection never have to be unprotected. The rest
+            // are unprotected right away, a guest thread may be waiting on a fault in them.
+            decltype(pending_protect) unprotect{interval};
+            unprotect -= pending_protect;
+            pending_protect -= interval;
+            for (const auto& unprotect_interval : unprotect) {
+                const VAddr start_addr = boost::icl::first(unprotect_interval) << PageShift;
+                const VAddr end_addr = boost::icl::last_next(unprotect_interval) << PageShift;
+                impl->Protect(start_addr, end_addr - start_addr, true);
+                ++stats.num_issued;
+            }
         } else {
             ASSERT(count >= 0);
         }
@@ -219,4 +243,38 @@ void PageManager::UpdatePagesCachedCount(VAddr addr, u64 size, s32 delta) {
     }
 }
 
+void PageManager::FlushProtections() {
+    std::scoped_lock lk{lock};
+    for (const auto& interval : pending_protect) {
+        const VAddr start_addr = boost::icl::first(interval) << PAGEBITS;
+        const VAddr end_addr = boost::icl::last_next(interval) << PAGEBITS;
+        impl->Protect(start_addr, end_addr - start_addr, false);
+        ++stats.num_issued;
+    }
+    pending_protect.clear();
+}
+
+void PageManager::FlushProtections(VAddr addr, u64 size) {
+    std::scoped_lock lk{lock};
+    const auto pages = decltype(pending_protect)::interval_type::right_open(
+        addr >> PAGEBITS, (addr + size + PAGESIZE - 1) >> PAGEBITS);
+    // Overlapping ranges are protected whole, the rest of them would be flushed soon anyway.
+    decltype(pending_protect) flushed;
+    for (const auto& interval : boost::make_iterator_range(pending_protect.equal_range(pages))) {
+        flushed += interval;
+    }
+    for (const auto& interval : flushed) {
+        const VAddr start_addr = boost::icl::first(interval) << PAGEBITS;
+        const VAddr end_addr = boost::icl::last_next(interval) << PAGEBITS;
+        impl->Protect(start_addr, end_addr - start_addr, false);
+        ++stats.num_issued;
+    }
+    pending_protect -= flushed;
+}
+
+PageManager::ProtectStats PageManager::TakeProtectStats() {
+    std::scoped_lock lk{lock};
+    return std::exchange(stats, {});
+}
+
 } // namespace VideoCore
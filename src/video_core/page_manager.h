@@ -5,6 +5,7 @@
 
 #include <memory>
 #include <boost/icl/interval_map.hpp>
+#include <boost/icl/interval_set.hpp>
 #include "common/spin_lock.h"
 #include "common/types.h"
 
@@ -16,6 +17,12 @@ namespace VideoCore {
 
 class PageManager {
 public:
+    /// Protection changes requested by the caches and host calls issued to apply them.
+    struct ProtectStats {
+        u64 num_requested;
+        u64 num_issued;
+    };
+
     explicit PageManager(Vulkan::Rasterizer* rasterizer);
     ~PageManager();
 
@@ -25,9 +32,20 @@ public:
     /// Unregister a range of gpu memory that was unmapped.
     void OnGpuUnmap(VAddr address, size_t size);
 
-    /// Increase/decrease the number of surface in pages touching the specified region
+    /// Increase/decrease the number of surface in pages touching the specified region.
+    /// Write protection of newly tracked pages is deferred until FlushProtections is called.
     void UpdatePagesCachedCount(VAddr addr, u64 size, s32 delta);
 
+    /// Write protects the pages tracked since the last flush, one call per contiguous range.
+    void FlushProtections();
+
+    /// Write protects the queued ranges overlapping the region. Callers use it before reading
+    /// guest memory they just started tracking, so writes after the read are not missed.
+    void FlushProtections(VAddr addr, u64 size);
+
+    /// Returns the protection counters accumulated since the last call and resets them.
+    ProtectStats TakeProtectStats();
+
     static VAddr GetPageAddr(VAddr addr);
     static VAddr GetNextPageAddr(VAddr addr);
 
@@ -36,6 +54,8 @@ private:
     std::unique_ptr<Impl> impl;
     Vulkan::Rasterizer* rasterizer;
     boost::icl::interval_map<VAddr, s32> cached_pages;
+    boost::icl::interval_set<VAddr> pending_protect;
+    ProtectStats stats{};
     Common::SpinLock lock;
 };
 
@@ -14,22 +14,16 @@ namespace Vulkan {
 ComputePipeline::ComputePipeline(const Instance& instance_, Scheduler& scheduler_,
                                  DescriptorHeap& desc_heap_, vk::PipelineCache pipeline_cache,
                                  ComputePipelineKey compute_key_, const Shader::Info& info_,
-                                 vk::ShaderModule module)
-    : Pipeline{instance_, scheduler_, desc_heap_, pipeline_cache, true}, compute_key{compute_key_} {
+                                 vk::ShaderModule module_)
+    : Pipeline{instance_, scheduler_, desc_heap_, pipeline_cache, true}, compute_key{compute_key_},
+      module{module_} {
     auto& info = stages[int(Shader::LogicalStage::Compute)];
     info = &info_;
 
-    const vk::PipelineShaderStageCreateInfo shader_ci = {
-        .stage = vk::ShaderStageFlagBits::eCompute,
-        .module = module,
-        .pName = "main",
-    };
-
     u32 binding{};
-    boost::container::small_vector<vk::DescriptorSetLayoutBinding, 32> bindings;
 
     if (info->has_readconst) {
-        bindings.push_back({
+        desc_bindings.push_back({
             .binding = binding++,
             .descriptorType = vk::DescriptorType::eUniformBuffer,
             .descriptorCount = 1,
@@ -38,7 +32,7 @@ ComputePipeline::ComputePipeline(const Instance& instance_, Scheduler& scheduler
     }
     for (const auto& buffer : info->buffers) {
         const auto sharp = buffer.GetSharp(*info);
-        bindings.push_back({
+        desc_bindings.push_back({
             .binding = binding++,
             .descriptorType = buffer.IsStorage(sharp) ? vk::DescriptorType::eStorageBuffer
                                                       : vk::DescriptorType::eUniformBuffer,
@@ -47,7 +41,7 @@ ComputePipeline::ComputePipeline(const Instance& instance_, Scheduler& scheduler
         });
     }
     for (const auto& tex_buffer : info->texture_buffers) {
-        bindings.push_back({
+        desc_bindings.push_back({
             .binding = binding++,
             .descriptorType = tex_buffer.is_written ? vk::DescriptorType::eStorageTexelBuffer
                                                     : vk::DescriptorType::eUniformTexelBuffer,
@@ -56,7 +50,7 @@ ComputePipeline::ComputePipeline(const Instance& instance_, Scheduler& scheduler
         });
     }
     for (const auto& image : info->images) {
-        bindings.push_back({
+        desc_bindings.push_back({
             .binding = binding++,
             .descriptorType = image.IsStorage(image.GetSharp(*info))
                                   ? vk::DescriptorType::eStorageImage
@@ -66,7 +60,7 @@ ComputePipeline::ComputePipeline(const Instance& instance_, Scheduler& scheduler
         });
     }
     for (const auto& sampler : info->samplers) {
-        bindings.push_back({
+        desc_bindings.push_back({
             .binding = binding++,
             .descriptorType = vk::DescriptorType::eSampler,
             .descriptorCount = 1,
@@ -86,8 +80,8 @@ ComputePipeline::ComputePipeline(const Instance& instance_, Scheduler& scheduler
                            : vk::DescriptorSetLayoutCreateFlagBits{};
     const vk::DescriptorSetLayoutCreateInfo desc_layout_ci = {
         .flags = flags,
-        .bindingCount = static_cast<u32>(bindings.size()),
-        .pBindings = bindings.data(),
+        .bindingCount = static_cast<u32>(desc_bindings.size()),
+        .pBindings = desc_bindings.data(),
     };
     auto [descriptor_set_result, descriptor_set] =
         instance.GetDevice().createDescriptorSetLayoutUnique(desc_layout_ci);
@@ -107,7 +101,17 @@ ComputePipeline::ComputePipeline(const Instance& instance_, Scheduler& scheduler
     ASSERT_MSG(layout_result == vk::Result::eSuccess,
                "Failed to create compute pipeline layout: {}", vk::to_string(layout_result));
     pipeline_layout = std::move(layout);
+    CreateDescriptorTemplate();
+}
+
+ComputePipeline::~ComputePipeline() = default;
 
+void ComputePipeline::Compile() {
+    const vk::PipelineShaderStageCreateInfo shader_ci = {
+        .stage = vk::ShaderStageFlagBits::eCompute,
+        .module = module,
+        .pName = "main",
+    };
     const vk::ComputePipelineCreateInfo compute_pipeline_ci = {
         .stage = shader_ci,
         .layout = *pipeline_layout,
@@ -117,8 +121,7 @@ ComputePipeline::ComputePipeline(const Instance& instance_, Scheduler& scheduler
     ASSERT_MSG(pipeline_result == vk::Result::eSuccess, "Failed to create compute pipeline: {}",
                vk::to_string(pipeline_result));
     pipeline = std::move(pipe);
+    MarkReady();
 }
 
-ComputePipeline::~ComputePipeline() = default;
-
 } // namespace Vulkan
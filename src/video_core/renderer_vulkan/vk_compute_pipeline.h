@@ -35,8 +35,11 @@ public:
                     const Shader::Info& info, vk::ShaderModule module);
     ~ComputePipeline();
 
+    void Compile() override;
+
 private:
     ComputePipelineKey compute_key;
+    vk::ShaderModule module;
 };
 
 } // namespace Vulkan
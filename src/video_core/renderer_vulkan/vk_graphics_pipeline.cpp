@@ -30,11 +30,12 @@ GraphicsPipeline::GraphicsPipeline(
     std::span<const Shader::Info*, MaxShaderStages> infos,
     std::span<const Shader::RuntimeInfo, MaxShaderStages> runtime_infos,
     std::optional<const Shader::Gcn::FetchShaderData> fetch_shader_,
-    std::span<const vk::ShaderModule> modules)
+    std::span<const vk::ShaderModule> modules_)
     : Pipeline{instance_, scheduler_, desc_heap_, pipeline_cache}, key{key_},
-      fetch_shader{std::move(fetch_shader_)} {
-    const vk::Device device = instance.GetDevice();
+      fetch_shader{std::move(fetch_shader_)},
+      fs_info{runtime_infos[u32(Shader::LogicalStage::Fragment)].fs_info} {
     std::ranges::copy(infos, stages.begin());
+    std::ranges::copy(modules_, modules.begin());
     BuildDescSetLayout();
 
     const vk::PushConstantRange push_constants = {
@@ -54,9 +55,10 @@ GraphicsPipeline::GraphicsPipeline(
     ASSERT_MSG(layout_result == vk::Result::eSuccess,
                "Failed to create graphics pipeline layout: {}", vk::to_string(layout_result));
     pipeline_layout = std::move(layout);
+    CreateDescriptorTemplate();
 
-    boost::container::static_vector<vk::VertexInputBindingDescription, 32> vertex_bindings;
-    boost::container::static_vector<vk::VertexInputAttributeDescription, 32> vertex_attributes;
+    // Vertex input formats come from the live V#s, resolve them here so Compile does not
+    // read guest state.
     if (fetch_shader && !instance.IsVertexInputDynamicState()) {
         const auto& vs_info = GetStage(Shader::LogicalStage::Vertex);
         for (const auto& attrib : fetch_shader->attributes) {
@@ -85,7 +87,12 @@ GraphicsPipeline::GraphicsPipeline(
             });
         }
     }
+}
+
+GraphicsPipeline::~GraphicsPipeline() = default;
 
+void GraphicsPipeline::Compile() {
+    const vk::Device device = instance.GetDevice();
     const vk::PipelineVertexInputStateCreateInfo vertex_input_info = {
         .vertexBindingDescriptionCount = static_cast<u32>(vertex_bindings.size()),
         .pVertexBindingDescriptions = vertex_bindings.data(),
@@ -108,7 +115,6 @@ GraphicsPipeline::GraphicsPipeline(
                "Primitive restart index other than -1 is not supported yet");
     const bool is_rect_list = key.prim_type == AmdGpu::PrimitiveType::RectList;
     const bool is_quad_list = key.prim_type == AmdGpu::PrimitiveType::QuadList;
-    const auto& fs_info = runtime_infos[u32(Shader::LogicalStage::Fragment)].fs_info;
     const vk::PipelineTessellationStateCreateInfo tessellation_state = {
         .patchControlPoints = is_rect_list ? 3U : (is_quad_list ? 4U : key.patch_control_points),
     };
@@ -179,7 +185,7 @@ GraphicsPipeline::GraphicsPipeline(
     boost::container::static_vector<vk::PipelineShaderStageCreateInfo, MaxShaderStages>
         shader_stages;
     auto stage = u32(Shader::LogicalStage::Vertex);
-    if (infos[stage]) {
+    if (stages[stage]) {
         shader_stages.emplace_back(vk::PipelineShaderStageCreateInfo{
             .stage = vk::ShaderStageFlagBits::eVertex,
             .module = modules[stage],
@@ -187,7 +193,7 @@ GraphicsPipeline::GraphicsPipeline(
         });
     }
     stage = u32(Shader::LogicalStage::Geometry);
-    if (infos[stage]) {
+    if (stages[stage]) {
         shader_stages.emplace_back(vk::PipelineShaderStageCreateInfo{
             .stage = vk::ShaderStageFlagBits::eGeometry,
             .module = modules[stage],
@@ -195,7 +201,7 @@ GraphicsPipeline::GraphicsPipeline(
         });
     }
     stage = u32(Shader::LogicalStage::TessellationControl);
-    if (infos[stage]) {
+    if (stages[stage]) {
         shader_stages.emplace_back(vk::PipelineShaderStageCreateInfo{
             .stage = vk::ShaderStageFlagBits::eTessellationControl,
             .module = modules[stage],
@@ -211,7 +217,7 @@ GraphicsPipeline::GraphicsPipeline(
         });
     }
     stage = u32(Shader::LogicalStage::TessellationEval);
-    if (infos[stage]) {
+    if (stages[stage]) {
         shader_stages.emplace_back(vk::PipelineShaderStageCreateInfo{
             .stage = vk::ShaderStageFlagBits::eTessellationEvaluation,
             .module = modules[stage],
@@ -227,7 +233,7 @@ GraphicsPipeline::GraphicsPipeline(
         });
     }
     stage = u32(Shader::LogicalStage::Fragment);
-    if (infos[stage]) {
+    if (stages[stage]) {
         shader_stages.emplace_back(vk::PipelineShaderStageCreateInfo{
             .stage = vk::ShaderStageFlagBits::eFragment,
             .module = modules[stage],
@@ -322,12 +328,10 @@ GraphicsPipeline::GraphicsPipeline(
     ASSERT_MSG(pipeline_result == vk::Result::eSuccess, "Failed to create graphics pipeline: {}",
                vk::to_string(pipeline_result));
     pipeline = std::move(pipe);
+    MarkReady();
 }
 
-GraphicsPipeline::~GraphicsPipeline() = default;
-
 void GraphicsPipeline::BuildDescSetLayout() {
-    boost::container::small_vector<vk::DescriptorSetLayoutBinding, 32> bindings;
     u32 binding{};
 
     for (const auto* stage : stages) {
@@ -335,7 +339,7 @@ void GraphicsPipeline::BuildDescSetLayout() {
             continue;
         }
         if (stage->has_readconst) {
-            bindings.push_back({
+            desc_bindings.push_back({
                 .binding = binding++,
                 .descriptorType = vk::DescriptorType::eUniformBuffer,
                 .descriptorCount = 1,
@@ -344,7 +348,7 @@ void GraphicsPipeline::BuildDescSetLayout() {
         }
         for (const auto& buffer : stage->buffers) {
             const auto sharp = buffer.GetSharp(*stage);
-            bindings.push_back({
+            desc_bindings.push_back({
                 .binding = binding++,
                 .descriptorType = buffer.IsStorage(sharp) ? vk::DescriptorType::eStorageBuffer
                                                           : vk::DescriptorType::eUniformBuffer,
@@ -353,7 +357,7 @@ void GraphicsPipeline::BuildDescSetLayout() {
             });
         }
         for (const auto& tex_buffer : stage->texture_buffers) {
-            bindings.push_back({
+            desc_bindings.push_back({
                 .binding = binding++,
                 .descriptorType = tex_buffer.is_written ? vk::DescriptorType::eStorageTexelBuffer
                                                         : vk::DescriptorType::eUniformTexelBuffer,
@@ -362,7 +366,7 @@ void GraphicsPipeline::BuildDescSetLayout() {
             });
         }
         for (const auto& image : stage->images) {
-            bindings.push_back({
+            desc_bindings.push_back({
                 .binding = binding++,
                 .descriptorType = image.IsStorage(image.GetSharp(*stage))
                                       ? vk::DescriptorType::eStorageImage
@@ -372,7 +376,7 @@ void GraphicsPipeline::BuildDescSetLayout() {
             });
         }
         for (const auto& sampler : stage->samplers) {
-            bindings.push_back({
+            desc_bindings.push_back({
                 .binding = binding++,
                 .descriptorType = vk::DescriptorType::eSampler,
                 .descriptorCount = 1,
@@ -386,8 +390,8 @@ void GraphicsPipeline::BuildDescSetLayout() {
                            : vk::DescriptorSetLayoutCreateFlagBits{};
     const vk::DescriptorSetLayoutCreateInfo desc_layout_ci = {
         .flags = flags,
-        .bindingCount = static_cast<u32>(bindings.size()),
-        .pBindings = bindings.data(),
+        .bindingCount = static_cast<u32>(desc_bindings.size()),
+        .pBindings = desc_bindings.data(),
     };
     auto [layout_result, layout] =
         instance.GetDevice().createDescriptorSetLayoutUnique(desc_layout_ci);
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <boost/container/static_vector.hpp>
 #include <xxhash.h>
 
 #include "common/types.h"
@@ -77,6 +78,8 @@ public:
                      std::span<const vk::ShaderModule> modules);
     ~GraphicsPipeline();
 
+    void Compile() override;
+
     const std::optional<const Shader::Gcn::FetchShaderData>& GetFetchShader() const noexcept {
         return fetch_shader;
     }
@@ -105,6 +108,10 @@ private:
 private:
     GraphicsPipelineKey key;
     std::optional<const Shader::Gcn::FetchShaderData> fetch_shader{};
+    Shader::FragmentRuntimeInfo fs_info;
+    std::array<vk::ShaderModule, MaxShaderStages> modules{};
+    boost::container::static_vector<vk::VertexInputBindingDescription, 32> vertex_bindings;
+    boost::container::static_vector<vk::VertexInputAttributeDescription, 32> vertex_attributes;
 };
 
 } // namespace Vulkan
@@ -1,16 +1,22 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <algorithm>
 #include <ranges>
+#include <thread>
+#include <xxhash.h>
 
 #include "common/config.h"
+#include "common/elf_info.h"
 #include "common/hash.h"
 #include "common/io_file.h"
 #include "common/path_util.h"
+#include "common/serdes.h"
 #include "core/debug_state.h"
 #include "shader_recompiler/backend/spirv/emit_spirv.h"
 #include "shader_recompiler/info.h"
 #include "shader_recompiler/recompiler.h"
+#include "shader_recompiler/replay.h"
 #include "shader_recompiler/runtime_info.h"
 #include "video_core/renderer_vulkan/vk_instance.h"
 #include "video_core/renderer_vulkan/vk_pipeline_cache.h"
@@ -35,6 +41,46 @@ constexpr static std::array DescriptorHeapSizes = {
     vk::DescriptorPoolSize{vk::DescriptorType::eSampler, 1024},
 };
 
+static size_t NumCompileWorkers() {
+    // Leave room for the command processor and presentation threads.
+    return std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 8);
+}
+
+/// Compilation of a single program or permutation. Translation and specialization run on the
+/// submitting thread against a snapshot of the guest user data, so guest memory is only read
+/// while it matches the draw that requested the program. The pool only emits SPIR-V from the
+/// resulting IR, which references the job's own pools.
+struct PipelineCache::CompileJob {
+    explicit CompileJob(Program& program_, Stage stage, LogicalStage l_stage,
+                        const Shader::ShaderParams& params_,
+                        const Shader::RuntimeInfo& runtime_info_,
+                        const Shader::Backend::Bindings& binding_,
+                        std::optional<Shader::StageSpecialization> spec_, size_t perm_idx_,
+                        std::unique_ptr<Shader::Pools> pools_)
+        : program{program_}, params{user_data, params_.code, params_.hash},
+          info{stage, l_stage, params}, runtime_info{runtime_info_}, start_binding{binding_},
+          binding{binding_}, spec{std::move(spec_)}, perm_idx{perm_idx_},
+          pools{std::move(pools_)} {
+        std::ranges::copy(params_.user_data, user_data.begin());
+    }
+
+    Program& program;
+    std::array<u32, Shader::ShaderParams::NumShaderUserData> user_data{};
+    Shader::ShaderParams params;
+    Shader::Info info;
+    Shader::RuntimeInfo runtime_info;
+    Shader::Backend::Bindings start_binding;
+    Shader::Backend::Bindings binding;
+    std::optional<Shader::StageSpecialization> spec;
+    size_t perm_idx;
+    std::unique_ptr<Shader::Pools> pools;
+    std::optional<Shader::IR::Program> ir_program;
+    std::optional<Shader::ShaderReplay> replay;
+    std::optional<Shader::PassStats> stats;
+    std::vector<u32> spv;
+    std::atomic_bool done{};
+};
+
 void GatherVertexOutputs(Shader::VertexRuntimeInfo& info,
                          const AmdGpu::Liverpool::VsOutputControl& ctl) {
     const auto add_output = [&](VsOutput x, VsOutput y, VsOutput z, VsOutput w) {
@@ -193,7 +239,8 @@ const Shader::RuntimeInfo& PipelineCache::BuildRuntimeInfo(Stage stage, LogicalS
 PipelineCache::PipelineCache(const Instance& instance_, Scheduler& scheduler_,
                              AmdGpu::Liverpool* liverpool_)
     : instance{instance_}, scheduler{scheduler_}, liverpool{liverpool_},
-      desc_heap{instance, scheduler.GetMasterSemaphore(), DescriptorHeapSizes} {
+      desc_heap{instance, scheduler.GetMasterSemaphore(), DescriptorHeapSizes},
+      compile_pool{NumCompileWorkers(), "ShaderCompiler"} {
     const auto& vk12_props = instance.GetVk12Properties();
     profile = Shader::Profile{
         .supported_spirv = instance.ApiVersion() >= VK_API_VERSION_1_3 ? 0x00010600U : 0x00010500U,
@@ -208,16 +255,46 @@ PipelineCache::PipelineCache(const Instance& instance_, Scheduler& scheduler_,
         .needs_lds_barriers = instance.GetDriverID() == vk::DriverId::eNvidiaProprietary ||
                               instance.GetDriverID() == vk::DriverId::eMoltenvk,
     };
-    auto [cache_result, cache] = instance.GetDevice().createPipelineCacheUnique({});
+
+    std::vector<u8> pipeline_data;
+    const auto game_serial = Common::ElfInfo::Instance().GameSerial();
+    if (Config::isShaderCacheEnabled() && !game_serial.empty()) {
+        const auto uuid = instance.GetPipelineCacheUUID();
+        u64 device_hash = XXH3_64bits(uuid.data(), uuid.size());
+        device_hash = HashCombine(device_hash, u64(instance.GetVendorID()) << 32 |
+                                                   instance.GetDeviceID());
+        device_hash = HashCombine(device_hash, u64(instance.GetDriverVersion()));
+        shader_cache = std::make_unique<VideoCore::ShaderCache>(game_serial, device_hash);
+        pipeline_data = shader_cache->LoadPipelineData();
+
+        using PipelineType = VideoCore::ShaderCache::PipelineType;
+        graphics_pipelines.reserve(shader_cache->GetPipelineKeys(PipelineType::Graphics).size());
+        compute_pipelines.reserve(shader_cache->GetPipelineKeys(PipelineType::Compute).size());
+    }
+
+    const vk::PipelineCacheCreateInfo cache_info = {
+        .initialDataSize = pipeline_data.size(),
+        .pInitialData = pipeline_data.data(),
+    };
+    auto [cache_result, cache] = instance.GetDevice().createPipelineCacheUnique(cache_info);
     ASSERT_MSG(cache_result == vk::Result::eSuccess, "Failed to create pipeline cache: {}",
                vk::to_string(cache_result));
     pipeline_cache = std::move(cache);
 }
 
-PipelineCache::~PipelineCache() = default;
+PipelineCache::~PipelineCache() {
+    DumpPassStats();
+    if (!shader_cache) {
+        return;
+    }
+    const auto [result, data] = instance.GetDevice().getPipelineCacheData(*pipeline_cache);
+    if (result == vk::Result::eSuccess) {
+        shader_cache->SavePipelineData(data);
+    }
+}
 
 const GraphicsPipeline* PipelineCache::GetGraphicsPipeline() {
-    if (!RefreshGraphicsKey()) {
+    if (!RefreshKey(&PipelineCache::RefreshGraphicsKey)) {
         return nullptr;
     }
     const auto [it, is_new] = graphics_pipelines.try_emplace(graphics_key);
@@ -225,6 +302,11 @@ const GraphicsPipeline* PipelineCache::GetGraphicsPipeline() {
         it.value() = std::make_unique<GraphicsPipeline>(instance, scheduler, desc_heap,
                                                         graphics_key, *pipeline_cache, infos,
                                                         runtime_infos, fetch_shader, modules);
+        if (shader_cache) {
+            shader_cache->AddPipelineKey(VideoCore::ShaderCache::PipelineType::Graphics,
+                                         {reinterpret_cast<const u8*>(&graphics_key),
+                                          sizeof(GraphicsPipelineKey)});
+        }
         if (Config::collectShadersForDebug()) {
             for (auto stage = 0; stage < MaxShaderStages; ++stage) {
                 if (infos[stage]) {
@@ -233,24 +315,58 @@ const GraphicsPipeline* PipelineCache::GetGraphicsPipeline() {
                 }
             }
         }
+        CompilePipeline(*it->second);
     }
-    return it->second.get();
+    return it->second->IsReady() ? it->second.get() : nullptr;
 }
 
 const ComputePipeline* PipelineCache::GetComputePipeline() {
-    if (!RefreshComputeKey()) {
+    if (!RefreshKey(&PipelineCache::RefreshComputeKey)) {
         return nullptr;
     }
     const auto [it, is_new] = compute_pipelines.try_emplace(compute_key);
     if (is_new) {
         it.value() = std::make_unique<ComputePipeline>(
             instance, scheduler, desc_heap, *pipeline_cache, compute_key, *infos[0], modules[0]);
+        if (shader_cache) {
+            shader_cache->AddPipelineKey(VideoCore::ShaderCache::PipelineType::Compute,
+                                         {reinterpret_cast<const u8*>(&compute_key),
+                                          sizeof(ComputePipelineKey)});
+        }
         if (Config::collectShadersForDebug()) {
             auto& m = modules[0];
             module_related_pipelines[m].emplace_back(compute_key);
         }
+        CompilePipeline(*it->second);
+    }
+    return it->second->IsReady() ? it->second.get() : nullptr;
+}
+
+void PipelineCache::CompilePipeline(Pipeline& pipeline) {
+    // The driver compile is the expensive part of a new pipeline. In async mode it runs on the
+    // pool and draws using the pipeline are skipped until it is done.
+    if (!Config::isAsyncShaderCompileEnabled()) {
+        pipeline.Compile();
+        return;
+    }
+    compile_pool.Submit([&pipeline](size_t) { pipeline.Compile(); });
+}
+
+bool PipelineCache::RefreshKey(bool (PipelineCache::*refresh)()) {
+    PollCompileJobs();
+    while (true) {
+        compile_pending = false;
+        const bool is_valid = (this->*refresh)();
+        if (!compile_pending) {
+            return is_valid;
+        }
+        // In async mode the draw is skipped until its shaders are ready. Otherwise wait for
+        // them here; all stages of the pipeline have been submitted and compile in parallel.
+        if (Config::isAsyncShaderCompileEnabled()) {
+            return false;
+        }
+        WaitCompileJobs();
     }
-    return it->second.get();
 }
 
 bool PipelineCache::RefreshGraphicsKey() {
@@ -471,17 +587,51 @@ bool PipelineCache::RefreshComputeKey() {
     return true;
 }
 
-vk::ShaderModule PipelineCache::CompileModule(Shader::Info& info, Shader::RuntimeInfo& runtime_info,
-                                              std::span<const u32> code, size_t perm_idx,
-                                              Shader::Backend::Bindings& binding) {
+void PipelineCache::TranslateJob(CompileJob& job) {
+    auto& info = job.info;
     LOG_INFO(Render_Vulkan, "Compiling {} shader {:#x} {}", info.stage, info.pgm_hash,
-             perm_idx != 0 ? "(permutation)" : "");
-    DumpShader(code, info.pgm_hash, info.stage, perm_idx, "bin");
+             job.perm_idx != 0 ? "(permutation)" : "");
+    DumpShader(job.params.code, info.pgm_hash, info.stage, job.perm_idx, "bin");
 
-    const auto ir_program = Shader::TranslateProgram(code, pools, info, runtime_info, profile);
-    auto spv = Shader::Backend::SPIRV::EmitSPIRV(profile, runtime_info, ir_program, binding);
-    DumpShader(spv, info.pgm_hash, info.stage, perm_idx, "spv");
+    // Inputs are captured before translation as the recompiler updates runtime info in place.
+    if (Config::dumpShaders()) {
+        job.replay.emplace();
+        job.replay->runtime_info = job.runtime_info;
+        job.replay->profile = profile;
+        job.replay->binding = job.binding;
+    }
+    // Per-pass statistics walk the whole program around every pass, so they are opt-in.
+    if (Config::collectShaderPassStats()) {
+        job.stats.emplace();
+    }
+
+    job.ir_program.emplace(Shader::TranslateProgram(job.params.code, *job.pools, info,
+                                                    job.runtime_info, profile,
+                                                    job.stats ? &*job.stats : nullptr));
+    if (job.replay) {
+        job.replay->Capture(info);
+    }
+    if (!job.spec) {
+        job.spec.emplace(info, job.runtime_info, profile, job.start_binding);
+    }
+}
 
+void PipelineCache::EmitJob(CompileJob& job) {
+    const auto emit_start = std::chrono::steady_clock::now();
+    job.spv = Shader::Backend::SPIRV::EmitSPIRV(profile, job.runtime_info, *job.ir_program,
+                                                job.binding);
+    if (job.stats) {
+        job.stats->AddBackend("EmitSPIRV", std::chrono::steady_clock::now() - emit_start);
+        pass_stats.Add(*job.stats);
+    }
+    DumpShader(job.spv, job.info.pgm_hash, job.info.stage, job.perm_idx, "spv");
+    if (job.replay) {
+        DumpShaderReplay(*job.replay, job.perm_idx);
+    }
+}
+
+vk::ShaderModule PipelineCache::CreateModule(const Shader::Info& info, std::span<const u32> code,
+                                             std::span<const u32> spv, size_t perm_idx) {
     vk::ShaderModule module;
 
     auto patch = GetShaderPatch(info.pgm_hash, info.stage, perm_idx, "spv");
@@ -502,6 +652,131 @@ vk::ShaderModule PipelineCache::CompileModule(Shader::Info& info, Shader::Runtim
     return module;
 }
 
+bool PipelineCache::LoadProgram(Program& program, const Shader::ShaderParams& params) {
+    if (!shader_cache) {
+        return false;
+    }
+    const auto* entry = shader_cache->FindProgram(params.hash);
+    if (!entry || entry->permutations.empty()) {
+        return false;
+    }
+    // Inline constant buffers are tracked with absolute guest addresses, so the program
+    // must be loaded at the same location to reuse analysis results.
+    if (entry->pgm_base != params.Base() ||
+        entry->code_hash != XXH3_64bits(params.code.data(), params.code.size_bytes())) {
+        return false;
+    }
+
+    auto info = Shader::Info(program.info.stage, program.info.l_stage, params);
+    Serialization::Reader reader{entry->info};
+    if (!info.Deserialize(reader)) {
+        LOG_WARNING(Render_Vulkan, "Failed to load {} shader {:#x} from cache", info.stage,
+                    info.pgm_hash);
+        return false;
+    }
+    program.info = std::move(info);
+
+    for (size_t perm_idx = 0; perm_idx < entry->permutations.size(); ++perm_idx) {
+        const auto& perm = entry->permutations[perm_idx];
+        Shader::StageSpecialization spec{};
+        Serialization::Reader spec_reader{perm.spec};
+        if (!spec.Deserialize(spec_reader, program.info)) {
+            break;
+        }
+        const auto module = CreateModule(program.info, params.code, perm.spv, perm_idx);
+        program.AddPermut(module, std::move(spec));
+    }
+    LOG_INFO(Render_Vulkan, "Loaded {} shader {:#x} with {} permutations from cache",
+             program.info.stage, params.hash, program.modules.size());
+    return !program.modules.empty();
+}
+
+void PipelineCache::StorePermutation(const Program& program, const Shader::ShaderParams& params,
+                                     size_t perm_idx, const Shader::StageSpecialization& spec,
+                                     std::span<const u32> spv) {
+    if (!shader_cache) {
+        return;
+    }
+    std::vector<u8> data;
+    Serialization::Writer writer{data};
+    if (perm_idx == 0) {
+        program.info.Serialize(writer);
+        const u64 code_hash = XXH3_64bits(params.code.data(), params.code.size_bytes());
+        shader_cache->AddProgram(params.hash, code_hash, params.Base(), data);
+        data.clear();
+    }
+    spec.Serialize(writer);
+    shader_cache->AddPermutation(params.hash, static_cast<u32>(perm_idx), data, spv);
+}
+
+void PipelineCache::SubmitCompileJob(Program& program, Stage stage, LogicalStage l_stage,
+                                     const Shader::ShaderParams& params,
+                                     const Shader::RuntimeInfo& runtime_info,
+                                     const Shader::Backend::Bindings& binding,
+                                     std::optional<Shader::StageSpecialization> spec) {
+    const auto num_queued = std::ranges::count_if(
+        compile_jobs, [&](const auto& job) { return &job->program == &program; });
+    const size_t perm_idx = program.modules.size() + num_queued;
+    std::unique_ptr<Shader::Pools> pools;
+    if (free_pools.empty()) {
+        pools = std::make_unique<Shader::Pools>();
+    } else {
+        pools = std::move(free_pools.back());
+        free_pools.pop_back();
+    }
+    auto& job = compile_jobs.emplace_back(
+        std::make_unique<CompileJob>(program, stage, l_stage, params, runtime_info, binding,
+                                     std::move(spec), perm_idx, std::move(pools)));
+
+    TranslateJob(*job);
+    compile_pool.Submit([this, job = job.get()](size_t) {
+        EmitJob(*job);
+        job->done = true;
+        job->done.notify_all();
+    });
+}
+
+bool PipelineCache::IsCompiling(const Program& program,
+                                const Shader::StageSpecialization& spec) const {
+    return std::ranges::any_of(compile_jobs, [&](const auto& job) {
+        return &job->program == &program && *job->spec == spec;
+    });
+}
+
+void PipelineCache::FinishCompileJob(CompileJob& job) {
+    // The IR references the job's info and pooled memory, drop it before either moves on.
+    job.ir_program.reset();
+    job.pools->ReleaseContents();
+    free_pools.push_back(std::move(job.pools));
+
+    auto& program = job.program;
+    auto& spec = *job.spec;
+    const auto module = CreateModule(job.info, job.params.code, job.spv, job.perm_idx);
+    if (job.perm_idx == 0) {
+        program.info = std::move(job.info);
+        program.info.user_data = {};
+        spec.info = &program.info;
+    }
+    StorePermutation(program, job.params, job.perm_idx, spec, job.spv);
+    program.AddPermut(module, std::move(spec));
+}
+
+void PipelineCache::PollCompileJobs() {
+    while (!compile_jobs.empty() && compile_jobs.front()->done) {
+        FinishCompileJob(*compile_jobs.front());
+        compile_jobs.pop_front();
+    }
+}
+
+void PipelineCache::WaitCompileJobs() {
+    while (!compile_jobs.empty()) {
+        auto& job = *compile_jobs.front();
+        job.done.wait(false);
+        FinishCompileJob(job);
+        compile_jobs.pop_front();
+    }
+}
+
 PipelineCache::Result PipelineCache::GetProgram(Stage stage, LogicalStage l_stage,
                                                 Shader::ShaderParams params,
                                                 Shader::Backend::Bindings& binding) {
@@ -510,38 +785,61 @@ PipelineCache::Result PipelineCache::GetProgram(Stage stage, LogicalStage l_stag
     if (new_program) {
         it_pgm.value() = std::make_unique<Program>(stage, l_stage, params);
         auto& program = it_pgm.value();
-        auto start = binding;
-        const auto module = CompileModule(program->info, runtime_info, params.code, 0, binding);
-        const auto spec = Shader::StageSpecialization(program->info, runtime_info, profile, start);
-        program->AddPermut(module, std::move(spec));
-        return std::make_tuple(&program->info, module, spec.fetch_shader_data,
-                               HashCombine(params.hash, 0));
+        if (!LoadProgram(*program, params)) {
+            SubmitCompileJob(*program, stage, l_stage, params, runtime_info, binding, {});
+            compile_pending = true;
+            return {};
+        }
     }
-    it_pgm.value()->info.user_data = params.user_data;
 
     auto& program = it_pgm.value();
+    if (program->modules.empty()) {
+        // First compilation of the program is still in flight.
+        compile_pending = true;
+        return {};
+    }
+
     auto& info = program->info;
+    info.user_data = params.user_data;
     info.RefreshFlatBuf();
-    const auto spec = Shader::StageSpecialization(info, runtime_info, profile, binding);
-    size_t perm_idx = program->modules.size();
-    vk::ShaderModule module{};
+    auto spec = Shader::StageSpecialization(info, runtime_info, profile, binding);
 
     const auto it = std::ranges::find(program->modules, spec, &Program::Module::spec);
     if (it == program->modules.end()) {
-        auto new_info = Shader::Info(stage, l_stage, params);
-        module = CompileModule(new_info, runtime_info, params.code, perm_idx, binding);
-        program->AddPermut(module, std::move(spec));
-    } else {
-        info.AddBindings(binding);
-        module = it->module;
-        perm_idx = std::distance(program->modules.begin(), it);
+        if (!IsCompiling(*program, spec)) {
+            SubmitCompileJob(*program, stage, l_stage, params, runtime_info, binding,
+                             std::move(spec));
+        }
+        compile_pending = true;
+        return {};
     }
-    return std::make_tuple(&info, module, spec.fetch_shader_data,
+
+    info.AddBindings(binding);
+    const size_t perm_idx = std::distance(program->modules.begin(), it);
+    return std::make_tuple(&info, it->module, spec.fetch_shader_data,
                            HashCombine(params.hash, perm_idx));
 }
 
 std::optional<vk::ShaderModule> PipelineCache::ReplaceShader(vk::ShaderModule module,
                                                              std::span<const u32> spv_code) {
+    const auto related_it = module_related_pipelines.find(module);
+    if (related_it != module_related_pipelines.end()) {
+        // Pipelines using the module may still be compiling on the pool.
+        for (const auto& key : related_it->second) {
+            if (std::holds_alternative<GraphicsPipelineKey>(key)) {
+                const auto it = graphics_pipelines.find(std::get<GraphicsPipelineKey>(key));
+                if (it != graphics_pipelines.end()) {
+                    it->second->WaitReady();
+                }
+            } else if (std::holds_alternative<ComputePipelineKey>(key)) {
+                const auto it = compute_pipelines.find(std::get<ComputePipelineKey>(key));
+                if (it != compute_pipelines.end()) {
+                    it->second->WaitReady();
+                }
+            }
+        }
+    }
+
     std::optional<vk::ShaderModule> new_module{};
     for (const auto& [_, program] : program_cache) {
         for (auto& m : program->modules) {
@@ -592,6 +890,32 @@ void PipelineCache::DumpShader(std::span<const u32> code, u64 hash, Shader::Stag
     file.WriteSpan(code);
 }
 
+void PipelineCache::DumpShaderReplay(const Shader::ShaderReplay& replay, size_t perm_idx) {
+    std::vector<u8> data;
+    Serialization::Writer writer{data};
+    replay.Serialize(writer);
+
+    using namespace Common::FS;
+    const auto dump_dir = GetUserPath(PathType::ShaderDir) / "dumps";
+    const auto filename =
+        fmt::format("{}.replay", GetShaderName(replay.stage, replay.hash, perm_idx));
+    const auto file = IOFile{dump_dir / filename, FileAccessMode::Write};
+    file.WriteSpan(std::span<const u8>{data});
+}
+
+void PipelineCache::DumpPassStats() const {
+    if (pass_stats.NumShaders() == 0) {
+        return;
+    }
+    LOG_INFO(Render_Recompiler, "{}", pass_stats.Summary());
+
+    using namespace Common::FS;
+    const auto json = pass_stats.ToJson();
+    const auto file =
+        IOFile{GetUserPath(PathType::LogDir) / "shader_pass_stats.json", FileAccessMode::Write};
+    file.WriteString(json);
+}
+
 std::optional<std::vector<u32>> PipelineCache::GetShaderPatch(u64 hash, Shader::Stage stage,
                                                               size_t perm_idx,
                                                               std::string_view ext) {
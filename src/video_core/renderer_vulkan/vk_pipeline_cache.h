@@ -3,14 +3,18 @@
 
 #pragma once
 
+#include <deque>
 #include <variant>
 #include <tsl/robin_map.h>
+#include "common/thread_pool.h"
+#include "shader_recompiler/pass_stats.h"
 #include "shader_recompiler/profile.h"
 #include "shader_recompiler/recompiler.h"
 #include "shader_recompiler/specialization.h"
 #include "video_core/renderer_vulkan/vk_compute_pipeline.h"
 #include "video_core/renderer_vulkan/vk_graphics_pipeline.h"
 #include "video_core/renderer_vulkan/vk_resource_pool.h"
+#include "video_core/shader_cache.h"
 
 template <>
 struct std::hash<vk::ShaderModule> {
@@ -21,6 +25,7 @@ struct std::hash<vk::ShaderModule> {
 
 namespace Shader {
 struct Info;
+struct ShaderReplay;
 }
 
 namespace Vulkan {
@@ -69,16 +74,37 @@ public:
                                      std::optional<size_t> perm = {});
 
 private:
+    struct CompileJob;
+
+    bool RefreshKey(bool (PipelineCache::*refresh)());
     bool RefreshGraphicsKey();
     bool RefreshComputeKey();
 
+    void SubmitCompileJob(Program& program, Shader::Stage stage, Shader::LogicalStage l_stage,
+                          const Shader::ShaderParams& params,
+                          const Shader::RuntimeInfo& runtime_info,
+                          const Shader::Backend::Bindings& binding,
+                          std::optional<Shader::StageSpecialization> spec);
+    bool IsCompiling(const Program& program, const Shader::StageSpecialization& spec) const;
+    void FinishCompileJob(CompileJob& job);
+    void PollCompileJobs();
+    void WaitCompileJobs();
+    void CompilePipeline(Pipeline& pipeline);
+
     void DumpShader(std::span<const u32> code, u64 hash, Shader::Stage stage, size_t perm_idx,
                     std::string_view ext);
+    void DumpShaderReplay(const Shader::ShaderReplay& replay, size_t perm_idx);
+    void DumpPassStats() const;
     std::optional<std::vector<u32>> GetShaderPatch(u64 hash, Shader::Stage stage, size_t perm_idx,
                                                    std::string_view ext);
-    vk::ShaderModule CompileModule(Shader::Info& info, Shader::RuntimeInfo& runtime_info,
-                                   std::span<const u32> code, size_t perm_idx,
-                                   Shader::Backend::Bindings& binding);
+    void TranslateJob(CompileJob& job);
+    void EmitJob(CompileJob& job);
+    vk::ShaderModule CreateModule(const Shader::Info& info, std::span<const u32> code,
+                                  std::span<const u32> spv, size_t perm_idx);
+    bool LoadProgram(Program& program, const Shader::ShaderParams& params);
+    void StorePermutation(const Program& program, const Shader::ShaderParams& params,
+                          size_t perm_idx, const Shader::StageSpecialization& spec,
+                          std::span<const u32> spv);
     const Shader::RuntimeInfo& BuildRuntimeInfo(Shader::Stage stage, Shader::LogicalStage l_stage);
 
 private:
@@ -88,8 +114,8 @@ private:
     DescriptorHeap desc_heap;
     vk::UniquePipelineCache pipeline_cache;
     vk::UniquePipelineLayout pipeline_layout;
+    std::unique_ptr<VideoCore::ShaderCache> shader_cache;
     Shader::Profile profile{};
-    Shader::Pools pools;
     tsl::robin_map<size_t, std::unique_ptr<Program>> program_cache;
     tsl::robin_map<ComputePipelineKey, std::unique_ptr<ComputePipeline>> compute_pipelines;
     tsl::robin_map<GraphicsPipelineKey, std::unique_ptr<GraphicsPipeline>> graphics_pipelines;
@@ -99,11 +125,19 @@ private:
     std::optional<Shader::Gcn::FetchShaderData> fetch_shader{};
     GraphicsPipelineKey graphics_key{};
     ComputePipelineKey compute_key{};
+    bool compile_pending{};
+    Shader::PassStatsCollector pass_stats;
 
     // Only if Config::collectShadersForDebug()
     tsl::robin_map<vk::ShaderModule,
                    std::vector<std::variant<GraphicsPipelineKey, ComputePipelineKey>>>
         module_related_pipelines;
+
+    // Compile jobs in submission order. Results are consumed in the same order so permutation
+    // indices stay stable. The pool is declared last so its workers are joined first.
+    std::deque<std::unique_ptr<CompileJob>> compile_jobs;
+    std::vector<std::unique_ptr<Shader::Pools>> free_pools;
+    Common::ThreadPool compile_pool;
 };
 
 } // namespace Vulkan
@@ -1,6 +1,7 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <cstring>
 #include <boost/container/static_vector.hpp>
 
 #include "shader_recompiler/info.h"
@@ -13,13 +14,48 @@
 namespace Vulkan {
 
 Pipeline::Pipeline(const Instance& instance_, Scheduler& scheduler_, DescriptorHeap& desc_heap_,
-                   vk::PipelineCache pipeline_cache, bool is_compute_ /*= false*/)
-    : instance{instance_}, scheduler{scheduler_}, desc_heap{desc_heap_}, is_compute{is_compute_} {}
+                   vk::PipelineCache pipeline_cache_, bool is_compute_ /*= false*/)
+    : instance{instance_}, scheduler{scheduler_}, desc_heap{desc_heap_},
+      pipeline_cache{pipeline_cache_}, is_compute{is_compute_} {}
 
 Pipeline::~Pipeline() = default;
 
-void Pipeline::BindResources(DescriptorWrites& set_writes, const BufferBarriers& buffer_barriers,
-                             const Shader::PushData& push_data) const {
+void Pipeline::CreateDescriptorTemplate() {
+    if (desc_bindings.empty()) {
+        return;
+    }
+    boost::container::small_vector<vk::DescriptorUpdateTemplateEntry, 32> entries;
+    for (const auto& binding : desc_bindings) {
+        entries.push_back({
+            .dstBinding = binding.binding,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = binding.descriptorType,
+            .offset = binding.binding * sizeof(DescriptorData),
+            .stride = sizeof(DescriptorData),
+        });
+    }
+    const vk::DescriptorUpdateTemplateCreateInfo template_ci = {
+        .descriptorUpdateEntryCount = static_cast<u32>(entries.size()),
+        .pDescriptorUpdateEntries = entries.data(),
+        .templateType = uses_push_descriptors
+                            ? vk::DescriptorUpdateTemplateType::ePushDescriptorsKHR
+                            : vk::DescriptorUpdateTemplateType::eDescriptorSet,
+        .descriptorSetLayout = *desc_layout,
+        .pipelineBindPoint =
+            IsCompute() ? vk::PipelineBindPoint::eCompute : vk::PipelineBindPoint::eGraphics,
+        .pipelineLayout = *pipeline_layout,
+        .set = 0,
+    };
+    auto [template_result, update_template] =
+        instance.GetDevice().createDescriptorUpdateTemplateUnique(template_ci);
+    ASSERT_MSG(template_result == vk::Result::eSuccess,
+               "Failed to create descriptor update template: {}", vk::to_string(template_result));
+    desc_template = std::move(update_template);
+}
+
+u32 Pipeline::BindResources(DescriptorWrites& set_writes, const BufferBarriers& buffer_barriers,
+                            const Shader::PushData& push_data) const {
     const auto cmdbuf = scheduler.CommandBuffer();
     const auto bind_point =
         IsCompute() ? vk::PipelineBindPoint::eCompute : vk::PipelineBindPoint::eGraphics;
@@ -39,20 +75,104 @@ void Pipeline::BindResources(DescriptorWrites& set_writes, const BufferBarriers&
 
     // Bind descriptor set.
     if (set_writes.empty()) {
-        return;
+        return 0;
+    }
+
+    if (!desc_template || set_writes.size() != desc_bindings.size()) {
+        if (uses_push_descriptors) {
+            cmdbuf.pushDescriptorSetKHR(bind_point, *pipeline_layout, 0, set_writes);
+            return static_cast<u32>(set_writes.size());
+        }
+        const auto desc_set = desc_heap.Commit(*desc_layout);
+        for (auto& set_write : set_writes) {
+            set_write.dstSet = desc_set;
+        }
+        instance.GetDevice().updateDescriptorSets(set_writes, {});
+        cmdbuf.bindDescriptorSets(bind_point, *pipeline_layout, 0, desc_set, {});
+        return static_cast<u32>(set_writes.size());
+    }
+
+    // Gather the descriptors in the layout of the update template, zeroed so they can be compared.
+    boost::container::small_vector<DescriptorData, 32> descriptors(set_writes.size());
+    for (const auto& set_write : set_writes) {
+        DescriptorData& data = descriptors[set_write.dstBinding];
+        switch (set_write.descriptorType) {
+        case vk::DescriptorType::eSampler:
+        case vk::DescriptorType::eSampledImage:
+        case vk::DescriptorType::eStorageImage:
+            data.image.sampler = static_cast<VkSampler>(set_write.pImageInfo->sampler);
+            data.image.imageView = static_cast<VkImageView>(set_write.pImageInfo->imageView);
+            data.image.imageLayout = static_cast<VkImageLayout>(set_write.pImageInfo->imageLayout);
+            break;
+        case vk::DescriptorType::eUniformBuffer:
+        case vk::DescriptorType::eStorageBuffer:
+            data.buffer.buffer = static_cast<VkBuffer>(set_write.pBufferInfo->buffer);
+            data.buffer.offset = set_write.pBufferInfo->offset;
+            data.buffer.range = set_write.pBufferInfo->range;
+            break;
+        case vk::DescriptorType::eUniformTexelBuffer:
+        case vk::DescriptorType::eStorageTexelBuffer:
+            data.texel_buffer = static_cast<VkBufferView>(*set_write.pTexelBufferView);
+            break;
+        default:
+            UNREACHABLE_MSG("Unexpected descriptor type {}",
+                            vk::to_string(set_write.descriptorType));
+        }
     }
 
     if (uses_push_descriptors) {
-        cmdbuf.pushDescriptorSetKHR(bind_point, *pipeline_layout, 0, set_writes);
-        return;
+        cmdbuf.pushDescriptorSetWithTemplateKHR(*desc_template, *pipeline_layout, 0,
+                                                descriptors.data());
+        return static_cast<u32>(descriptors.size());
+    }
+
+    // Draws with this pipeline often bind the same resources again, the set written for the
+    // previous one can be reused then. Sets are recycled once the command buffer they were used
+    // in completes, so only reuse them within the same one.
+    const u64 tick = scheduler.CurrentTick();
+    const bool has_previous = bound_set && bound_tick == tick;
+    if (has_previous && std::memcmp(bound_descriptors.data(), descriptors.data(),
+                                    descriptors.size() * sizeof(DescriptorData)) == 0) {
+        cmdbuf.bindDescriptorSets(bind_point, *pipeline_layout, 0, bound_set, {});
+        return 0;
     }
 
     const auto desc_set = desc_heap.Commit(*desc_layout);
-    for (auto& set_write : set_writes) {
-        set_write.dstSet = desc_set;
+    u32 num_written = static_cast<u32>(descriptors.size());
+    if (has_previous) {
+        // The previous set is referenced by this command buffer and must not be modified, copy
+        // the descriptors that did not change from it and only write the ones that did.
+        boost::container::small_vector<vk::WriteDescriptorSet, 32> changed_writes;
+        boost::container::small_vector<vk::CopyDescriptorSet, 32> copies;
+        for (auto& set_write : set_writes) {
+            const u32 binding = set_write.dstBinding;
+            if (std::memcmp(&bound_descriptors[binding], &descriptors[binding],
+                            sizeof(DescriptorData)) == 0) {
+                copies.push_back({
+                    .srcSet = bound_set,
+                    .srcBinding = binding,
+                    .srcArrayElement = 0,
+                    .dstSet = desc_set,
+                    .dstBinding = binding,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                });
+            } else {
+                set_write.dstSet = desc_set;
+                changed_writes.push_back(set_write);
+            }
+        }
+        instance.GetDevice().updateDescriptorSets(changed_writes, copies);
+        num_written = static_cast<u32>(changed_writes.size());
+    } else {
+        instance.GetDevice().updateDescriptorSetWithTemplate(desc_set, *desc_template,
+                                                             descriptors.data());
     }
-    instance.GetDevice().updateDescriptorSets(set_writes, {});
     cmdbuf.bindDescriptorSets(bind_point, *pipeline_layout, 0, desc_set, {});
+    bound_descriptors.assign(descriptors.begin(), descriptors.end());
+    bound_set = desc_set;
+    bound_tick = tick;
+    return num_written;
 }
 
 } // namespace Vulkan
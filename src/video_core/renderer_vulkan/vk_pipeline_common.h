@@ -3,6 +3,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <vector>
+#include <boost/container/small_vector.hpp>
+
 #include "shader_recompiler/backend/bindings.h"
 #include "shader_recompiler/info.h"
 #include "video_core/renderer_vulkan/vk_common.h"
@@ -29,6 +33,20 @@ public:
              vk::PipelineCache pipeline_cache, bool is_compute = false);
     virtual ~Pipeline();
 
+    /// Creates the pipeline object. Everything that depends on guest state is resolved by the
+    /// constructor, so this may run on a compile worker.
+    virtual void Compile() = 0;
+
+    /// Returns true once Compile has finished and the pipeline can be bound.
+    bool IsReady() const noexcept {
+        return ready.load(std::memory_order_acquire);
+    }
+
+    /// Blocks until Compile has finished.
+    void WaitReady() const noexcept {
+        ready.wait(false, std::memory_order_acquire);
+    }
+
     vk::Pipeline Handle() const noexcept {
         return *pipeline;
     }
@@ -57,19 +75,44 @@ public:
     using DescriptorWrites = boost::container::small_vector<vk::WriteDescriptorSet, 16>;
     using BufferBarriers = boost::container::small_vector<vk::BufferMemoryBarrier2, 16>;
 
-    void BindResources(DescriptorWrites& set_writes, const BufferBarriers& buffer_barriers,
-                       const Shader::PushData& push_data) const;
+    /// Binds the resources of a draw and returns the number of descriptors written. Descriptors
+    /// identical to the previous draw with this pipeline are not written again.
+    u32 BindResources(DescriptorWrites& set_writes, const BufferBarriers& buffer_barriers,
+                      const Shader::PushData& push_data) const;
 
 protected:
+    /// Creates the update template of desc_bindings, needs the pipeline layout.
+    void CreateDescriptorTemplate();
+
+    /// Publishes the pipeline object created by Compile.
+    void MarkReady() noexcept {
+        ready.store(true, std::memory_order_release);
+        ready.notify_all();
+    }
+
+    /// A descriptor as laid out in the data of the update template.
+    union DescriptorData {
+        VkDescriptorImageInfo image;
+        VkDescriptorBufferInfo buffer;
+        VkBufferView texel_buffer;
+    };
+
     const Instance& instance;
     Scheduler& scheduler;
     DescriptorHeap& desc_heap;
+    vk::PipelineCache pipeline_cache;
     vk::UniquePipeline pipeline;
     vk::UniquePipelineLayout pipeline_layout;
     vk::UniqueDescriptorSetLayout desc_layout;
+    boost::container::small_vector<vk::DescriptorSetLayoutBinding, 32> desc_bindings;
+    vk::UniqueDescriptorUpdateTemplate desc_template;
+    mutable std::vector<DescriptorData> bound_descriptors;
+    mutable vk::DescriptorSet bound_set;
+    mutable u64 bound_tick{};
     std::array<const Shader::Info*, Shader::MaxStageTypes> stages{};
     bool uses_push_descriptors{};
     const bool is_compute;
+    std::atomic_bool ready{};
 };
 
 } // namespace Vulkan
@@ -559,6 +559,7 @@ Frame* Presenter::PrepareFrameInternal(VideoCore::ImageId image_id, bool is_eop)
         };
 
         cmdbuf.bindPipeline(vk::PipelineBindPoint::eGraphics, *pp_pipeline);
+        scheduler.InvalidateDynamicState();
 
         const auto& dst_rect =
             FitImage(image.info.size.width, image.info.size.height, frame->width, frame->height);
@@ -756,6 +757,10 @@ void Presenter::Present(Frame* frame) {
     }
 
     free_frame();
+    if (DebugState.GetFrameNum() == 0) {
+        // Log timestamps are relative to boot, this one marks the time to first frame.
+        LOG_INFO(Render_Vulkan, "First frame presented");
+    }
     DebugState.IncFlipFrameNum();
 }
 
@@ -19,12 +19,31 @@
 
 namespace Vulkan {
 
+/// Returns the memory budget of the texture and buffer caches. Unless configured, the caches
+/// may use up to three quarters of the largest device local heap.
+static u64 GetCacheBudget(const Instance& instance) {
+    if (const u64 budget_mb = Config::cacheBudgetMb(); budget_mb != 0) {
+        return budget_mb * 1_MB;
+    }
+    const auto mem_props = instance.GetPhysicalDevice().getMemoryProperties();
+    u64 heap_size = 0;
+    for (u32 i = 0; i < mem_props.memoryHeapCount; i++) {
+        const vk::MemoryHeap& heap = mem_props.memoryHeaps[i];
+        if (heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+            heap_size = std::max<u64>(heap_size, heap.size);
+        }
+    }
+    return heap_size / 4 * 3;
+}
+
 Rasterizer::Rasterizer(const Instance& instance_, Scheduler& scheduler_,
                        AmdGpu::Liverpool* liverpool_)
     : instance{instance_}, scheduler{scheduler_}, page_manager{this},
       buffer_cache{instance, scheduler, liverpool_, texture_cache, page_manager},
       texture_cache{instance, scheduler, buffer_cache, page_manager}, liverpool{liverpool_},
-      memory{Core::Memory::Instance()}, pipeline_cache{instance, scheduler, liverpool} {
+      memory{Core::Memory::Instance()}, pipeline_cache{instance, scheduler, liverpool},
+      cache_budget{GetCacheBudget(instance)} {
+    LOG_INFO(Render_Vulkan, "Texture and buffer cache budget is {} MB", cache_budget / 1_MB);
     if (!Config::nullGpu()) {
         liverpool->BindRasterizer(this);
     }
@@ -392,14 +411,51 @@ void Rasterizer::DispatchIndirect(VAddr address, u32 offset, u32 size) {
 }
 
 u64 Rasterizer::Flush() {
+    CollectGarbage();
+    page_manager.FlushProtections();
+    const auto protect_stats = page_manager.TakeProtectStats();
+    TRACE_PLOT("Page protections requested", protect_stats.num_requested);
+    TRACE_PLOT("Page protection calls", protect_stats.num_issued);
+    TRACE_PLOT("Descriptors bound", num_descriptors_bound);
+    TRACE_PLOT("Descriptors written", num_descriptors_written);
+    num_descriptors_bound = 0;
+    num_descriptors_written = 0;
+    TRACE_PLOT("Dynamic state commands", num_state_commands);
+    TRACE_PLOT("Dynamic state commands skipped", num_state_commands_skipped);
+    num_state_commands = 0;
+    num_state_commands_skipped = 0;
     const u64 current_tick = scheduler.CurrentTick();
     SubmitInfo info{};
     scheduler.Flush(info);
+    buffer_cache.ResolveCompletedReadbacks();
     return current_tick;
 }
 
 void Rasterizer::Finish() {
     scheduler.Finish();
+    buffer_cache.ResolveCompletedReadbacks();
+}
+
+void Rasterizer::CollectGarbage() {
+    const u64 used_memory = texture_cache.GetMemoryUsage() + buffer_cache.GetMemoryUsage();
+    if (used_memory <= cache_budget) {
+        return;
+    }
+    // Textures are cheaper to bring back than buffers which may need a readback before eviction.
+    u64 excess = used_memory - cache_budget;
+    u64 bytes_freed = texture_cache.RunGarbageCollector(excess);
+    if (bytes_freed < excess) {
+        bytes_freed += buffer_cache.RunGarbageCollector(excess - bytes_freed);
+    }
+    if (bytes_freed == 0) {
+        return;
+    }
+    LOG_INFO(Render_Vulkan,
+             "Evicted {} MB from caches, {} images using {} MB and {} buffers using {} MB remain "
+             "(budget {} MB)",
+             bytes_freed / 1_MB, texture_cache.GetNumImages(),
+             texture_cache.GetMemoryUsage() / 1_MB, buffer_cache.GetNumBuffers(),
+             buffer_cache.GetMemoryUsage() / 1_MB, cache_budget / 1_MB);
 }
 
 bool Rasterizer::BindResources(const Pipeline* pipeline) {
@@ -487,8 +543,11 @@ bool Rasterizer::BindResources(const Pipeline* pipeline) {
         BindTextures(*stage, binding, set_writes);
     }
 
-    pipeline->BindResources(set_writes, buffer_barriers, push_data);
+    num_descriptors_bound += set_writes.size();
+    num_descriptors_written += pipeline->BindResources(set_writes, buffer_barriers, push_data);
 
+    // Write protect everything the resources of this draw started tracking in one go.
+    page_manager.FlushProtections();
     return true;
 }
 
@@ -642,9 +701,8 @@ void Rasterizer::BindTextures(const Shader::Info& stage, Shader::Backend::Bindin
             continue;
         }
 
-        auto& [image_id, desc] = image_bindings.emplace_back(std::piecewise_construct, std::tuple{},
-                                                             std::tuple{tsharp, image_desc});
-        image_id = texture_cache.FindImage(desc);
+        auto& [image_id, desc] = image_bindings.emplace_back();
+        image_id = texture_cache.FindTextureImage(tsharp, image_desc, desc);
         auto* image = &texture_cache.GetImage(image_id);
         if (image->depth_id) {
             // If this image has an associated depth image, it's a stencil attachment.
@@ -913,6 +971,9 @@ bool Rasterizer::InvalidateMemory(VAddr addr, u64 size) {
     }
     buffer_cache.InvalidateMemory(addr, size);
     texture_cache.InvalidateMemory(addr, size);
+    // Both caches have untracked the range, so GPU data read back to it can land before the
+    // guest write does.
+    buffer_cache.ResolveReadbacks(addr, size);
     return true;
 }
 
@@ -933,89 +994,135 @@ void Rasterizer::MapMemory(VAddr addr, u64 size) {
 void Rasterizer::UnmapMemory(VAddr addr, u64 size) {
     buffer_cache.InvalidateMemory(addr, size);
     texture_cache.UnmapMemory(addr, size);
+    buffer_cache.ResolveReadbacks(addr, size);
     page_manager.OnGpuUnmap(addr, size);
     mapped_ranges -= boost::icl::interval<VAddr>::right_open(addr, addr + size);
 }
 
 void Rasterizer::UpdateDynamicState(const GraphicsPipeline& pipeline) {
-    UpdateViewportScissorState();
+    using DirtyState = Liverpool::DirtyState;
+    if (scheduler.TakeDynamicStateReset()) {
+        // Nothing recorded before is in effect anymore, record everything again.
+        dynamic_state = {};
+        liverpool->dirty_state = DirtyState::All;
+    }
+    // Only state whose registers were written since the last draw can have changed.
+    const auto dirty = std::exchange(liverpool->dirty_state, DirtyState::None);
 
     auto& regs = liverpool->regs;
     const auto cmdbuf = scheduler.CommandBuffer();
-    cmdbuf.setBlendConstants(&regs.blend_constants.red);
+    if (True(dirty & DirtyState::Viewports)) {
+        UpdateViewportScissorState();
+    }
+    if (True(dirty & DirtyState::BlendConstants)) {
+        const auto blend_constants = std::bit_cast<std::array<float, 4>>(regs.blend_constants);
+        if (UpdateState(dynamic_state.blend_constants, blend_constants)) {
+            cmdbuf.setBlendConstants(blend_constants.data());
+            ++num_state_commands;
+        }
+    }
 
     if (instance.IsColorWriteEnableSupported()) {
         const auto& write_masks = pipeline.GetWriteMasks();
-        std::array<vk::Bool32, Liverpool::NumColorBuffers> write_ens{};
-        std::transform(write_masks.cbegin(), write_masks.cend(), write_ens.begin(),
-                       [](auto in) { return in ? vk::True : vk::False; });
-
-        cmdbuf.setColorWriteEnableEXT(write_ens);
-        cmdbuf.setColorWriteMaskEXT(0, write_masks);
-    }
-    if (regs.depth_control.depth_bounds_enable) {
-        cmdbuf.setDepthBounds(regs.depth_bounds_min, regs.depth_bounds_max);
-    }
-    if (regs.polygon_control.enable_polygon_offset_front) {
-        cmdbuf.setDepthBias(regs.poly_offset.front_offset, regs.poly_offset.depth_bias,
-                            regs.poly_offset.front_scale / 16.f);
-    } else if (regs.polygon_control.enable_polygon_offset_back) {
-        cmdbuf.setDepthBias(regs.poly_offset.back_offset, regs.poly_offset.depth_bias,
-                            regs.poly_offset.back_scale / 16.f);
-    }
-
-    if (regs.depth_control.stencil_enable) {
-        const auto front_fail_op =
-            LiverpoolToVK::StencilOp(regs.stencil_control.stencil_fail_front);
-        const auto front_pass_op =
-            LiverpoolToVK::StencilOp(regs.stencil_control.stencil_zpass_front);
-        const auto front_depth_fail_op =
-            LiverpoolToVK::StencilOp(regs.stencil_control.stencil_zfail_front);
-        const auto front_compare_op = LiverpoolToVK::CompareOp(regs.depth_control.stencil_ref_func);
-        if (regs.depth_control.backface_enable) {
-            const auto back_fail_op =
-                LiverpoolToVK::StencilOp(regs.stencil_control.stencil_fail_back);
-            const auto back_pass_op =
-                LiverpoolToVK::StencilOp(regs.stencil_control.stencil_zpass_back);
-            const auto back_depth_fail_op =
-                LiverpoolToVK::StencilOp(regs.stencil_control.stencil_zfail_back);
-            const auto back_compare_op =
-                LiverpoolToVK::CompareOp(regs.depth_control.stencil_bf_func);
-            cmdbuf.setStencilOpEXT(vk::StencilFaceFlagBits::eFront, front_fail_op, front_pass_op,
-                                   front_depth_fail_op, front_compare_op);
-            cmdbuf.setStencilOpEXT(vk::StencilFaceFlagBits::eBack, back_fail_op, back_pass_op,
-                                   back_depth_fail_op, back_compare_op);
-        } else {
-            cmdbuf.setStencilOpEXT(vk::StencilFaceFlagBits::eFrontAndBack, front_fail_op,
-                                   front_pass_op, front_depth_fail_op, front_compare_op);
+        if (UpdateState(dynamic_state.write_masks, write_masks)) {
+            std::array<vk::Bool32, Liverpool::NumColorBuffers> write_ens{};
+            std::transform(write_masks.cbegin(), write_masks.cend(), write_ens.begin(),
+                           [](auto in) { return in ? vk::True : vk::False; });
+
+            cmdbuf.setColorWriteEnableEXT(write_ens);
+            cmdbuf.setColorWriteMaskEXT(0, write_masks);
+            num_state_commands += 2;
         }
-
-        const auto front = regs.stencil_ref_front;
-        const auto back = regs.stencil_ref_back;
-        if (front.stencil_test_val == back.stencil_test_val) {
-            cmdbuf.setStencilReference(vk::StencilFaceFlagBits::eFrontAndBack,
-                                       front.stencil_test_val);
-        } else {
-            cmdbuf.setStencilReference(vk::StencilFaceFlagBits::eFront, front.stencil_test_val);
-            cmdbuf.setStencilReference(vk::StencilFaceFlagBits::eBack, back.stencil_test_val);
+    }
+    if (True(dirty & DirtyState::DepthBounds) && regs.depth_control.depth_bounds_enable) {
+        const std::array depth_bounds = {regs.depth_bounds_min, regs.depth_bounds_max};
+        if (UpdateState(dynamic_state.depth_bounds, depth_bounds)) {
+            cmdbuf.setDepthBounds(depth_bounds[0], depth_bounds[1]);
+            ++num_state_commands;
+        }
+    }
+    if (True(dirty & DirtyState::DepthBias)) {
+        std::optional<std::array<float, 3>> depth_bias;
+        if (regs.polygon_control.enable_polygon_offset_front) {
+            depth_bias = {regs.poly_offset.front_offset, regs.poly_offset.depth_bias,
+                          regs.poly_offset.front_scale / 16.f};
+        } else if (regs.polygon_control.enable_polygon_offset_back) {
+            depth_bias = {regs.poly_offset.back_offset, regs.poly_offset.depth_bias,
+                          regs.poly_offset.back_scale / 16.f};
+        }
+        if (depth_bias && UpdateState(dynamic_state.depth_bias, *depth_bias)) {
+            cmdbuf.setDepthBias((*depth_bias)[0], (*depth_bias)[1], (*depth_bias)[2]);
+            ++num_state_commands;
         }
+    }
+    if (True(dirty & DirtyState::Stencil) && regs.depth_control.stencil_enable) {
+        UpdateStencilState();
+    }
+}
 
-        if (front.stencil_write_mask == back.stencil_write_mask) {
-            cmdbuf.setStencilWriteMask(vk::StencilFaceFlagBits::eFrontAndBack,
-                                       front.stencil_write_mask);
+void Rasterizer::UpdateStencilState() {
+    const auto& regs = liverpool->regs;
+    const auto cmdbuf = scheduler.CommandBuffer();
+    const auto set_per_face = [&](const std::array<u32, 2>& values, auto&& set) {
+        if (values[0] == values[1]) {
+            set(vk::StencilFaceFlagBits::eFrontAndBack, values[0]);
+            ++num_state_commands;
         } else {
-            cmdbuf.setStencilWriteMask(vk::StencilFaceFlagBits::eFront, front.stencil_write_mask);
-            cmdbuf.setStencilWriteMask(vk::StencilFaceFlagBits::eBack, back.stencil_write_mask);
+            set(vk::StencilFaceFlagBits::eFront, values[0]);
+            set(vk::StencilFaceFlagBits::eBack, values[1]);
+            num_state_commands += 2;
         }
+    };
 
-        if (front.stencil_mask == back.stencil_mask) {
-            cmdbuf.setStencilCompareMask(vk::StencilFaceFlagBits::eFrontAndBack,
-                                         front.stencil_mask);
+    std::array<u32, 8> ops = {
+        u32(LiverpoolToVK::StencilOp(regs.stencil_control.stencil_fail_front)),
+        u32(LiverpoolToVK::StencilOp(regs.stencil_control.stencil_zpass_front)),
+        u32(LiverpoolToVK::StencilOp(regs.stencil_control.stencil_zfail_front)),
+        u32(LiverpoolToVK::CompareOp(regs.depth_control.stencil_ref_func)),
+    };
+    if (regs.depth_control.backface_enable) {
+        ops[4] = u32(LiverpoolToVK::StencilOp(regs.stencil_control.stencil_fail_back));
+        ops[5] = u32(LiverpoolToVK::StencilOp(regs.stencil_control.stencil_zpass_back));
+        ops[6] = u32(LiverpoolToVK::StencilOp(regs.stencil_control.stencil_zfail_back));
+        ops[7] = u32(LiverpoolToVK::CompareOp(regs.depth_control.stencil_bf_func));
+    } else {
+        std::copy_n(ops.begin(), 4, ops.begin() + 4);
+    }
+    if (UpdateState(dynamic_state.stencil_ops, ops)) {
+        const auto set_ops = [&](vk::StencilFaceFlags face, const u32* face_ops) {
+            cmdbuf.setStencilOpEXT(face, vk::StencilOp(face_ops[0]), vk::StencilOp(face_ops[1]),
+                                   vk::StencilOp(face_ops[2]), vk::CompareOp(face_ops[3]));
+        };
+        if (std::equal(ops.begin(), ops.begin() + 4, ops.begin() + 4)) {
+            set_ops(vk::StencilFaceFlagBits::eFrontAndBack, ops.data());
+            ++num_state_commands;
         } else {
-            cmdbuf.setStencilCompareMask(vk::StencilFaceFlagBits::eFront, front.stencil_mask);
-            cmdbuf.setStencilCompareMask(vk::StencilFaceFlagBits::eBack, back.stencil_mask);
+            set_ops(vk::StencilFaceFlagBits::eFront, ops.data());
+            set_ops(vk::StencilFaceFlagBits::eBack, ops.data() + 4);
+            num_state_commands += 2;
         }
     }
+
+    const auto front = regs.stencil_ref_front;
+    const auto back = regs.stencil_ref_back;
+    const std::array<u32, 2> reference = {front.stencil_test_val, back.stencil_test_val};
+    if (UpdateState(dynamic_state.stencil_reference, reference)) {
+        set_per_face(reference, [&](vk::StencilFaceFlags face, u32 value) {
+            cmdbuf.setStencilReference(face, value);
+        });
+    }
+    const std::array<u32, 2> write_mask = {front.stencil_write_mask, back.stencil_write_mask};
+    if (UpdateState(dynamic_state.stencil_write_mask, write_mask)) {
+        set_per_face(write_mask, [&](vk::StencilFaceFlags face, u32 value) {
+            cmdbuf.setStencilWriteMask(face, value);
+        });
+    }
+    const std::array<u32, 2> compare_mask = {front.stencil_mask, back.stencil_mask};
+    if (UpdateState(dynamic_state.stencil_compare_mask, compare_mask)) {
+        set_per_face(compare_mask, [&](vk::StencilFaceFlags face, u32 value) {
+            cmdbuf.setStencilCompareMask(face, value);
+        });
+    }
 }
 
 void Rasterizer::UpdateViewportScissorState() {
@@ -1114,8 +1221,14 @@ void Rasterizer::UpdateViewportScissorState() {
     }
 
     const auto cmdbuf = scheduler.CommandBuffer();
-    cmdbuf.setViewportWithCountEXT(viewports);
-    cmdbuf.setScissorWithCountEXT(scissors);
+    if (UpdateState(dynamic_state.viewports, viewports)) {
+        cmdbuf.setViewportWithCountEXT(viewports);
+        ++num_state_commands;
+    }
+    if (UpdateState(dynamic_state.scissors, scissors)) {
+        cmdbuf.setScissorWithCountEXT(scissors);
+        ++num_state_commands;
+    }
 }
 
 void Rasterizer::ScopeMarkerBegin(const std::string_view& str) {
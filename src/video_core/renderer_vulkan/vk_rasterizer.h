@@ -73,8 +73,22 @@ private:
     void Resolve();
     void EliminateFastClear();
 
+    void CollectGarbage();
+
     void UpdateDynamicState(const GraphicsPipeline& pipeline);
     void UpdateViewportScissorState();
+    void UpdateStencilState();
+
+    /// Remembers value as recorded and returns true if it differs from the previous one.
+    template <typename T>
+    bool UpdateState(std::optional<T>& recorded, const T& value) {
+        if (recorded == value) {
+            ++num_state_commands_skipped;
+            return false;
+        }
+        recorded = value;
+        return true;
+    }
 
     bool FilterDraw();
 
@@ -103,6 +117,7 @@ private:
     Core::MemoryManager* memory;
     boost::icl::interval_set<VAddr> mapped_ranges;
     PipelineCache pipeline_cache;
+    u64 cache_budget;
 
     boost::container::static_vector<
         std::pair<VideoCore::ImageId, VideoCore::TextureCache::RenderTargetDesc>, 8>
@@ -115,6 +130,29 @@ private:
 
     Pipeline::DescriptorWrites set_writes;
     Pipeline::BufferBarriers buffer_barriers;
+    u64 num_descriptors_bound{};
+    u64 num_descriptors_written{};
+
+    /// Dynamic state last recorded to the command buffer, empty when it has to be recorded again.
+    struct DynamicState {
+        using Liverpool = AmdGpu::Liverpool;
+        std::optional<boost::container::static_vector<vk::Viewport, Liverpool::NumViewports>>
+            viewports;
+        std::optional<boost::container::static_vector<vk::Rect2D, Liverpool::NumViewports>>
+            scissors;
+        std::optional<std::array<float, 4>> blend_constants;
+        std::optional<std::array<vk::ColorComponentFlags, Liverpool::NumColorBuffers>>
+            write_masks;
+        std::optional<std::array<float, 2>> depth_bounds;
+        std::optional<std::array<float, 3>> depth_bias;
+        std::optional<std::array<u32, 8>> stencil_ops; ///< Front then back face.
+        std::optional<std::array<u32, 2>> stencil_reference;
+        std::optional<std::array<u32, 2>> stencil_write_mask;
+        std::optional<std::array<u32, 2>> stencil_compare_mask;
+    };
+    DynamicState dynamic_state;
+    u64 num_state_commands{};
+    u64 num_state_commands_skipped{};
 
     using BufferBindingInfo = std::pair<VideoCore::BufferId, AmdGpu::Buffer>;
     boost::container::static_vector<BufferBindingInfo, 32> buffer_bindings;
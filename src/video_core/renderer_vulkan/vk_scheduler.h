@@ -4,6 +4,7 @@
 #pragma once
 
 #include <condition_variable>
+#include <utility>
 #include <boost/container/static_vector.hpp>
 #include "common/types.h"
 #include "common/unique_function.h"
@@ -86,6 +87,17 @@ public:
         return current_cmdbuf;
     }
 
+    /// Returns true once after the dynamic state recorded so far was lost, either because the
+    /// command buffer is new or because a pipeline without that state was bound.
+    [[nodiscard]] bool TakeDynamicStateReset() noexcept {
+        return std::exchange(dynamic_state_reset, false);
+    }
+
+    /// Marks the recorded dynamic state as lost, for pipelines that do not make it dynamic.
+    void InvalidateDynamicState() noexcept {
+        dynamic_state_reset = true;
+    }
+
     /// Returns the current command buffer tick.
     [[nodiscard]] u64 CurrentTick() const noexcept {
         return master_semaphore.CurrentTick();
@@ -126,6 +138,7 @@ private:
     std::queue<PendingOp> pending_ops;
     RenderState render_state;
     bool is_rendering = false;
+    bool dynamic_state_reset = true;
     tracy::VkCtxScope* profiler_scope{};
 };
 
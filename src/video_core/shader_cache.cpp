@@ -0,0 +1,257 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <cstring>
+#include <xxhash.h>
+
+#include "common/hash.h"
+#include "common/logging/log.h"
+#include "common/path_util.h"
+#include "common/scm_rev.h"
+#include "common/serdes.h"
+#include "video_core/shader_cache.h"
+
+namespace VideoCore {
+
+namespace {
+
+constexpr u32 CacheMagic = 0x43535053; // SPSC
+
+struct FileHeader {
+    u32 magic;
+    u32 version;
+    u64 device_hash;
+    u64 build_hash;
+};
+
+struct RecordHeader {
+    u32 type;
+    u32 size;
+    u64 id;
+    u64 checksum;
+};
+
+} // Anonymous namespace
+
+ShaderCache::ShaderCache(std::string_view title_id, u64 device_hash_)
+    : device_hash{device_hash_},
+      build_hash{XXH3_64bits(Common::g_scm_rev, std::strlen(Common::g_scm_rev))} {
+    using namespace Common::FS;
+    const auto cache_dir = GetUserPath(PathType::ShaderDir) / "cache";
+    if (!std::filesystem::exists(cache_dir)) {
+        std::filesystem::create_directories(cache_dir);
+    }
+    cache_path = cache_dir / fmt::format("{}.shaders", title_id);
+    pipeline_path = cache_dir / fmt::format("{}.pipelines", title_id);
+    Load();
+}
+
+ShaderCache::~ShaderCache() = default;
+
+const ShaderCache::Program* ShaderCache::FindProgram(u64 pgm_hash) const {
+    const auto it = programs.find(pgm_hash);
+    return it != programs.end() ? &it->second : nullptr;
+}
+
+void ShaderCache::AddProgram(u64 pgm_hash, u64 code_hash, VAddr pgm_base,
+                             std::span<const u8> info) {
+    auto& program = programs[pgm_hash];
+    program.code_hash = code_hash;
+    program.pgm_base = pgm_base;
+    program.info.assign(info.begin(), info.end());
+    program.permutations.clear();
+
+    std::vector<u8> payload;
+    Serialization::Writer writer{payload};
+    writer.Write(code_hash);
+    writer.Write(pgm_base);
+    writer.WriteVector(info);
+    AppendRecord(RecordType::Program, pgm_hash, payload);
+}
+
+void ShaderCache::AddPermutation(u64 pgm_hash, u32 perm_idx, std::span<const u8> spec,
+                                 std::span<const u32> spv) {
+    const auto it = programs.find(pgm_hash);
+    if (it == programs.end() || it->second.permutations.size() != perm_idx) {
+        return;
+    }
+    it.value().permutations.emplace_back(std::vector<u8>{spec.begin(), spec.end()},
+                                         std::vector<u32>{spv.begin(), spv.end()});
+
+    std::vector<u8> payload;
+    Serialization::Writer writer{payload};
+    writer.Write(perm_idx);
+    writer.WriteVector(spec);
+    writer.WriteVector(spv);
+    AppendRecord(RecordType::Permutation, pgm_hash, payload);
+}
+
+void ShaderCache::AddPipelineKey(PipelineType type, std::span<const u8> key) {
+    const u64 key_hash = HashCombine(XXH3_64bits(key.data(), key.size()), u64(type));
+    if (!key_hashes.insert(key_hash).second) {
+        return;
+    }
+    auto& keys = type == PipelineType::Graphics ? graphics_keys : compute_keys;
+    keys.emplace_back(key.begin(), key.end());
+
+    std::vector<u8> payload;
+    Serialization::Writer writer{payload};
+    writer.Write(type);
+    writer.WriteVector(key);
+    AppendRecord(RecordType::PipelineKey, 0, payload);
+}
+
+std::vector<u8> ShaderCache::LoadPipelineData() const {
+    if (!std::filesystem::exists(pipeline_path)) {
+        return {};
+    }
+    const auto pipeline_file = Common::FS::IOFile{pipeline_path, Common::FS::FileAccessMode::Read};
+    FileHeader header{};
+    if (!pipeline_file.ReadObject(header) || header.magic != CacheMagic ||
+        header.version != Version || header.device_hash != device_hash ||
+        header.build_hash != build_hash) {
+        return {};
+    }
+    std::vector<u8> data(pipeline_file.GetSize() - sizeof(FileHeader));
+    pipeline_file.Read(data);
+    return data;
+}
+
+void ShaderCache::SavePipelineData(std::span<const u8> data) const {
+    const auto pipeline_file = Common::FS::IOFile{pipeline_path, Common::FS::FileAccessMode::Write};
+    const FileHeader header = {
+        .magic = CacheMagic,
+        .version = Version,
+        .device_hash = device_hash,
+        .build_hash = build_hash,
+    };
+    pipeline_file.WriteObject(header);
+    pipeline_file.WriteSpan(data);
+}
+
+void ShaderCache::Load() {
+    if (!std::filesystem::exists(cache_path)) {
+        ResetFile();
+        return;
+    }
+
+    std::vector<u8> data;
+    {
+        const auto in_file = Common::FS::IOFile{cache_path, Common::FS::FileAccessMode::Read};
+        data.resize(in_file.GetSize());
+        in_file.Read(data);
+    }
+
+    Serialization::Reader reader{data};
+    FileHeader header{};
+    if (!reader.Read(header) || header.magic != CacheMagic || header.version != Version ||
+        header.device_hash != device_hash || header.build_hash != build_hash) {
+        LOG_INFO(Render, "Shader cache {} is outdated, discarding",
+                 Common::FS::PathToUTF8String(cache_path));
+        ResetFile();
+        return;
+    }
+
+    // Records are appended as they are produced, so a truncated trailing record from an
+    // interrupted session is expected. Loading stops at the first truncated or corrupt record.
+    RecordHeader record{};
+    size_t valid_size = reader.Offset();
+    while (reader.Read(record) && reader.CanRead(record.size)) {
+        std::vector<u8> payload(record.size);
+        reader.ReadRaw(payload.data(), payload.size());
+        if (XXH3_64bits(payload.data(), payload.size()) != record.checksum) {
+            break;
+        }
+        valid_size = reader.Offset();
+        Serialization::Reader record_reader{payload};
+
+        switch (static_cast<RecordType>(record.type)) {
+        case RecordType::Program: {
+            Program program{};
+            record_reader.Read(program.code_hash);
+            record_reader.Read(program.pgm_base);
+            record_reader.ReadVector(program.info);
+            if (!record_reader.Failed()) {
+                programs.insert_or_assign(record.id, std::move(program));
+            }
+            break;
+        }
+        case RecordType::Permutation: {
+            u32 perm_idx{};
+            Permutation perm{};
+            record_reader.Read(perm_idx);
+            record_reader.ReadVector(perm.spec);
+            record_reader.ReadVector(perm.spv);
+            const auto it = programs.find(record.id);
+            if (!record_reader.Failed() && it != programs.end() &&
+                it->second.permutations.size() == perm_idx) {
+                it.value().permutations.emplace_back(std::move(perm));
+            }
+            break;
+        }
+        case RecordType::PipelineKey: {
+            PipelineType type{};
+            std::vector<u8> key;
+            record_reader.Read(type);
+            record_reader.ReadVector(key);
+            const u64 key_hash = HashCombine(XXH3_64bits(key.data(), key.size()), u64(type));
+            if (!record_reader.Failed() && key_hashes.insert(key_hash).second) {
+                auto& keys = type == PipelineType::Graphics ? graphics_keys : compute_keys;
+                keys.emplace_back(std::move(key));
+            }
+            break;
+        }
+        default:
+            LOG_WARNING(Render, "Unknown shader cache record type {}", record.type);
+            break;
+        }
+    }
+
+    LOG_INFO(Render, "Loaded {} programs, {} graphics and {} compute pipeline keys from {}",
+             programs.size(), graphics_keys.size(), compute_keys.size(),
+             Common::FS::PathToUTF8String(cache_path));
+
+    file.Open(cache_path, Common::FS::FileAccessMode::Append);
+    if (valid_size != data.size()) {
+        // Drop the bad tail, records appended after it would be misaligned on the next load.
+        LOG_WARNING(Render, "Shader cache {} has a corrupt tail of {} bytes, truncating",
+                    Common::FS::PathToUTF8String(cache_path), data.size() - valid_size);
+        if (!file.SetSize(valid_size)) {
+            ResetFile();
+        }
+    }
+}
+
+void ShaderCache::ResetFile() {
+    programs.clear();
+    graphics_keys.clear();
+    compute_keys.clear();
+    key_hashes.clear();
+
+    file.Open(cache_path, Common::FS::FileAccessMode::Write);
+    const FileHeader header = {
+        .magic = CacheMagic,
+        .version = Version,
+        .device_hash = device_hash,
+        .build_hash = build_hash,
+    };
+    file.WriteObject(header);
+    file.Flush();
+}
+
+void ShaderCache::AppendRecord(RecordType type, u64 id, std::span<const u8> payload) {
+    if (!file.IsOpen()) {
+        return;
+    }
+    const RecordHeader record = {
+        .type = static_cast<u32>(type),
+        .size = static_cast<u32>(payload.size()),
+        .id = id,
+        .checksum = XXH3_64bits(payload.data(), payload.size()),
+    };
+    file.WriteObject(record);
+    file.WriteSpan(payload);
+    file.Flush();
+}
+
+} // namespace VideoCore
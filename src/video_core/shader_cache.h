@@ -0,0 +1,98 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <tsl/robin_map.h>
+#include <tsl/robin_set.h>
+#include "common/io_file.h"
+#include "common/types.h"
+
+namespace VideoCore {
+
+/**
+ * Persistent storage of recompiled shader programs and pipeline state for a single title.
+ * Programs and permutations are appended to the cache file as soon as they are compiled, so
+ * an abnormal exit only loses the pipeline cache blob that is written on shutdown.
+ * The file is discarded when the format version, emulator build or host device changes.
+ */
+class ShaderCache {
+public:
+    static constexpr u32 Version = 2;
+
+    struct Permutation {
+        std::vector<u8> spec;
+        std::vector<u32> spv;
+    };
+
+    struct Program {
+        u64 code_hash;
+        VAddr pgm_base;
+        std::vector<u8> info;
+        std::vector<Permutation> permutations;
+    };
+
+    enum class PipelineType : u32 {
+        Graphics,
+        Compute,
+    };
+
+    explicit ShaderCache(std::string_view title_id, u64 device_hash);
+    ~ShaderCache();
+
+    /// Returns the stored program for the provided hash, if any.
+    [[nodiscard]] const Program* FindProgram(u64 pgm_hash) const;
+
+    /// Stores analysis results of a newly compiled program.
+    void AddProgram(u64 pgm_hash, u64 code_hash, VAddr pgm_base, std::span<const u8> info);
+
+    /// Stores a compiled permutation of a program previously stored with AddProgram.
+    void AddPermutation(u64 pgm_hash, u32 perm_idx, std::span<const u8> spec,
+                        std::span<const u32> spv);
+
+    /// Stores a pipeline key, unless it was already seen during this or a previous session.
+    void AddPipelineKey(PipelineType type, std::span<const u8> key);
+
+    /// Returns the raw bytes of known pipeline keys of the given type.
+    [[nodiscard]] std::span<const std::vector<u8>> GetPipelineKeys(PipelineType type) const {
+        return type == PipelineType::Graphics ? graphics_keys : compute_keys;
+    }
+
+    /// Returns the driver pipeline cache blob of the previous session.
+    [[nodiscard]] std::vector<u8> LoadPipelineData() const;
+
+    /// Replaces the driver pipeline cache blob.
+    void SavePipelineData(std::span<const u8> data) const;
+
+    [[nodiscard]] size_t NumPrograms() const noexcept {
+        return programs.size();
+    }
+
+private:
+    enum class RecordType : u32 {
+        Program,
+        Permutation,
+        PipelineKey,
+    };
+
+    void Load();
+    void ResetFile();
+    void AppendRecord(RecordType type, u64 id, std::span<const u8> payload);
+
+private:
+    std::filesystem::path cache_path;
+    std::filesystem::path pipeline_path;
+    u64 device_hash;
+    u64 build_hash;
+    Common::FS::IOFile file;
+    tsl::robin_map<u64, Program> programs;
+    std::vector<std::vector<u8>> graphics_keys;
+    std::vector<std::vector<u8>> compute_keys;
+    tsl::robin_set<u64> key_hashes;
+};
+
+} // namespace VideoCore
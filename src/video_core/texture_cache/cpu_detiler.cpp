@@ -0,0 +1,550 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <cstring>
+#include "common/arch.h"
+#include "video_core/texture_cache/cpu_detiler.h"
+
+#ifdef ARCH_X86_64
+#include <immintrin.h>
+#include <xbyak/xbyak_util.h>
+#endif
+
+#if defined(ARCH_X86_64) && (defined(__GNUC__) || defined(__clang__))
+#define DETILER_SSE41 __attribute__((target("sse4.1")))
+#define DETILER_AVX2 __attribute__((target("avx2")))
+#else
+#define DETILER_SSE41
+#define DETILER_AVX2
+#endif
+
+namespace VideoCore {
+
+namespace {
+
+constexpr u32 MicroTileDim = 8;
+constexpr u32 MicroTileElems = MicroTileDim * MicroTileDim;
+constexpr u32 MacroTileElems = MicroTileElems * 4;
+
+/// Micro tiles store their 8x8 elements in Morton order, x in the even index bits.
+constexpr u32 MortonX(u32 index) {
+    return (index & 1) | ((index >> 1) & 2) | ((index >> 2) & 4);
+}
+
+constexpr u32 MortonY(u32 index) {
+    return ((index >> 1) & 1) | ((index >> 2) & 2) | ((index >> 3) & 4);
+}
+
+// Element index within an 8x8x4 thick tile, indexed by [slice % 4][row * 8 + column]. Same
+// tables as the macro detiler shaders, where they are packed four indices to a dword.
+using MacroLut = std::array<std::array<u8, MicroTileElems>, 4>;
+
+constexpr MacroLut UnpackLut(const u32 (&packed)[4][16]) {
+    MacroLut lut{};
+    for (u32 slice = 0; slice < 4; ++slice) {
+        for (u32 i = 0; i < MicroTileElems; ++i) {
+            lut[slice][i] = static_cast<u8>(packed[slice][i / 4] >> (8 * (i % 4)));
+        }
+    }
+    return lut;
+}
+
+constexpr u32 PackedLut8bpp[4][16] = {
+    {0x05040100, 0x45444140, 0x07060302, 0x47464342, 0x0d0c0908, 0x4d4c4948, 0x0f0e0b0a,
+     0x4f4e4b4a, 0x85848180, 0xc5c4c1c0, 0x87868382, 0xc7c6c3c2, 0x8d8c8988, 0xcdccc9c8,
+     0x8f8e8b8a, 0xcfcecbca},
+    {0x15141110, 0x55545150, 0x17161312, 0x57565352, 0x1d1c1918, 0x5d5c5958, 0x1f1e1b1a,
+     0x5f5e5b5a, 0x95949190, 0xd5d4d1d0, 0x97969392, 0xd7d6d3d2, 0x9d9c9998, 0xdddcd9d8,
+     0x9f9e9b9a, 0xdfdedbda},
+    {0x25242120, 0x65646160, 0x27262322, 0x67666362, 0x2d2c2928, 0x6d6c6968, 0x2f2e2b2a,
+     0x6f6e6b6a, 0xa5a4a1a0, 0xe5e4e1e0, 0xa7a6a3a2, 0xe7e6e3e2, 0xadaca9a8, 0xedece9e8,
+     0xafaeabaa, 0xefeeebea},
+    {0x35343130, 0x75747170, 0x37363332, 0x77767372, 0x3d3c3938, 0x7d7c7978, 0x3f3e3b3a,
+     0x7f7e7b7a, 0xb5b4b1b0, 0xf5f4f1f0, 0xb7b6b3b2, 0xf7f6f3f2, 0xbdbcb9b8, 0xfdfcf9f8,
+     0xbfbebbba, 0xfffefbfa},
+};
+
+constexpr u32 PackedLut32bpp[4][16] = {
+    {0x05040100, 0x45444140, 0x07060302, 0x47464342, 0x15141110, 0x55545150, 0x17161312,
+     0x57565352, 0x85848180, 0xc5c4c1c0, 0x87868382, 0xc7c6c3c2, 0x95949190, 0xd5d4d1d0,
+     0x97969392, 0xd7d6d3d2},
+    {0x0d0c0908, 0x4d4c4948, 0x0f0e0b0a, 0x4f4e4b4a, 0x1d1c1918, 0x5d5c5958, 0x1f1e1b1a,
+     0x5f5e5b5a, 0x8d8c8988, 0xcdccc9c8, 0x8f8e8b8a, 0xcfcecbca, 0x9d9c9998, 0xdddcd9d8,
+     0x9f9e9b9a, 0xdfdedbda},
+    {0x25242120, 0x65646160, 0x27262322, 0x67666362, 0x35343130, 0x75747170, 0x37363332,
+     0x77767372, 0xa5a4a1a0, 0xe5e4e1e0, 0xa7a6a3a2, 0xe7e6e3e2, 0xb5b4b1b0, 0xf5f4f1f0,
+     0xb7b6b3b2, 0xf7f6f3f2},
+    {0x2d2c2928, 0x6d6c6968, 0x2f2e2b2a, 0x6f6e6b6a, 0x3d3c3938, 0x7d7c7978, 0x3f3e3b3a,
+     0x7f7e7b7a, 0xadaca9a8, 0xedece9e8, 0xafaeabaa, 0xefeeebea, 0xbdbcb9b8, 0xfdfcf9f8,
+     0xbfbebbba, 0xfffefbfa},
+};
+
+constexpr u32 PackedLut64bpp[4][16] = {
+    {0x09080100, 0x49484140, 0x0b0a0302, 0x4a4b4342, 0x19181110, 0x59585150, 0x1b1a1312,
+     0x5a5b5352, 0x89888180, 0xc9c8c1c0, 0x8b8a8382, 0xcacbc3c2, 0x99989190, 0xd9d8d1d0,
+     0x9b9a9392, 0xdbdad3d2},
+    {0x0d0c0504, 0x4d4c4544, 0x0f0e0706, 0x4f4e4746, 0x1d1c1514, 0x5d5c5554, 0x1f1e1716,
+     0x5f5e5756, 0x8d8c8584, 0xcdccc5c4, 0x8f8e8786, 0xcfcec7c6, 0x9d9c9594, 0xdddcd5d4,
+     0x9f9e9796, 0xdfded7d6},
+    {0x29282120, 0x69686160, 0x2b2a2322, 0x6b6a6362, 0x39383130, 0x79787170, 0x3b3a3332,
+     0x7b7a7372, 0xa9a8a1a0, 0xe9e8e1e0, 0xabaaa3a2, 0xebeae3e2, 0xb9b8b1b0, 0xf9f8f1f0,
+     0xbbbab3b2, 0xfbfaf3f2},
+    {0x2d2c2524, 0x6d6c6564, 0x2f2e2726, 0x6f6e6766, 0x3d3c3534, 0x7d7c7574, 0x3f3e3736,
+     0x7f7e7776, 0xadaca5a4, 0xedece5e4, 0xafaea7a6, 0xefeee7e6, 0xbdbcb5b4, 0xfdfcf5f4,
+     0xbfbeb7b6, 0xfffef7f6},
+};
+
+constexpr MacroLut Lut8bpp = UnpackLut(PackedLut8bpp);
+constexpr MacroLut Lut32bpp = UnpackLut(PackedLut32bpp);
+constexpr MacroLut Lut64bpp = UnpackLut(PackedLut64bpp);
+
+const MacroLut& GetMacroLut(u32 bytes) {
+    switch (bytes) {
+    case 1:
+        return Lut8bpp;
+    case 4:
+        return Lut32bpp;
+    default:
+        return Lut64bpp;
+    }
+}
+
+// Horizontal pairs of elements are contiguous in both tiled layouts, which lets most kernels move
+// two elements at once. The 64bpp table swaps a few neighbours, so it is read one element at a
+// time.
+constexpr bool HasContiguousPairs(const MacroLut& lut) {
+    for (const auto& slice : lut) {
+        for (u32 i = 0; i < MicroTileElems; i += 2) {
+            if (slice[i + 1] != slice[i] + 1) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+static_assert(HasContiguousPairs(Lut8bpp) && HasContiguousPairs(Lut32bpp));
+
+/// Writes one micro tile to `dst`, which points at its top left element in the output.
+using MicroKernel = void (*)(u8* dst, size_t row_pitch, const u8* src);
+
+/// Writes a row of 8 elements of a thick tile, `index` holds the tile element of each column.
+using MacroKernel = void (*)(u8* dst, const u8* tile, const u8* index);
+
+template <u32 Bytes>
+void MicroTileGeneric(u8* dst, size_t row_pitch, const u8* src) {
+    for (u32 i = 0; i < MicroTileElems; i += 2) {
+        std::memcpy(dst + MortonY(i) * row_pitch + MortonX(i) * Bytes, src + i * Bytes,
+                    Bytes * 2);
+    }
+}
+
+template <u32 Bytes>
+void MacroRowGeneric(u8* dst, const u8* tile, const u8* index) {
+    constexpr u32 Step = Bytes == 8 ? 1 : 2;
+    for (u32 col = 0; col < MicroTileDim; col += Step) {
+        std::memcpy(dst + col * Bytes, tile + index[col] * Bytes, Bytes * Step);
+    }
+}
+
+#ifdef ARCH_X86_64
+
+DETILER_SSE41 inline __m128i Load128(const u8* src) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+DETILER_SSE41 inline void Store128(u8* dst, __m128i value) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+}
+
+DETILER_SSE41 inline void StoreLow64(u8* dst, __m128i value) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), value);
+}
+
+DETILER_SSE41 inline void StoreHigh64(u8* dst, __m128i value) {
+    _mm_storeh_pd(reinterpret_cast<double*>(dst), _mm_castsi128_pd(value));
+}
+
+DETILER_AVX2 inline __m256i Load256(const u8* src) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+}
+
+DETILER_AVX2 inline void Store256(u8* dst, __m256i value) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), value);
+}
+
+// 16 byte chunks of an 8bpp tile hold a 4x4 block, this shuffle turns one into four 4 element
+// rows.
+#define DETILER_ROWS_OF_4X4 0, 1, 4, 5, 2, 3, 6, 7, 8, 9, 12, 13, 10, 11, 14, 15
+
+DETILER_SSE41 void MicroTile8Sse41(u8* dst, size_t row_pitch, const u8* src) {
+    const __m128i rows_of_4x4 = _mm_setr_epi8(DETILER_ROWS_OF_4X4);
+    for (u32 y = 0; y < MicroTileDim; y += 4) {
+        const __m128i left = _mm_shuffle_epi8(Load128(src), rows_of_4x4);
+        const __m128i right = _mm_shuffle_epi8(Load128(src + 16), rows_of_4x4);
+        const __m128i rows01 = _mm_unpacklo_epi32(left, right);
+        const __m128i rows23 = _mm_unpackhi_epi32(left, right);
+        StoreLow64(dst, rows01);
+        StoreHigh64(dst + row_pitch, rows01);
+        StoreLow64(dst + row_pitch * 2, rows23);
+        StoreHigh64(dst + row_pitch * 3, rows23);
+        src += 32;
+        dst += row_pitch * 4;
+    }
+}
+
+DETILER_SSE41 void MicroTile16Sse41(u8* dst, size_t row_pitch, const u8* src) {
+    // Each chunk holds two rows of 4 elements, with the element pairs interleaved by row.
+    for (u32 y = 0; y < MicroTileDim; y += 2) {
+        const u8* chunk = src + ((y & 2) >> 1) * 16 + (y & 4) * 16;
+        const __m128i left = _mm_shuffle_epi32(Load128(chunk), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m128i right = _mm_shuffle_epi32(Load128(chunk + 32), _MM_SHUFFLE(3, 1, 2, 0));
+        Store128(dst + y * row_pitch, _mm_unpacklo_epi64(left, right));
+        Store128(dst + (y + 1) * row_pitch, _mm_unpackhi_epi64(left, right));
+    }
+}
+
+DETILER_SSE41 void MicroTile32Sse41(u8* dst, size_t row_pitch, const u8* src) {
+    // Each chunk holds a 2x2 block, two horizontally adjacent chunks make two rows.
+    for (u32 y = 0; y < MicroTileDim; y += 2) {
+        const u8* chunks = src + ((y & 2) >> 1) * 32 + (y & 4) * 32;
+        for (u32 x = 0; x < 2; ++x) {
+            const __m128i left = Load128(chunks + x * 64);
+            const __m128i right = Load128(chunks + x * 64 + 16);
+            Store128(dst + y * row_pitch + x * 16, _mm_unpacklo_epi64(left, right));
+            Store128(dst + (y + 1) * row_pitch + x * 16, _mm_unpackhi_epi64(left, right));
+        }
+    }
+}
+
+DETILER_SSE41 void MicroTile64Sse41(u8* dst, size_t row_pitch, const u8* src) {
+    for (u32 i = 0; i < MicroTileElems; i += 2) {
+        Store128(dst + MortonY(i) * row_pitch + MortonX(i) * 8, Load128(src + i * 8));
+    }
+}
+
+DETILER_SSE41 void MicroTile128Sse41(u8* dst, size_t row_pitch, const u8* src) {
+    for (u32 i = 0; i < MicroTileElems; i += 2) {
+        u8* const pair = dst + MortonY(i) * row_pitch + MortonX(i) * 16;
+        Store128(pair, Load128(src + i * 16));
+        Store128(pair + 16, Load128(src + i * 16 + 16));
+    }
+}
+
+DETILER_SSE41 void MacroRow32Sse41(u8* dst, const u8* tile, const u8* index) {
+    const auto load_pair = [tile](u8 elem) {
+        return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(tile + elem * 4));
+    };
+    Store128(dst, _mm_unpacklo_epi64(load_pair(index[0]), load_pair(index[2])));
+    Store128(dst + 16, _mm_unpacklo_epi64(load_pair(index[4]), load_pair(index[6])));
+}
+
+DETILER_SSE41 void MacroRow64Sse41(u8* dst, const u8* tile, const u8* index) {
+    for (u32 col = 0; col < MicroTileDim; col += 2) {
+        const __m128d low = _mm_castsi128_pd(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(tile + index[col] * 8)));
+        const __m128d pair =
+            _mm_loadh_pd(low, reinterpret_cast<const double*>(tile + index[col + 1] * 8));
+        Store128(dst + col * 8, _mm_castpd_si128(pair));
+    }
+}
+
+DETILER_AVX2 void MicroTile8Avx2(u8* dst, size_t row_pitch, const u8* src) {
+    const __m256i rows_of_4x4 = _mm256_setr_epi8(DETILER_ROWS_OF_4X4, DETILER_ROWS_OF_4X4);
+    const __m256i interleave = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    for (u32 y = 0; y < MicroTileDim; y += 4) {
+        const __m256i rows = _mm256_permutevar8x32_epi32(
+            _mm256_shuffle_epi8(Load256(src), rows_of_4x4), interleave);
+        const __m128i rows01 = _mm256_castsi256_si128(rows);
+        const __m128i rows23 = _mm256_extracti128_si256(rows, 1);
+        StoreLow64(dst, rows01);
+        StoreHigh64(dst + row_pitch, rows01);
+        StoreLow64(dst + row_pitch * 2, rows23);
+        StoreHigh64(dst + row_pitch * 3, rows23);
+        src += 32;
+        dst += row_pitch * 4;
+    }
+}
+
+DETILER_AVX2 void MicroTile16Avx2(u8* dst, size_t row_pitch, const u8* src) {
+    for (u32 y = 0; y < MicroTileDim; y += 4) {
+        const __m256i left = _mm256_shuffle_epi32(Load256(src), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256i right = _mm256_shuffle_epi32(Load256(src + 32), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256i rows02 = _mm256_unpacklo_epi64(left, right);
+        const __m256i rows13 = _mm256_unpackhi_epi64(left, right);
+        Store128(dst, _mm256_castsi256_si128(rows02));
+        Store128(dst + row_pitch, _mm256_castsi256_si128(rows13));
+        Store128(dst + row_pitch * 2, _mm256_extracti128_si256(rows02, 1));
+        Store128(dst + row_pitch * 3, _mm256_extracti128_si256(rows13, 1));
+        src += 64;
+        dst += row_pitch * 4;
+    }
+}
+
+DETILER_AVX2 void MicroTile32Avx2(u8* dst, size_t row_pitch, const u8* src) {
+    for (u32 y = 0; y < MicroTileDim; y += 2) {
+        const u8* chunks = src + ((y & 2) >> 1) * 32 + (y & 4) * 32;
+        const __m256i left = _mm256_permute4x64_epi64(Load256(chunks), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256i right =
+            _mm256_permute4x64_epi64(Load256(chunks + 64), _MM_SHUFFLE(3, 1, 2, 0));
+        Store256(dst + y * row_pitch, _mm256_permute2x128_si256(left, right, 0x20));
+        Store256(dst + (y + 1) * row_pitch, _mm256_permute2x128_si256(left, right, 0x31));
+    }
+}
+
+DETILER_AVX2 void MicroTile64Avx2(u8* dst, size_t row_pitch, const u8* src) {
+    // Each 32 byte chunk holds a 2x2 block, two horizontally adjacent chunks make two rows.
+    for (u32 y = 0; y < MicroTileDim; y += 2) {
+        const u8* chunks = src + ((y & 2) >> 1) * 64 + (y & 4) * 64;
+        for (u32 x = 0; x < 2; ++x) {
+            const __m256i left = Load256(chunks + x * 128);
+            const __m256i right = Load256(chunks + x * 128 + 32);
+            Store256(dst + y * row_pitch + x * 32, _mm256_permute2x128_si256(left, right, 0x20));
+            Store256(dst + (y + 1) * row_pitch + x * 32,
+                     _mm256_permute2x128_si256(left, right, 0x31));
+        }
+    }
+}
+
+DETILER_AVX2 void MicroTile128Avx2(u8* dst, size_t row_pitch, const u8* src) {
+    for (u32 i = 0; i < MicroTileElems; i += 2) {
+        Store256(dst + MortonY(i) * row_pitch + MortonX(i) * 16, Load256(src + i * 16));
+    }
+}
+
+DETILER_AVX2 void MacroRow32Avx2(u8* dst, const u8* tile, const u8* index) {
+    const __m128i offsets = _mm_setr_epi32(index[0] * 4, index[2] * 4, index[4] * 4, index[6] * 4);
+    Store256(dst, _mm256_i32gather_epi64(reinterpret_cast<const long long*>(tile), offsets, 1));
+}
+
+DETILER_AVX2 void MacroRow64Avx2(u8* dst, const u8* tile, const u8* index) {
+    const auto* base = reinterpret_cast<const long long*>(tile);
+    for (u32 col = 0; col < MicroTileDim; col += 4) {
+        const __m128i offsets = _mm_setr_epi32(index[col] * 8, index[col + 1] * 8,
+                                               index[col + 2] * 8, index[col + 3] * 8);
+        Store256(dst + col * 8, _mm256_i32gather_epi64(base, offsets, 1));
+    }
+}
+
+#undef DETILER_ROWS_OF_4X4
+
+#endif
+
+MicroKernel GetMicroKernel(u32 bytes, DetilerIsa isa) {
+#ifdef ARCH_X86_64
+    if (isa == DetilerIsa::Avx2) {
+        switch (bytes) {
+        case 1:
+            return &MicroTile8Avx2;
+        case 2:
+            return &MicroTile16Avx2;
+        case 4:
+            return &MicroTile32Avx2;
+        case 8:
+            return &MicroTile64Avx2;
+        default:
+            return &MicroTile128Avx2;
+        }
+    }
+    if (isa == DetilerIsa::Sse41) {
+        switch (bytes) {
+        case 1:
+            return &MicroTile8Sse41;
+        case 2:
+            return &MicroTile16Sse41;
+        case 4:
+            return &MicroTile32Sse41;
+        case 8:
+            return &MicroTile64Sse41;
+        default:
+            return &MicroTile128Sse41;
+        }
+    }
+#endif
+    switch (bytes) {
+    case 1:
+        return &MicroTileGeneric<1>;
+    case 2:
+        return &MicroTileGeneric<2>;
+    case 4:
+        return &MicroTileGeneric<4>;
+    case 8:
+        return &MicroTileGeneric<8>;
+    default:
+        return &MicroTileGeneric<16>;
+    }
+}
+
+MacroKernel GetMacroKernel(u32 bytes, DetilerIsa isa) {
+#ifdef ARCH_X86_64
+    if (isa == DetilerIsa::Avx2 && bytes != 1) {
+        return bytes == 4 ? &MacroRow32Avx2 : &MacroRow64Avx2;
+    }
+    if (isa == DetilerIsa::Sse41 && bytes != 1) {
+        return bytes == 4 ? &MacroRow32Sse41 : &MacroRow64Sse41;
+    }
+#endif
+    // Pairs of 8bpp elements are too narrow to gain anything from vector registers.
+    switch (bytes) {
+    case 1:
+        return &MacroRowGeneric<1>;
+    case 4:
+        return &MacroRowGeneric<4>;
+    default:
+        return &MacroRowGeneric<8>;
+    }
+}
+
+/// Copies a single pair of elements, dropping any part that falls outside of the output.
+void WriteClipped(std::span<u8> out, u64 offset, const u8* src, u32 size) {
+    if (offset >= out.size()) {
+        return;
+    }
+    std::memcpy(out.data() + offset, src, std::min<u64>(size, out.size() - offset));
+}
+
+/// Reads a dword of the input the way a shader does with robust buffer access.
+u32 ReadDword(std::span<const u8> in, u64 dword) {
+    u32 value = 0;
+    if ((dword + 1) * 4 <= in.size()) {
+        std::memcpy(&value, in.data() + dword * 4, sizeof(value));
+    }
+    return value;
+}
+
+} // Anonymous namespace
+
+DetilerIsa GetHostDetilerIsa() {
+#ifdef ARCH_X86_64
+    static const DetilerIsa isa = [] {
+        using Xbyak::util::Cpu;
+        Cpu cpu;
+        if (cpu.has(Cpu::tAVX2)) {
+            return DetilerIsa::Avx2;
+        }
+        if (cpu.has(Cpu::tSSE41)) {
+            return DetilerIsa::Sse41;
+        }
+        return DetilerIsa::Generic;
+    }();
+    return isa;
+#else
+    return DetilerIsa::Generic;
+#endif
+}
+
+bool IsDetilerSupported(const MicroTileLayout& layout) {
+    switch (layout.bpp) {
+    case 8:
+    case 16:
+    case 32:
+    case 64:
+    case 128:
+        return layout.num_levels <= layout.level_ends.size();
+    default:
+        return false;
+    }
+}
+
+bool IsDetilerSupported(const MacroTileLayout& layout) {
+    return (layout.bpp == 8 || layout.bpp == 32 || layout.bpp == 64) && layout.pitch != 0 &&
+           layout.height != 0;
+}
+
+void DetileMicro(const MicroTileLayout& layout, std::span<u8> out, std::span<const u8> in,
+                 u32 first_tile, u32 num_tiles, DetilerIsa isa, u64 out_offset) {
+    const u32 bytes = layout.bpp / 8;
+    const u32 tile_size = MicroTileElems * bytes;
+    const MicroKernel kernel = GetMicroKernel(bytes, isa);
+    const u32 end_tile = std::min<u64>(u64(first_tile) + num_tiles, in.size() / tile_size);
+    for (u32 tile = first_tile; tile < end_tile; ++tile) {
+        // The shaders pick the level from the position in the input but keep using the index of
+        // the tile in the whole image, which lands each level right after the previous one.
+        const u64 tile_offset = u64(tile) * tile_size;
+        u32 level = 0;
+        for (u32 m = 0; m < layout.num_levels; ++m) {
+            level += tile_offset >= layout.level_ends[m] ? 1 : 0;
+        }
+        const u32 tiles_per_row = std::max((layout.pitch >> level) / MicroTileDim, 1U);
+        const u64 tile_x = tile % tiles_per_row;
+        const u64 tile_y = tile / tiles_per_row;
+        const u64 row_elems = u64(tiles_per_row) * MicroTileDim;
+        const u64 dst_offset = (tile_y * row_elems * MicroTileDim + tile_x * MicroTileDim) * bytes;
+        const size_t row_pitch = row_elems * bytes;
+        const u8* src = in.data() + tile_offset;
+        const u64 dst_end = dst_offset + row_pitch * (MicroTileDim - 1) + MicroTileDim * bytes;
+        if (dst_offset >= out_offset && dst_end - out_offset <= out.size()) {
+            kernel(out.data() + (dst_offset - out_offset), row_pitch, src);
+            continue;
+        }
+        for (u32 i = 0; i < MicroTileElems; i += 2) {
+            const u64 offset = dst_offset + MortonY(i) * row_pitch + MortonX(i) * bytes;
+            if (offset >= out_offset) {
+                WriteClipped(out, offset - out_offset, src + i * bytes, bytes * 2);
+            }
+        }
+    }
+}
+
+void DetileMacro(const MacroTileLayout& layout, std::span<u8> out, std::span<const u8> in,
+                 u32 first_elem, u32 num_elems, DetilerIsa isa) {
+    const u32 bytes = layout.bpp / 8;
+    const u32 tile_size = MacroTileElems * bytes;
+    const MacroLut& lut = GetMacroLut(bytes);
+    const MacroKernel kernel = GetMacroKernel(bytes, isa);
+    const u64 slice_elems = u64(layout.pitch) * layout.height;
+    const u32 end_elem =
+        std::min<u64>(u64(first_elem) + num_elems, (out.size() + bytes - 1) / bytes);
+
+    const auto tile_offset = [&](u64 x, u64 y, u64 z) {
+        return ((z >> 2) * layout.tiles_per_slice +
+                (y / MicroTileDim) * layout.tiles_per_row + x / MicroTileDim) *
+               tile_size;
+    };
+    const auto detile_elem = [&](u32 elem) {
+        const u64 x = elem % layout.pitch;
+        const u64 y = (elem / layout.pitch) % layout.height;
+        const u64 z = elem / slice_elems;
+        // Like the shaders, take the byte of the packed table entry from the element index
+        // rather than the column, they only differ for pitches that are not a multiple of 4.
+        const u32 entry = ((x % MicroTileDim) + (y % MicroTileDim) * MicroTileDim) & ~3U;
+        const u32 index = lut[z & 3][entry + (elem & 3)];
+        const u64 offset = tile_offset(x, y, z) + index * bytes;
+        if (bytes == 1) {
+            out[elem] = static_cast<u8>(ReadDword(in, offset >> 2) >> ((offset & 3) * 8));
+            return;
+        }
+        for (u32 dword = 0; dword < bytes / 4; ++dword) {
+            const u32 value = ReadDword(in, (offset >> 2) + dword);
+            WriteClipped(out, u64(elem) * bytes + dword * 4, reinterpret_cast<const u8*>(&value),
+                         sizeof(value));
+        }
+    };
+
+    u32 elem = first_elem;
+    if (layout.pitch % MicroTileDim == 0) {
+        for (; elem < end_elem && elem % MicroTileDim != 0; ++elem) {
+            detile_elem(elem);
+        }
+        const u32 end_whole = std::min<u64>(end_elem, out.size() / bytes);
+        for (; elem + MicroTileDim <= end_whole; elem += MicroTileDim) {
+            const u64 x = elem % layout.pitch;
+            const u64 y = (elem / layout.pitch) % layout.height;
+            const u64 z = elem / slice_elems;
+            const u64 offset = tile_offset(x, y, z);
+            if (offset + tile_size > in.size()) {
+                for (u32 col = 0; col < MicroTileDim; ++col) {
+                    detile_elem(elem + col);
+                }
+                continue;
+            }
+            kernel(out.data() + u64(elem) * bytes, in.data() + offset,
+                   &lut[z & 3][(y % MicroTileDim) * MicroTileDim]);
+        }
+    }
+    for (; elem < end_elem; ++elem) {
+        detile_elem(elem);
+    }
+}
+
+} // namespace VideoCore
@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <span>
+#include "common/types.h"
+
+namespace VideoCore {
+
+/// Instruction set extensions the CPU detiler kernels are compiled for.
+enum class DetilerIsa : u32 {
+    Generic,
+    Sse41,
+    Avx2,
+};
+
+/// Returns the widest instruction set supported by the host CPU.
+[[nodiscard]] DetilerIsa GetHostDetilerIsa();
+
+/// Layout of a micro tiled image, mirrors the push constants of the micro_* detilers.
+struct MicroTileLayout {
+    u32 bpp;                        ///< Bits per element, 8 to 128.
+    u32 pitch;                      ///< Pitch of the first level in elements.
+    u32 num_levels;                 ///< Number of mip levels.
+    std::array<u32, 14> level_ends; ///< End byte offset of each level, all layers included.
+};
+
+/// Layout of a thick tiled volume, mirrors the push constants of the macro_* detilers.
+struct MacroTileLayout {
+    u32 bpp;             ///< Bits per element, 8, 32 or 64.
+    u32 pitch;           ///< Row pitch of the output in elements.
+    u32 height;          ///< Number of rows of a slice.
+    u32 tiles_per_row;   ///< Number of 8x8x4 tiles in a row of tiles.
+    u32 tiles_per_slice; ///< Number of 8x8x4 tiles in a slice of tiles.
+};
+
+/// Returns true if the detiler has kernels for the given layout.
+[[nodiscard]] bool IsDetilerSupported(const MicroTileLayout& layout);
+[[nodiscard]] bool IsDetilerSupported(const MacroTileLayout& layout);
+
+/// Detiles the 8x8 micro tiles [first_tile, first_tile + num_tiles) of the image in `in`.
+/// Output is byte identical to the micro_* compute shaders, including writes past the end of
+/// the output being dropped. `out` receives the detiled image from byte `out_offset` onwards.
+void DetileMicro(const MicroTileLayout& layout, std::span<u8> out, std::span<const u8> in,
+                 u32 first_tile, u32 num_tiles, DetilerIsa isa, u64 out_offset = 0);
+
+/// Detiles the output elements [first_elem, first_elem + num_elems) of the volume in `in`.
+/// Output is byte identical to the macro_* compute shaders, elements read from past the end of
+/// the input are zero.
+void DetileMacro(const MacroTileLayout& layout, std::span<u8> out, std::span<const u8> in,
+                 u32 first_elem, u32 num_elems, DetilerIsa isa);
+
+} // namespace VideoCore
@@ -10,6 +10,7 @@
 #include "video_core/texture_cache/image_view.h"
 
 #include <optional>
+#include <vector>
 
 namespace Vulkan {
 class Instance;
@@ -26,7 +27,8 @@ enum ImageFlagBits : u32 {
     MaybeCpuDirty = 1 << 0, ///< The page this image is in was touched before the image address
     CpuDirty = 1 << 1,      ///< Contents have been modified from the CPU
     GpuDirty = 1 << 2, ///< Contents have been modified from the GPU (valid data in buffer cache)
-    Dirty = MaybeCpuDirty | CpuDirty | GpuDirty,
+    CpuDirtyPages = 1 << 4, ///< Some pages have been modified from the CPU, see dirty_pages
+    Dirty = MaybeCpuDirty | CpuDirty | GpuDirty | CpuDirtyPages,
     GpuModified = 1 << 3,    ///< Contents have been modified from the GPU
     Registered = 1 << 6,     ///< True when the image is registered
     Picked = 1 << 7,         ///< Temporary flag to mark the image as picked
@@ -110,6 +112,12 @@ struct Image {
         return track_addr != 0 && track_addr_end != 0;
     }
 
+    /// Returns true if the page with the given index, counted from the first page of the image,
+    /// was written by the CPU since the last upload.
+    bool IsPageDirty(u64 page) const {
+        return page / 64 < dirty_pages.size() && ((dirty_pages[page / 64] >> (page % 64)) & 1);
+    }
+
     const Vulkan::Instance* instance;
     Vulkan::Scheduler* scheduler;
     ImageInfo info;
@@ -142,7 +150,14 @@ struct Image {
     std::vector<State> subresource_states{};
     boost::container::small_vector<u64, 14> mip_hashes{};
     u64 tick_accessed_last{0};
+    size_t lru_id{};
     u64 hash{0};
+    // Pages written by the CPU since the last upload, one bit per page. They are untracked one by
+    // one while the rest of the image stays write protected. page_hashes holds the contents of
+    // every dirty page from just before its first write.
+    std::vector<u64> dirty_pages;
+    std::vector<u64> page_hashes;
+    u32 num_dirty_pages{};
 
     struct {
         union {
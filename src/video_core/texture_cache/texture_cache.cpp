@@ -1,11 +1,19 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <algorithm>
+#include <bit>
+#include <cstring>
 #include <optional>
+#include <tuple>
 #include <xxhash.h>
 
+#include "common/alignment.h"
 #include "common/assert.h"
+#include "common/config.h"
 #include "common/debug.h"
+#include "common/div_ceil.h"
+#include "common/hash.h"
 #include "video_core/buffer_cache/buffer_cache.h"
 #include "video_core/page_manager.h"
 #include "video_core/renderer_vulkan/vk_instance.h"
@@ -18,6 +26,41 @@ namespace VideoCore {
 
 static constexpr u64 PageShift = 12;
 static constexpr u64 NumFramesBeforeRemoval = 32;
+static constexpr u64 MinPageTrackedSize = 64_KB;
+
+/// Calls func(begin, end) for every run of pages in [first, last) whose dirty bit matches dirty.
+template <typename Func>
+static void ForEachPageRun(const Image& image, u64 first, u64 last, bool dirty, Func&& func) {
+    u64 run_begin = first;
+    for (u64 page = first; page < last; ++page) {
+        if (image.IsPageDirty(page) != dirty) {
+            if (run_begin < page) {
+                func(run_begin, page);
+            }
+            run_begin = page + 1;
+        }
+    }
+    if (run_begin < last) {
+        func(run_begin, last);
+    }
+}
+
+/// Returns the guest address range of a page of the image, clipped to the image.
+static std::pair<VAddr, VAddr> GetPageBounds(const ImageInfo& info, u64 page) {
+    const VAddr image_end = info.guest_address + info.guest_size;
+    const VAddr page_begin = ((info.guest_address >> PageShift) + page) << PageShift;
+    return {std::max(page_begin, info.guest_address),
+            std::min(page_begin + (1ULL << PageShift), image_end)};
+}
+
+/// Forgets about a dirty page that leaves the tracked range, the image is refreshed whole instead.
+static void DropDirtyPage(Image& image, u64 page) {
+    image.dirty_pages[page / 64] &= ~(1ULL << (page % 64));
+    image.flags |= ImageFlagBits::CpuDirty;
+    if (--image.num_dirty_pages == 0) {
+        image.flags &= ~ImageFlagBits::CpuDirtyPages;
+    }
+}
 
 TextureCache::TextureCache(const Vulkan::Instance& instance_, Vulkan::Scheduler& scheduler_,
                            BufferCache& buffer_cache_, PageManager& tracker_)
@@ -58,6 +101,100 @@ void TextureCache::MarkAsMaybeDirty(ImageId image_id, Image& image) {
     UntrackImage(image_id);
 }
 
+bool TextureCache::IsPageTrackable(const ImageInfo& info) const {
+    // Rows of linear and micro tiled images are stored in order, so a written page maps to a
+    // band of rows that can be uploaded on its own.
+    if (info.guest_size < MinPageTrackedSize || info.num_samples > 1 || info.props.is_block ||
+        info.props.is_volume || info.num_bits % 8 != 0) {
+        return false;
+    }
+    const bool is_tiled = info.props.is_tiled;
+    if (is_tiled && (!Config::isCpuDetilerEnabled() ||
+                     info.tiling_mode != AmdGpu::TilingMode::Texture_MicroTiled ||
+                     !tile_manager.CanDetileOnCpu(info))) {
+        return false;
+    }
+    const u32 num_layers = info.resources.layers;
+    for (u32 m = 0; m < info.resources.levels; ++m) {
+        const auto& mip = info.mips_layout[m];
+        // Every layer of every level has to start on a band of rows, which is a row of tiles
+        // for micro tiled images.
+        const u64 band_size = u64(mip.pitch) * info.num_bits / 8 * (is_tiled ? 8 : 1);
+        if (band_size == 0 || mip.size % band_size != 0 ||
+            (u64(mip.offset) * num_layers) % band_size != 0) {
+            return false;
+        }
+        if (is_tiled && mip.pitch != std::max((info.pitch >> m) / 8, 1u) * 8) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TextureCache::MarkPagesDirty(Image& image, VAddr addr, size_t size) {
+    if (!image.IsTracked() ||
+        True(image.flags & (ImageFlagBits::MaybeCpuDirty | ImageFlagBits::CpuDirty |
+                            ImageFlagBits::GpuDirty)) ||
+        !IsPageTrackable(image.info)) {
+        return false;
+    }
+    const VAddr image_begin = image.info.guest_address;
+    const VAddr image_end = image_begin + image.info.guest_size;
+    const VAddr begin = std::max(addr, image_begin);
+    const VAddr end = std::min(addr + size, image_end);
+    // Writes outside of the tracked range may have gone unnoticed.
+    if (begin < image.track_addr || end > image.track_addr_end) {
+        return false;
+    }
+    const u64 base_page = image_begin >> PageShift;
+    const u64 num_pages = ((image_end - 1) >> PageShift) - base_page + 1;
+    const u64 first = (begin >> PageShift) - base_page;
+    const u64 last = ((end - 1) >> PageShift) - base_page + 1;
+    u64 num_new_pages = 0;
+    for (u64 page = first; page < last; ++page) {
+        num_new_pages += !image.IsPageDirty(page);
+    }
+    if (num_new_pages == 0) {
+        return true;
+    }
+    // Once most of the image is written uploading it whole is cheaper.
+    if ((image.num_dirty_pages + num_new_pages) * 2 > num_pages) {
+        return false;
+    }
+    if (image.dirty_pages.empty()) {
+        image.dirty_pages.resize(Common::DivCeil<u64>(num_pages, 64));
+        image.page_hashes.resize(num_pages);
+    }
+    ForEachPageRun(image, first, last, false, [&](u64 run_begin, u64 run_end) {
+        for (u64 page = run_begin; page < run_end; ++page) {
+            // Faults are taken before the write lands, so the page still holds its old contents.
+            const auto [page_begin, page_end] = GetPageBounds(image.info, page);
+            image.page_hashes[page] =
+                XXH3_64bits(std::bit_cast<const u8*>(page_begin), page_end - page_begin);
+            image.dirty_pages[page / 64] |= 1ULL << (page % 64);
+        }
+        tracker.UpdatePagesCachedCount((base_page + run_begin) << PageShift,
+                                       (run_end - run_begin) << PageShift, -1);
+    });
+    image.num_dirty_pages += num_new_pages;
+    image.flags |= ImageFlagBits::CpuDirtyPages;
+    return true;
+}
+
+void TextureCache::DiscardDirtyPages(Image& image) {
+    if (image.num_dirty_pages == 0) {
+        return;
+    }
+    const u64 base_page = image.info.guest_address >> PageShift;
+    ForEachPageRun(image, 0, image.page_hashes.size(), true, [&](u64 begin, u64 end) {
+        tracker.UpdatePagesCachedCount((base_page + begin) << PageShift, (end - begin) << PageShift,
+                                       1);
+    });
+    std::ranges::fill(image.dirty_pages, 0);
+    image.num_dirty_pages = 0;
+    image.flags &= ~ImageFlagBits::CpuDirtyPages;
+}
+
 void TextureCache::InvalidateMemory(VAddr addr, size_t size) {
     std::scoped_lock lock{mutex};
     const auto end = addr + size;
@@ -69,6 +206,10 @@ void TextureCache::InvalidateMemory(VAddr addr, size_t size) {
         if (image_begin < end && addr < image_end) {
             // Start or end of the modified region is in the image, or the image is entirely within
             // the modified region, so the image was definitely accessed by this page fault.
+            // Large images only have the written pages untracked and uploaded.
+            if (MarkPagesDirty(image, addr, size)) {
+                return;
+            }
             // Untrack the image, so that the range is unprotected and the guest can write freely.
             image.flags |= ImageFlagBits::CpuDirty;
             UntrackImage(image_id);
@@ -377,10 +518,48 @@ ImageId TextureCache::FindImage(BaseDesc& desc, FindFlags flags) {
 
     Image& image = slot_images[image_id];
     image.tick_accessed_last = scheduler.CurrentTick();
+    lru_cache.Touch(image.lru_id, image.tick_accessed_last);
 
     return image_id;
 }
 
+ImageId TextureCache::FindTextureImage(const AmdGpu::Image& image,
+                                       const Shader::ImageResource& resource, TextureDesc& desc) {
+    const auto sharp = std::bit_cast<std::array<u64, 4>>(image);
+    const u32 flags = u32(resource.is_depth) | u32(resource.is_atomic) << 1 |
+                      u32(resource.is_array) << 2 | u32(resource.is_read) << 3 |
+                      u32(resource.is_written) << 4;
+    const u64 hash = HashCombine(HashCombine(sharp[0], sharp[1]), sharp[2] ^ sharp[3] ^ flags);
+    TextureLookup& lookup = texture_lookups[hash % NumTextureLookups];
+    u64 generation;
+    {
+        std::scoped_lock lock{mutex};
+        generation = image_generation;
+        if (lookup.generation == generation && lookup.sharp == sharp && lookup.flags == flags) {
+            desc = lookup.desc;
+            if (lookup.image_id) {
+                Image& cached_image = slot_images[lookup.image_id];
+                cached_image.tick_accessed_last = scheduler.CurrentTick();
+                lru_cache.Touch(cached_image.lru_id, cached_image.tick_accessed_last);
+            }
+            return lookup.image_id;
+        }
+    }
+
+    desc = TextureDesc{image, resource};
+    const ImageId image_id = FindImage(desc);
+    // If the search created an image the generation moved on and the next lookup searches again,
+    // that is cheaper than taking the lock once more to check.
+    lookup = TextureLookup{
+        .sharp = sharp,
+        .flags = flags,
+        .generation = generation,
+        .image_id = image_id,
+        .desc = desc,
+    };
+    return image_id;
+}
+
 ImageView& TextureCache::RegisterImageView(ImageId image_id, const ImageViewInfo& view_info) {
     Image& image = slot_images[image_id];
     if (const ImageViewId view_id = image.FindView(view_info); view_id) {
@@ -430,6 +609,10 @@ ImageView& TextureCache::FindDepthTarget(BaseDesc& desc) {
     const ImageId image_id = FindImage(desc);
     Image& image = slot_images[image_id];
     image.flags |= ImageFlagBits::GpuModified;
+    if (True(image.flags & ImageFlagBits::CpuDirtyPages)) {
+        std::scoped_lock lock{mutex};
+        DiscardDirtyPages(image);
+    }
     image.flags &= ~ImageFlagBits::Dirty;
     image.usage.depth_target = 1u;
     image.usage.stencil = image.info.HasStencil();
@@ -480,6 +663,21 @@ void TextureCache::RefreshImage(Image& image, Vulkan::Scheduler* custom_schedule
         return;
     }
 
+    // Guest memory has to be up to date before it is read.
+    buffer_cache.ResolveReadbacks(image.info.guest_address, image.info.guest_size);
+
+    if ((image.flags & ImageFlagBits::Dirty) == ImageFlagBits::CpuDirtyPages) {
+        RefreshImagePages(image, custom_scheduler);
+        return;
+    }
+    if (True(image.flags & ImageFlagBits::CpuDirtyPages)) {
+        // The whole image is uploaded, so the dirty pages can be write protected again.
+        std::scoped_lock lock{mutex};
+        DiscardDirtyPages(image);
+    }
+    // Tracking of the image may still be queued, protect it before guest memory is read.
+    tracker.FlushProtections(image.info.guest_address, image.info.guest_size);
+
     if (True(image.flags & ImageFlagBits::MaybeCpuDirty) &&
         False(image.flags & ImageFlagBits::CpuDirty)) {
         // The image size should be less than page size to be considered MaybeCpuDirty
@@ -548,26 +746,173 @@ void TextureCache::RefreshImage(Image& image, Vulkan::Scheduler* custom_schedule
     const auto cmdbuf = sched_ptr->CommandBuffer();
     const VAddr image_addr = image.info.guest_address;
     const size_t image_size = image.info.guest_size;
-    const auto [vk_buffer, buf_offset] =
-        buffer_cache.ObtainViewBuffer(image_addr, image_size, is_gpu_dirty);
-
-    // The obtained buffer may be written by a shader so we need to emit a barrier to prevent RAW
-    // hazard
-    if (auto barrier = vk_buffer->GetBarrier(vk::AccessFlagBits2::eTransferRead,
-                                             vk::PipelineStageFlagBits2::eTransfer)) {
-        cmdbuf.pipelineBarrier2(vk::DependencyInfo{
-            .dependencyFlags = vk::DependencyFlagBits::eByRegion,
-            .bufferMemoryBarrierCount = 1,
-            .pBufferMemoryBarriers = &barrier.value(),
-        });
-    }
+    vk::Buffer buffer;
+    u32 offset;
+    if (Config::isCpuDetilerEnabled() && tile_manager.CanDetileOnCpu(image.info) &&
+        !buffer_cache.IsRegionGpuModified(image_addr, image_size)) {
+        // Guest memory is up to date, detile it straight into the staging buffer and skip the
+        // intermediate copy and compute dispatch.
+        auto& staging_buffer = buffer_cache.GetStagingBuffer();
+        const auto [staging, staging_offset] = staging_buffer.Map(image_size, 16);
+        tile_manager.DetileOnCpu(image.info, {staging, image_size},
+                                 {reinterpret_cast<const u8*>(image_addr), image_size});
+        staging_buffer.Commit();
+        buffer = staging_buffer.Handle();
+        offset = static_cast<u32>(staging_offset);
+    } else {
+        const auto [vk_buffer, buf_offset] =
+            buffer_cache.ObtainViewBuffer(image_addr, image_size, is_gpu_dirty);
+
+        // The obtained buffer may be written by a shader so we need to emit a barrier to prevent
+        // RAW hazard
+        if (auto barrier = vk_buffer->GetBarrier(vk::AccessFlagBits2::eTransferRead,
+                                                 vk::PipelineStageFlagBits2::eTransfer)) {
+            cmdbuf.pipelineBarrier2(vk::DependencyInfo{
+                .dependencyFlags = vk::DependencyFlagBits::eByRegion,
+                .bufferMemoryBarrierCount = 1,
+                .pBufferMemoryBarriers = &barrier.value(),
+            });
+        }
 
-    const auto [buffer, offset] =
-        tile_manager.TryDetile(vk_buffer->Handle(), buf_offset, image.info);
+        std::tie(buffer, offset) =
+            tile_manager.TryDetile(vk_buffer->Handle(), buf_offset, image.info);
+    }
     for (auto& copy : image_copy) {
         copy.bufferOffset += offset;
     }
 
+    CopyToImage(image, cmdbuf, buffer, offset, image_size, image_copy);
+    image.flags &= ~ImageFlagBits::Dirty;
+}
+
+void TextureCache::RefreshImagePages(Image& image, Vulkan::Scheduler* custom_scheduler) {
+    const ImageInfo& info = image.info;
+    const VAddr image_begin = info.guest_address;
+
+    // Write protect the pages again before reading them, writes racing with the upload are
+    // picked up by the next refresh. DiscardDirtyPages only queues the protection, the flush
+    // below applies it.
+    boost::container::small_vector<std::pair<u64, u64>, 16> dirty_pages;
+    {
+        std::scoped_lock lock{mutex};
+        ForEachPageRun(image, 0, image.page_hashes.size(), true, [&](u64 begin, u64 end) {
+            for (u64 page = begin; page < end; ++page) {
+                dirty_pages.emplace_back(page, image.page_hashes[page]);
+            }
+        });
+        DiscardDirtyPages(image);
+    }
+    tracker.FlushProtections(image_begin, info.guest_size);
+
+    // Byte ranges of the image whose contents really changed.
+    boost::container::small_vector<std::pair<u64, u64>, 16> changed;
+    for (const auto [page, hash] : dirty_pages) {
+        const auto [page_begin, page_end] = GetPageBounds(info, page);
+        if (XXH3_64bits(std::bit_cast<const u8*>(page_begin), page_end - page_begin) == hash) {
+            continue;
+        }
+        const u64 begin = page_begin - image_begin;
+        const u64 end = page_end - image_begin;
+        if (!changed.empty() && changed.back().second == begin) {
+            changed.back().second = end;
+        } else {
+            changed.emplace_back(begin, end);
+        }
+    }
+    if (changed.empty()) {
+        return;
+    }
+
+    // Expand the ranges to whole bands of rows of each subresource they touch.
+    struct Region {
+        u32 level;
+        u32 layer;
+        u64 base;
+        u64 begin;
+        u64 end;
+    };
+    boost::container::small_vector<Region, 16> regions;
+    const bool is_tiled = info.props.is_tiled;
+    const u32 num_layers = info.resources.layers;
+    u64 staging_size = 0;
+    for (u32 m = 0; m < info.resources.levels; ++m) {
+        const auto& mip = info.mips_layout[m];
+        const u64 row_size = u64(mip.pitch) * info.num_bits / 8;
+        const u64 band_size = row_size * (is_tiled ? 8 : 1);
+        const u64 num_rows = std::max(info.size.height >> m, 1u);
+        const u64 used_size =
+            std::min<u64>(mip.size, Common::AlignUp(num_rows * row_size, band_size));
+        for (u32 l = 0; l < num_layers; ++l) {
+            const u64 base = u64(mip.offset) * num_layers + u64(l) * mip.size;
+            for (const auto [begin, end] : changed) {
+                if (end <= base || begin >= base + used_size) {
+                    continue;
+                }
+                const u64 region_begin =
+                    base + Common::AlignDown(std::max(begin, base) - base, band_size);
+                const u64 region_end =
+                    base + std::min(Common::AlignUp(end - base, band_size), used_size);
+                if (!regions.empty() && regions.back().level == m && regions.back().layer == l &&
+                    regions.back().end >= region_begin) {
+                    staging_size += region_end - regions.back().end;
+                    regions.back().end = region_end;
+                } else {
+                    regions.push_back({m, l, base, region_begin, region_end});
+                    staging_size += region_end - region_begin;
+                }
+            }
+        }
+    }
+    if (regions.empty()) {
+        return;
+    }
+
+    auto* sched_ptr = custom_scheduler ? custom_scheduler : &scheduler;
+    sched_ptr->EndRendering();
+
+    auto& staging_buffer = buffer_cache.GetStagingBuffer();
+    const auto [staging, staging_offset] = staging_buffer.Map(staging_size, 16);
+    const std::span<const u8> guest{std::bit_cast<const u8*>(image_begin), info.guest_size};
+    boost::container::small_vector<vk::BufferImageCopy, 16> image_copy;
+    u64 offset = 0;
+    for (const Region& region : regions) {
+        const u64 size = region.end - region.begin;
+        if (is_tiled) {
+            tile_manager.DetileOnCpu(info, {staging + offset, size}, guest,
+                                     static_cast<u32>(region.begin));
+        } else {
+            std::memcpy(staging + offset, guest.data() + region.begin, size);
+        }
+        const auto& mip = info.mips_layout[region.level];
+        const u64 row_size = u64(mip.pitch) * info.num_bits / 8;
+        const u32 height = std::max(info.size.height >> region.level, 1u);
+        const u32 first_row = static_cast<u32>((region.begin - region.base) / row_size);
+        const u32 end_row =
+            std::min(static_cast<u32>((region.end - region.base) / row_size), height);
+        image_copy.push_back({
+            .bufferOffset = staging_offset + offset,
+            .bufferRowLength = static_cast<u32>(mip.pitch),
+            .bufferImageHeight = 0,
+            .imageSubresource{
+                .aspectMask = image.aspect_mask & ~vk::ImageAspectFlagBits::eStencil,
+                .mipLevel = region.level,
+                .baseArrayLayer = region.layer,
+                .layerCount = 1,
+            },
+            .imageOffset = {0, static_cast<s32>(first_row), 0},
+            .imageExtent = {std::max(info.size.width >> region.level, 1u), end_row - first_row, 1},
+        });
+        offset += size;
+    }
+    staging_buffer.Commit();
+
+    CopyToImage(image, sched_ptr->CommandBuffer(), staging_buffer.Handle(), staging_offset,
+                staging_size, image_copy);
+}
+
+void TextureCache::CopyToImage(Image& image, vk::CommandBuffer cmdbuf, vk::Buffer buffer,
+                               u64 offset, u64 size,
+                               std::span<const vk::BufferImageCopy> copies) {
     const vk::BufferMemoryBarrier2 pre_barrier{
         .srcStageMask = vk::PipelineStageFlagBits2::eAllCommands,
         .srcAccessMask = vk::AccessFlagBits2::eMemoryWrite,
@@ -575,7 +920,7 @@ void TextureCache::RefreshImage(Image& image, Vulkan::Scheduler* custom_schedule
         .dstAccessMask = vk::AccessFlagBits2::eTransferRead,
         .buffer = buffer,
         .offset = offset,
-        .size = image_size,
+        .size = size,
     };
     const vk::BufferMemoryBarrier2 post_barrier{
         .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
@@ -584,7 +929,7 @@ void TextureCache::RefreshImage(Image& image, Vulkan::Scheduler* custom_schedule
         .dstAccessMask = vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite,
         .buffer = buffer,
         .offset = offset,
-        .size = image_size,
+        .size = size,
     };
     const auto image_barriers =
         image.GetBarriers(vk::ImageLayout::eTransferDstOptimal, vk::AccessFlagBits2::eTransferWrite,
@@ -596,19 +941,47 @@ void TextureCache::RefreshImage(Image& image, Vulkan::Scheduler* custom_schedule
         .imageMemoryBarrierCount = static_cast<u32>(image_barriers.size()),
         .pImageMemoryBarriers = image_barriers.data(),
     });
-    cmdbuf.copyBufferToImage(buffer, image.image, vk::ImageLayout::eTransferDstOptimal, image_copy);
+    cmdbuf.copyBufferToImage(buffer, image.image, vk::ImageLayout::eTransferDstOptimal, copies);
     cmdbuf.pipelineBarrier2(vk::DependencyInfo{
         .dependencyFlags = vk::DependencyFlagBits::eByRegion,
         .bufferMemoryBarrierCount = 1,
         .pBufferMemoryBarriers = &post_barrier,
     });
-    image.flags &= ~ImageFlagBits::Dirty;
+}
+
+u64 TextureCache::RunGarbageCollector(u64 bytes_to_free) {
+    std::scoped_lock lock{mutex};
+    const u64 current_tick = scheduler.CurrentTick();
+    if (current_tick <= NumFramesBeforeRemoval) {
+        return 0;
+    }
+    u64 bytes_freed = 0;
+    lru_cache.ForEachItemBelow(current_tick - NumFramesBeforeRemoval, [&](ImageId image_id) {
+        const Image& image = slot_images[image_id];
+        // Contents written by the GPU only live in the host image, there is no way to retile
+        // them back to guest memory so such images stay until the guest replaces them.
+        if (True(image.flags & ImageFlagBits::GpuModified) || image.usage.vo_surface) {
+            return false;
+        }
+        bytes_freed += image.info.guest_size;
+        FreeImage(image_id);
+        return bytes_freed >= bytes_to_free;
+    });
+    return bytes_freed;
 }
 
 vk::Sampler TextureCache::GetSampler(const AmdGpu::Sampler& sampler) {
+    // Draws keep binding the same few samplers, check the recently used ones before hashing.
+    SamplerLookup& lookup = sampler_lookups[HashCombine(sampler.raw0, sampler.raw1) %
+                                            NumSamplerLookups];
+    if (lookup.handle && lookup.sharp == sampler) {
+        return lookup.handle;
+    }
     const u64 hash = XXH3_64bits(&sampler, sizeof(sampler));
     const auto [it, new_sampler] = samplers.try_emplace(hash, instance, sampler);
-    return it->second.Handle();
+    lookup.sharp = sampler;
+    lookup.handle = it->second.Handle();
+    return lookup.handle;
 }
 
 void TextureCache::RegisterImage(ImageId image_id) {
@@ -616,6 +989,9 @@ void TextureCache::RegisterImage(ImageId image_id) {
     ASSERT_MSG(False(image.flags & ImageFlagBits::Registered),
                "Trying to register an already registered image");
     image.flags |= ImageFlagBits::Registered;
+    ++image_generation;
+    image.lru_id = lru_cache.Insert(image_id, scheduler.CurrentTick());
+    total_used_memory += image.info.guest_size;
     ForEachPage(image.info.guest_address, image.info.guest_size,
                 [this, image_id](u64 page) { page_table[page].push_back(image_id); });
 }
@@ -625,6 +1001,9 @@ void TextureCache::UnregisterImage(ImageId image_id) {
     ASSERT_MSG(True(image.flags & ImageFlagBits::Registered),
                "Trying to unregister an already unregistered image");
     image.flags &= ~ImageFlagBits::Registered;
+    ++image_generation;
+    lru_cache.Free(image.lru_id);
+    total_used_memory -= image.info.guest_size;
     ForEachPage(image.info.guest_address, image.info.guest_size, [this, image_id](u64 page) {
         const auto page_it = page_table.find(page);
         if (page_it == nullptr) {
@@ -698,9 +1077,25 @@ void TextureCache::UntrackImage(ImageId image_id) {
     const auto size = image.track_addr_end - image.track_addr;
     image.track_addr = 0;
     image.track_addr_end = 0;
-    if (size != 0) {
+    if (size == 0) {
+        return;
+    }
+    if (image.num_dirty_pages == 0) {
         tracker.UpdatePagesCachedCount(addr, size, -1);
+        return;
     }
+    // Dirty pages are untracked already, skip them and refresh the whole image instead.
+    const u64 base_page = image.info.guest_address >> PageShift;
+    const u64 first = (addr >> PageShift) - base_page;
+    const u64 last = ((addr + size - 1) >> PageShift) - base_page + 1;
+    ForEachPageRun(image, first, last, false, [&](u64 begin, u64 end) {
+        tracker.UpdatePagesCachedCount((base_page + begin) << PageShift, (end - begin) << PageShift,
+                                       -1);
+    });
+    std::ranges::fill(image.dirty_pages, 0);
+    image.num_dirty_pages = 0;
+    image.flags &= ~ImageFlagBits::CpuDirtyPages;
+    image.flags |= ImageFlagBits::CpuDirty;
 }
 
 void TextureCache::UntrackImageHead(ImageId image_id) {
@@ -712,13 +1107,20 @@ void TextureCache::UntrackImageHead(ImageId image_id) {
     const auto addr = tracker.GetNextPageAddr(image_begin);
     const auto size = addr - image_begin;
     image.track_addr = addr;
+    // A dirty page has been untracked already.
+    const bool is_dirty_page = image.IsPageDirty(0);
+    if (is_dirty_page) {
+        DropDirtyPage(image, 0);
+    }
     if (image.track_addr == image.track_addr_end) {
         // This image spans only 2 pages and both are modified,
         // but the image itself was not directly affected.
         // Cehck its hash later.
         MarkAsMaybeDirty(image_id, image);
     }
-    tracker.UpdatePagesCachedCount(image_begin, size, -1);
+    if (!is_dirty_page) {
+        tracker.UpdatePagesCachedCount(image_begin, size, -1);
+    }
 }
 
 void TextureCache::UntrackImageTail(ImageId image_id) {
@@ -731,13 +1133,21 @@ void TextureCache::UntrackImageTail(ImageId image_id) {
     const auto addr = tracker.GetPageAddr(image_end);
     const auto size = image_end - addr;
     image.track_addr_end = addr;
+    // A dirty page has been untracked already.
+    const u64 page = (addr >> PageShift) - (image.info.guest_address >> PageShift);
+    const bool is_dirty_page = image.IsPageDirty(page);
+    if (is_dirty_page) {
+        DropDirtyPage(image, page);
+    }
     if (image.track_addr == image.track_addr_end) {
         // This image spans only 2 pages and both are modified,
         // but the image itself was not directly affected.
         // Cehck its hash later.
         MarkAsMaybeDirty(image_id, image);
     }
-    tracker.UpdatePagesCachedCount(addr, size, -1);
+    if (!is_dirty_page) {
+        tracker.UpdatePagesCachedCount(addr, size, -1);
+    }
 }
 
 void TextureCache::DeleteImage(ImageId image_id) {
@@ -3,9 +3,12 @@
 
 #pragma once
 
+#include <array>
+#include <span>
 #include <boost/container/small_vector.hpp>
 #include <tsl/robin_map.h>
 
+#include "common/lru_cache.h"
 #include "common/slot_vector.h"
 #include "video_core/amdgpu/resource.h"
 #include "video_core/multi_level_page_table.h"
@@ -107,6 +110,12 @@ public:
     /// Retrieves the image handle of the image with the provided attributes.
     [[nodiscard]] ImageId FindImage(BaseDesc& desc, FindFlags flags = {});
 
+    /// Retrieves the image of a texture binding and fills its descriptor. Lookups of a sharp seen
+    /// recently reuse the previous result until an image is registered or unregistered.
+    [[nodiscard]] ImageId FindTextureImage(const AmdGpu::Image& image,
+                                           const Shader::ImageResource& resource,
+                                           TextureDesc& desc);
+
     /// Retrieves an image view with the properties of the specified image id.
     [[nodiscard]] ImageView& FindTexture(ImageId image_id, const ImageViewInfo& view_info);
 
@@ -137,6 +146,20 @@ public:
     /// Reuploads image contents.
     void RefreshImage(Image& image, Vulkan::Scheduler* custom_scheduler = nullptr);
 
+    /// Evicts images that were not used recently, least recently used first, until at least
+    /// bytes_to_free bytes are released. Returns the number of bytes released.
+    u64 RunGarbageCollector(u64 bytes_to_free);
+
+    /// Returns the guest memory size of all cached images.
+    [[nodiscard]] u64 GetMemoryUsage() const noexcept {
+        return total_used_memory;
+    }
+
+    /// Returns the number of cached images, not counting the null image.
+    [[nodiscard]] size_t GetNumImages() const noexcept {
+        return slot_images.size() - 1;
+    }
+
     /// Retrieves the sampler that matches the provided S# descriptor.
     [[nodiscard]] vk::Sampler GetSampler(const AmdGpu::Sampler& sampler);
 
@@ -266,6 +289,23 @@ private:
 
     void MarkAsMaybeDirty(ImageId image_id, Image& image);
 
+    /// Records a CPU write to a few pages of the image, so that only those are uploaded later.
+    /// Returns false if the image has to be refreshed as a whole instead.
+    bool MarkPagesDirty(Image& image, VAddr addr, size_t size);
+
+    /// Write protects the dirty pages of an image again and forgets about them.
+    void DiscardDirtyPages(Image& image);
+
+    /// Returns true if CPU writes to the image can be uploaded a few pages at a time.
+    [[nodiscard]] bool IsPageTrackable(const ImageInfo& info) const;
+
+    /// Uploads the rows of the image covered by dirty pages whose contents changed.
+    void RefreshImagePages(Image& image, Vulkan::Scheduler* custom_scheduler);
+
+    /// Copies from a buffer to the image along with the barriers around the copy.
+    void CopyToImage(Image& image, vk::CommandBuffer cmdbuf, vk::Buffer buffer, u64 offset,
+                     u64 size, std::span<const vk::BufferImageCopy> copies);
+
     /// Removes the image and any views/surface metas that reference it.
     void DeleteImage(ImageId image_id);
 
@@ -284,7 +324,26 @@ private:
     Common::SlotVector<Image> slot_images;
     Common::SlotVector<ImageView> slot_image_views;
     tsl::robin_map<u64, Sampler> samplers;
+    struct TextureLookup {
+        std::array<u64, 4> sharp{};
+        u32 flags{};
+        u64 generation{};
+        ImageId image_id{};
+        TextureDesc desc{};
+    };
+    struct SamplerLookup {
+        AmdGpu::Sampler sharp{};
+        vk::Sampler handle{};
+    };
+    static constexpr size_t NumTextureLookups = 256;
+    static constexpr size_t NumSamplerLookups = 64;
+    std::array<TextureLookup, NumTextureLookups> texture_lookups{};
+    std::array<SamplerLookup, NumSamplerLookups> sampler_lookups{};
+    /// Bumped whenever the set of registered images changes, which invalidates texture lookups.
+    u64 image_generation{1};
     PageTable page_table;
+    Common::LeastRecentlyUsedCache<ImageId, u64> lru_cache;
+    u64 total_used_memory{};
     std::mutex mutex;
 
     struct MetaDataInfo {
@@ -1,10 +1,15 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <algorithm>
+#include <latch>
+#include <thread>
+#include "common/thread_pool.h"
 #include "video_core/renderer_vulkan/vk_instance.h"
 #include "video_core/renderer_vulkan/vk_scheduler.h"
 #include "video_core/renderer_vulkan/vk_shader_util.h"
 #include "video_core/texture_cache/image_info.h"
+#include "video_core/texture_cache/cpu_detiler.h"
 #include "video_core/texture_cache/image_view.h"
 #include "video_core/texture_cache/tile_manager.h"
 
@@ -23,8 +28,36 @@
 
 namespace VideoCore {
 
+static u32 GetDetilerBpp(const ImageInfo& info) {
+    return info.num_bits * (info.props.is_block ? 16u : 1u);
+}
+
+static MicroTileLayout GetMicroTileLayout(const ImageInfo& info) {
+    MicroTileLayout layout{
+        .bpp = GetDetilerBpp(info),
+        .pitch = info.pitch >> (info.props.is_block ? 2u : 0u),
+        .num_levels = info.resources.levels,
+    };
+    for (u32 m = 0; m < std::min<u32>(layout.num_levels, layout.level_ends.size()); ++m) {
+        layout.level_ends[m] = info.mips_layout[m].size * info.resources.layers +
+                               (m > 0 ? layout.level_ends[m - 1] : 0);
+    }
+    return layout;
+}
+
+static MacroTileLayout GetMacroTileLayout(const ImageInfo& info) {
+    const u32 tiles_per_row = info.pitch / 8u;
+    return MacroTileLayout{
+        .bpp = GetDetilerBpp(info),
+        .pitch = info.pitch >> (info.props.is_block ? 2u : 0u),
+        .height = info.size.height,
+        .tiles_per_row = tiles_per_row,
+        .tiles_per_slice = tiles_per_row * ((info.size.height + 7u) / 8u),
+    };
+}
+
 const DetilerContext* TileManager::GetDetiler(const ImageInfo& info) const {
-    const auto bpp = info.num_bits * (info.props.is_block ? 16 : 1);
+    const auto bpp = GetDetilerBpp(info);
     switch (info.tiling_mode) {
     case AmdGpu::TilingMode::Texture_MicroTiled:
         switch (bpp) {
@@ -283,4 +316,62 @@ std::pair<vk::Buffer, u32> TileManager::TryDetile(vk::Buffer in_buffer, u32 in_o
     return {out_buffer.first, 0};
 }
 
+bool TileManager::CanDetileOnCpu(const ImageInfo& info) const {
+    if (!info.props.is_tiled || (info.guest_size % 64) != 0) {
+        return false;
+    }
+    switch (info.tiling_mode) {
+    case AmdGpu::TilingMode::Texture_MicroTiled:
+        return IsDetilerSupported(GetMicroTileLayout(info));
+    case AmdGpu::TilingMode::Texture_Volume:
+        return info.resources.levels == 1 && IsDetilerSupported(GetMacroTileLayout(info));
+    default:
+        return false;
+    }
+}
+
+void TileManager::DetileOnCpu(const ImageInfo& info, std::span<u8> out, std::span<const u8> in,
+                              u32 offset) {
+    // Work is split in units matching the shader invocations: micro tiles for micro tiled images
+    // and single elements for volumes.
+    const bool is_volume = info.tiling_mode == AmdGpu::TilingMode::Texture_Volume;
+    const u32 bpp = GetDetilerBpp(info);
+    const u32 unit_size = is_volume ? bpp / 8 : 64 * bpp / 8;
+    const u32 first_unit = offset / unit_size;
+    const u32 num_units = out.size() / unit_size;
+    ASSERT(!is_volume || offset == 0);
+    const DetilerIsa isa = GetHostDetilerIsa();
+    const auto micro_layout = is_volume ? MicroTileLayout{} : GetMicroTileLayout(info);
+    const auto macro_layout = is_volume ? GetMacroTileLayout(info) : MacroTileLayout{};
+    const auto detile = [&](u32 first, u32 count) {
+        if (is_volume) {
+            DetileMacro(macro_layout, out, in, first, count, isa);
+        } else {
+            DetileMicro(micro_layout, out, in, first_unit + first, count, isa, offset);
+        }
+    };
+
+    // Below this the cost of waking up workers outweighs the copy itself.
+    static constexpr u32 JobSize = 512_KB;
+    const u32 units_per_job = std::max<u32>(JobSize / unit_size, 8);
+    if (num_units <= units_per_job) {
+        detile(0, num_units);
+        return;
+    }
+    if (!cpu_workers) {
+        const size_t num_workers =
+            std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 8);
+        cpu_workers = std::make_unique<Common::ThreadPool>(num_workers, "Detiler");
+    }
+    const u32 num_jobs = (num_units + units_per_job - 1) / units_per_job;
+    std::latch done{static_cast<std::ptrdiff_t>(num_jobs)};
+    for (u32 first = 0; first < num_units; first += units_per_job) {
+        cpu_workers->Submit([&, first](size_t) {
+            detile(first, std::min(units_per_job, num_units - first));
+            done.count_down();
+        });
+    }
+    done.wait();
+}
+
 } // namespace VideoCore
@@ -3,9 +3,15 @@
 
 #pragma once
 
+#include <memory>
+#include <span>
 #include "common/types.h"
 #include "video_core/buffer_cache/buffer.h"
 
+namespace Common {
+class ThreadPool;
+}
+
 namespace VideoCore {
 
 class TextureCache;
@@ -40,6 +46,15 @@ public:
     std::pair<vk::Buffer, u32> TryDetile(vk::Buffer in_buffer, u32 in_offset,
                                          const ImageInfo& info);
 
+    /// Returns true if the image can be detiled by DetileOnCpu.
+    [[nodiscard]] bool CanDetileOnCpu(const ImageInfo& info) const;
+
+    /// Detiles guest memory straight into `out`, splitting large images across worker threads.
+    /// A non-zero offset detiles only the bytes [offset, offset + out.size()) of a micro tiled
+    /// image, the range has to cover whole rows of tiles.
+    void DetileOnCpu(const ImageInfo& info, std::span<u8> out, std::span<const u8> in,
+                     u32 offset = 0);
+
     ScratchBuffer AllocBuffer(u32 size, bool is_storage = false);
     void Upload(ScratchBuffer buffer, const void* data, size_t size);
     void FreeBuffer(ScratchBuffer buffer);
@@ -52,6 +67,7 @@ private:
     Vulkan::Scheduler& scheduler;
     vk::UniqueDescriptorSetLayout desc_layout;
     std::array<DetilerContext, DetilerType::Max> detilers;
+    std::unique_ptr<Common::ThreadPool> cpu_workers;
 };
 
 } // namespace VideoCore